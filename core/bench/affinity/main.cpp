@@ -0,0 +1,160 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../benchlib.hpp"
+
+//#include <ArcCore/JobManager.hpp>
+#include "../../../core/inc/JobManager.hpp"
+
+#ifdef PLATFORM_LINUX
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // PLATFORM_LINUX
+
+namespace jm = arc::core::JobManager;
+
+// Hardware cache misses of this process and every thread it starts later.
+//	Counts of inherited threads are only added once they exit, so each
+// measurement runs on a pool of its own that is shut down before reading
+class CacheMissCounter {
+  public:
+    CacheMissCounter() {
+#ifdef PLATFORM_LINUX
+        m_l1d = open(PERF_TYPE_HW_CACHE,
+                     PERF_COUNT_HW_CACHE_L1D |
+                         (PERF_COUNT_HW_CACHE_OP_READ << 8) |
+                         (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+        m_llc = open(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+#endif // PLATFORM_LINUX
+    }
+    ~CacheMissCounter() {
+#ifdef PLATFORM_LINUX
+        for (int fd : {m_l1d, m_llc})
+            if (fd >= 0)
+                close(fd);
+#endif // PLATFORM_LINUX
+    }
+
+    bool available() const { return m_l1d >= 0 || m_llc >= 0; }
+
+    void start() { control(PERF_EVENT_IOC_RESET), control(PERF_EVENT_IOC_ENABLE); }
+    void stop() { control(PERF_EVENT_IOC_DISABLE); }
+
+    // -1 where the counter could not be opened
+    long long l1d_misses() const { return read_count(m_l1d); }
+    long long llc_misses() const { return read_count(m_llc); }
+
+  private:
+#ifdef PLATFORM_LINUX
+    static int open(uint32_t type, uint64_t config) {
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.inherit = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        return (int)syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0);
+    }
+#endif // PLATFORM_LINUX
+
+    void control(unsigned long request) {
+#ifdef PLATFORM_LINUX
+        for (int fd : {m_l1d, m_llc})
+            if (fd >= 0)
+                ioctl(fd, request, 0);
+#else
+        (void)request;
+#endif // PLATFORM_LINUX
+    }
+
+    static long long read_count(int fd) {
+        long long count = -1;
+#ifdef PLATFORM_LINUX
+        if (fd < 0 || read(fd, &count, sizeof(count)) != sizeof(count))
+            return -1;
+#else
+        (void)fd;
+#endif // PLATFORM_LINUX
+        return count;
+    }
+
+    int m_l1d = -1;
+    int m_llc = -1;
+};
+
+// A working set updated in place every frame, by dispatch() and by
+// dispatch_affine(). Sticky groups come back to the core that holds their
+// part of the set from the previous frame
+void
+bench_sticky_frames(size_t megabytes, uint32_t thread_count, CacheMissCounter& counter)
+{
+    const uint32_t count = (uint32_t)(megabytes * 1024 * 1024 / sizeof(float));
+    const uint32_t group_size = 16 * 1024; // 64KB per group
+    const int frames = 40;
+    std::vector<float> data(count, 1.0f);
+    auto update = [&data](jm::JobArgs args) {
+        float& x = data[args.job_index];
+        x = x * 0.999f + 0.001f;
+    };
+    const std::string set = " " + std::to_string(megabytes) + "MB";
+
+    for (bool affine : {false, true}) {
+        jm::JobSystemConfig config;
+        config.name = "arc::bench::";
+        config.thread_count = thread_count;
+        config.placement.policy = arc::core::PLACEMENT_COMPACT;
+
+        counter.start();
+        bl::Timer timer;
+        {
+            jm::JobSystem system(config);
+            for (int frame = 0; frame < frames; frame++) {
+                jm::Context ctx;
+                if (affine)
+                    system.dispatch_affine(ctx, count, group_size, update, 0);
+                else
+                    system.dispatch(ctx, count, group_size, update, 0);
+                system.wait_for(ctx);
+            }
+        }
+        const double seconds = timer.elapsed_seconds();
+        counter.stop();
+
+        const std::string name = (affine ? "dispatch_affine" : "dispatch") + set;
+        bl::report(name + " frame", seconds * 1e3 / frames, "ms");
+        if (counter.l1d_misses() >= 0)
+            bl::report(name + " L1D misses", counter.l1d_misses() / (double)frames, "/frame");
+        if (counter.llc_misses() >= 0)
+            bl::report(name + " LLC misses", counter.llc_misses() / (double)frames, "/frame");
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    /*an optional argument sets the working set in MB, --out <path> writes
+     * the results as JSON or CSV*/
+    const size_t megabytes = argc > 1 && argv[1][0] != '-' ? std::atoi(argv[1]) : 50;
+    const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+
+    /*opened before any pool starts, so the workers inherit the counters*/
+    CacheMissCounter counter;
+    if (!counter.available())
+        std::fprintf(stderr, "perf counters unavailable, only timing frames "
+                             "(see /proc/sys/kernel/perf_event_paranoid)\n");
+    bl::report("threads", std::max(1u, cores - 1) + 1, "");
+    bench_sticky_frames(megabytes, std::max(1u, cores - 1), counter);
+
+    if (const char* path = bl::output_path(argc, argv))
+        return bl::write_results(path, "bench-affinity") ? 0 : 1;
+    return 0;
+}
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Minimal wall-clock benchmarking helpers.
+//  testlib.h times with clock(), which is process CPU time and sums over all
+//  threads, so it cannot be used to measure parallel speedup.
+
+namespace bl {
+
+struct Timer {
+    std::chrono::steady_clock::time_point start =
+        std::chrono::steady_clock::now();
+
+    inline void reset() { start = std::chrono::steady_clock::now(); }
+
+    inline double elapsed_seconds() const {
+        return std::chrono::duration<double>(
+                   std::chrono::steady_clock::now() - start)
+            .count();
+    }
+};
+
+// Run a function a number of times and return the best wall time in seconds
+template <typename F>
+double best_of(int repetitions, F&& fn) {
+    double best = 1e300;
+    for (int i = 0; i < repetitions; i++) {
+        Timer timer;
+        fn();
+        double elapsed = timer.elapsed_seconds();
+        if (elapsed < best)
+            best = elapsed;
+    }
+    return best;
+}
+
+struct Result {
+    std::string name;
+    double value;
+    std::string unit;
+};
+
+// Everything report() printed so far, in order
+inline std::vector<Result>& results() {
+    static std::vector<Result> all;
+    return all;
+}
+
+inline void report(const std::string& name, double value,
+                   const std::string& unit) {
+    std::printf("%-48s %14.3f %s\n", name.c_str(), value, unit.c_str());
+    results().push_back(Result{name, value, unit});
+}
+
+inline std::string json_string(const std::string& text) {
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"' || c == '\\')
+            out += '\\';
+        out += c;
+    }
+    return out + "\"";
+}
+
+// Quoted only when needed, names do not contain quotes
+inline std::string csv_field(const std::string& text) {
+    return text.find_first_of(",\"") == std::string::npos ? text
+                                                          : "\"" + text + "\"";
+}
+
+/* @brief Write every result to path, as CSV if it ends in .csv and as JSON
+ * otherwise, for tracking numbers between versions
+ *
+ * The JSON holds the benchmark name and the machine next to the results:
+ *     {"benchmark": "bench-suite", "hardware_concurrency": 8,
+ *      "results": [{"name": "...", "value": 1.5, "unit": "us"}, ...]}
+ */
+inline bool write_results(const std::string& path, const std::string& benchmark) {
+    FILE* file = std::fopen(path.c_str(), "w");
+    if (file == nullptr) {
+        std::fprintf(stderr, "cannot write %s\n", path.c_str());
+        return false;
+    }
+    const bool csv =
+        path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+    if (csv) {
+        std::fprintf(file, "benchmark,name,value,unit\n");
+        for (const Result& result : results())
+            std::fprintf(file, "%s,%s,%.6g,%s\n", csv_field(benchmark).c_str(),
+                         csv_field(result.name).c_str(), result.value,
+                         csv_field(result.unit).c_str());
+    } else {
+        std::fprintf(file, "{\n  \"benchmark\": %s,\n", json_string(benchmark).c_str());
+        std::fprintf(file, "  \"hardware_concurrency\": %u,\n",
+                     std::thread::hardware_concurrency());
+        std::fprintf(file, "  \"results\": [");
+        const char* separator = "\n";
+        for (const Result& result : results()) {
+            std::fprintf(file, "%s    {\"name\": %s, \"value\": %.6g, \"unit\": %s}",
+                         separator, json_string(result.name).c_str(),
+                         result.value, json_string(result.unit).c_str());
+            separator = ",\n";
+        }
+        std::fprintf(file, "\n  ]\n}\n");
+    }
+    std::fclose(file);
+    return true;
+}
+
+// Path given as --out <path> on the command line, or nullptr
+inline const char* output_path(int argc, char** argv) {
+    for (int i = 1; i + 1 < argc; i++) {
+        if (std::strcmp(argv[i], "--out") == 0)
+            return argv[i + 1];
+    }
+    return nullptr;
+}
+
+} /*ns*/
@@ -0,0 +1,196 @@
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../benchlib.hpp"
+
+//#include <ArcCore/SystemScheduler.hpp>
+#include "../../../core/inc/ParallelAlgorithms.hpp"
+#include "../../../core/inc/SystemScheduler.hpp"
+
+namespace jm = arc::core::JobManager;
+using arc::core::ComponentAccess;
+
+// Components of the benchmark scene, stored as one array per component type
+// the way an ECS keeps its pools packed
+struct Position { float x, y; };
+struct Velocity { float x, y; };
+struct Health { float value; };
+struct Color { float r, g, b; };
+struct Intent { float heading; };
+struct Lifetime { float seconds; };
+struct Visible { bool value; };
+struct Animation { float phase; };
+
+struct BenchScene {
+    explicit BenchScene(size_t count)
+        : position(count), velocity(count), health(count), color(count),
+          intent(count), lifetime(count), visible(count), animation(count) {
+        for (size_t i = 0; i < count; i++) {
+            position[i] = {(float)(i % 1000), (float)(i / 1000)};
+            velocity[i] = {1.0f, 0.5f};
+            health[i] = {50.0f};
+            lifetime[i] = {(float)(i % 97)};
+        }
+    }
+    size_t size() const { return position.size(); }
+
+    std::vector<Position> position;
+    std::vector<Velocity> velocity;
+    std::vector<Health> health;
+    std::vector<Color> color;
+    std::vector<Intent> intent;
+    std::vector<Lifetime> lifetime;
+    std::vector<Visible> visible;
+    std::vector<Animation> animation;
+};
+
+// Loop over every entity, in parallel chunks when chunked is set
+template <typename F>
+static void each(BenchScene& scene, bool chunked, F&& fn) {
+    if (chunked) {
+        /*the entity index is the offset into any component array*/
+        Position* first = scene.position.data();
+        jm::parallel_for(first, first + scene.size(),
+                         [&](Position& p) { fn((size_t)(&p - first)); }, 4096);
+    } else {
+        for (size_t i = 0; i < scene.size(); i++)
+            fn(i);
+    }
+}
+
+struct BenchSystem {
+    const char* name;
+    ComponentAccess access;
+    std::function<void(BenchScene&, bool chunked)> fn;
+};
+
+// Eight systems of a few dozen flops per entity, most of them on disjoint
+// components
+static std::vector<BenchSystem> bench_systems(void) {
+    const float dt = 1.0f / 60.0f;
+    return {
+        {"integrate", ComponentAccess().read<Velocity>().write<Position>(),
+         [dt](BenchScene& s, bool chunked) {
+             each(s, chunked, [&](size_t i) {
+                 s.position[i].x += s.velocity[i].x * dt;
+                 s.position[i].y += s.velocity[i].y * dt;
+             });
+         }},
+        {"drag", ComponentAccess().write<Velocity>(),
+         [](BenchScene& s, bool chunked) {
+             each(s, chunked, [&](size_t i) {
+                 const float speed = std::sqrt(s.velocity[i].x * s.velocity[i].x +
+                                               s.velocity[i].y * s.velocity[i].y);
+                 const float drag = 1.0f / (1.0f + 0.01f * speed);
+                 s.velocity[i].x *= drag;
+                 s.velocity[i].y *= drag;
+             });
+         }},
+        {"regenerate", ComponentAccess().write<Health>(),
+         [dt](BenchScene& s, bool chunked) {
+             each(s, chunked, [&](size_t i) {
+                 s.health[i].value = std::min(100.0f, s.health[i].value + 2.0f * dt);
+             });
+         }},
+        {"think", ComponentAccess().read<Position>().write<Intent>(),
+         [](BenchScene& s, bool chunked) {
+             each(s, chunked, [&](size_t i) {
+                 float heading = std::atan2(500.0f - s.position[i].y,
+                                            500.0f - s.position[i].x);
+                 for (int k = 0; k < 2; k++)
+                     heading = std::sin(heading) + 0.5f * std::cos(heading);
+                 s.intent[i].heading = heading;
+             });
+         }},
+        {"tint", ComponentAccess().read<Health>().write<Color>(),
+         [](BenchScene& s, bool chunked) {
+             each(s, chunked, [&](size_t i) {
+                 const float t = s.health[i].value / 100.0f;
+                 s.color[i] = {1.0f - t, t, std::sqrt(t)};
+             });
+         }},
+        {"age", ComponentAccess().write<Lifetime>(),
+         [dt](BenchScene& s, bool chunked) {
+             each(s, chunked, [&](size_t i) {
+                 s.lifetime[i].seconds = std::fmod(s.lifetime[i].seconds + dt, 97.0f);
+             });
+         }},
+        {"cull", ComponentAccess().read<Position>().write<Visible>(),
+         [](BenchScene& s, bool chunked) {
+             each(s, chunked, [&](size_t i) {
+                 const float dx = s.position[i].x - 500.0f;
+                 const float dy = s.position[i].y - 50.0f;
+                 s.visible[i].value = std::sqrt(dx * dx + dy * dy) < 400.0f;
+             });
+         }},
+        {"animate", ComponentAccess().read<Lifetime>().write<Animation>(),
+         [](BenchScene& s, bool chunked) {
+             each(s, chunked, [&](size_t i) {
+                 s.animation[i].phase = std::sin(s.lifetime[i].seconds * 6.0f);
+             });
+         }},
+    };
+}
+
+// Frame time of the systems run one after another on the main thread, like
+// GameScene::ECS_tick(), against the scheduler with and without chunks
+void
+bench_ecs_tick(size_t entity_count)
+{
+    const int frames = 50;
+    const std::vector<BenchSystem> systems = bench_systems();
+    const std::string entities = " entities=" + std::to_string(entity_count);
+
+    {
+        BenchScene scene(entity_count);
+        std::vector<std::function<void(BenchScene*)>> tick;
+        for (const BenchSystem& system : systems)
+            tick.push_back([fn = system.fn](BenchScene* s) { fn(*s, false); });
+        double seconds = bl::best_of(3, [&] {
+            for (int frame = 0; frame < frames; frame++)
+                for (const auto& system : tick)
+                    system(&scene);
+        });
+        bl::report("sequential" + entities, seconds * 1e3 / frames, "ms/frame");
+    }
+
+    for (bool chunked : {false, true}) {
+        BenchScene scene(entity_count);
+        arc::core::SystemScheduler<BenchScene> scheduler;
+        for (const BenchSystem& system : systems)
+            scheduler.add(system.name, system.access,
+                          [fn = system.fn, chunked](BenchScene& s) { fn(s, chunked); });
+        double seconds = bl::best_of(3, [&] {
+            scheduler.reset_timings();
+            for (int frame = 0; frame < frames; frame++)
+                scheduler.run(scene);
+        });
+        const std::string mode = chunked ? "scheduler+chunks" : "scheduler";
+        bl::report(mode + entities, seconds * 1e3 / frames, "ms/frame");
+        if (chunked) {
+            for (const arc::core::SystemTiming& timing : scheduler.timings())
+                bl::report("  system " + timing.name, timing.average_ms, "ms");
+        }
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+    jm::initialize(std::max(1u, cores - 1));
+    bl::report("threads", jm::get_thread_count() + 1, "");
+
+    bench_ecs_tick(100000);
+
+    jm::shutdown();
+
+    /*--out <path> writes the results as JSON or CSV*/
+    if (const char* path = bl::output_path(argc, argv))
+        return bl::write_results(path, "bench-ecs") ? 0 : 1;
+    return 0;
+}
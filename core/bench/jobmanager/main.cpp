@@ -0,0 +1,444 @@
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "../benchlib.hpp"
+
+/*compiled in so the cost of recording can be measured, it only records
+ * inside bench_profiler*/
+#define ARC_JOB_PROFILER 1
+
+//#include <ArcCore/JobManager.hpp>
+#include "../../../core/inc/JobManager.hpp"
+
+namespace jm = arc::core::JobManager;
+
+// A few hundred nanoseconds of arithmetic that cannot be optimized away
+static inline float kernel(uint32_t i) {
+    float x = (float)i;
+    for (int k = 0; k < 16; k++)
+        x = std::sqrt(x * x + 1.0f);
+    return x;
+}
+
+void
+bench_dispatch_scaling(uint32_t thread_count)
+{
+    const uint32_t job_count = 1u << 20;
+    std::vector<float> out(job_count);
+
+    for (uint32_t group_size : {16u, 256u}) {
+        double seconds = bl::best_of(5, [&] {
+            jm::Context ctx;
+            jm::dispatch(ctx, job_count, group_size, [&](jm::JobArgs args) {
+                out[args.job_index] = kernel(args.job_index);
+            }, 0);
+            jm::wait_for(ctx);
+        });
+        bl::report("dispatch threads=" + std::to_string(thread_count) +
+                       " group=" + std::to_string(group_size),
+                   job_count / seconds / 1e6, "Mjobs/s");
+    }
+}
+
+void
+bench_execute_scaling(uint32_t thread_count)
+{
+    const uint32_t job_count = 100000;
+    std::atomic<uint32_t> sink{0};
+
+    double seconds = bl::best_of(5, [&] {
+        jm::Context ctx;
+        for (uint32_t i = 0; i < job_count; i++)
+            jm::execute(ctx, [&sink, i](jm::JobArgs) {
+                sink.fetch_add((uint32_t)kernel(i), std::memory_order_relaxed);
+            });
+        jm::wait_for(ctx);
+    });
+    bl::report("execute threads=" + std::to_string(thread_count),
+               job_count / seconds / 1e6, "Mjobs/s");
+}
+
+// Fixed group sizes against auto_group_size, for a cheap and an expensive
+// kernel
+void
+bench_auto_group_size(void)
+{
+    for (uint32_t inner : {1u, 256u}) {
+        const uint32_t job_count = (1u << 20) / inner;
+        std::vector<float> out(job_count);
+        auto task = [&out, inner](jm::JobArgs args) {
+            float x = 0.0f;
+            for (uint32_t k = 0; k < inner; k++)
+                x += kernel(args.job_index + k);
+            out[args.job_index] = x;
+        };
+        const std::string name = "kernel x" + std::to_string(inner);
+        for (uint32_t group_size : {1u, 64u, 4096u, jm::auto_group_size}) {
+            double seconds = bl::best_of(5, [&] {
+                jm::Context ctx;
+                jm::dispatch(ctx, job_count, group_size, task, 0);
+                jm::wait_for(ctx);
+            });
+            std::string group = std::to_string(group_size);
+            if (group_size == jm::auto_group_size)
+                group = "auto(" +
+                        std::to_string(jm::grain_stats_of(task).group_size.load()) +
+                        ")";
+            bl::report(name + " group=" + group, seconds * 1e3, "ms");
+        }
+    }
+}
+
+// Time from execute() until the job starts on a parked worker
+void
+bench_wake_latency(void)
+{
+    const int samples = 200;
+    std::vector<double> latencies;
+    for (int i = 0; i < samples; i++) {
+        /*give the workers time to spin out and park*/
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+        std::atomic<int64_t> started{0};
+        jm::Context ctx;
+        auto submitted = std::chrono::steady_clock::now();
+        jm::execute(ctx, [&](jm::JobArgs) {
+            started.store(std::chrono::steady_clock::now().time_since_epoch().count());
+        });
+        /*do not help, the job has to be picked up by a worker*/
+        while (started.load() == 0)
+            std::this_thread::yield();
+        latencies.push_back(
+            (started.load() - submitted.time_since_epoch().count()) / 1e3);
+        jm::wait_for(ctx);
+    }
+    std::sort(latencies.begin(), latencies.end());
+    bl::report("wake latency median", latencies[samples / 2], "us");
+    bl::report("wake latency p99", latencies[samples * 99 / 100], "us");
+}
+
+// Time from the last job finishing until wait_for() returns on a parked waiter
+void
+bench_wait_for_latency(void)
+{
+    const int samples = 200;
+    std::vector<double> latencies;
+    for (int i = 0; i < samples; i++) {
+        std::atomic<bool> started{false};
+        std::atomic<int64_t> finished{0};
+        jm::Context ctx;
+        jm::execute(ctx, [&](jm::JobArgs) {
+            started.store(true);
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+            finished.store(std::chrono::steady_clock::now().time_since_epoch().count());
+        });
+        /*make sure a worker runs the job, so wait_for has nothing to help with*/
+        while (!started.load())
+            std::this_thread::yield();
+        jm::wait_for(ctx);
+        auto returned = std::chrono::steady_clock::now().time_since_epoch().count();
+        latencies.push_back((returned - finished.load()) / 1e3);
+    }
+    std::sort(latencies.begin(), latencies.end());
+    bl::report("wait_for wake latency median", latencies[samples / 2], "us");
+    bl::report("wait_for wake latency p99", latencies[samples * 99 / 100], "us");
+}
+
+// Submitting 10k tiny jobs one by one against a JobBatch, from the thread
+// that owns a queue and from a thread outside of the pool. Workers are given
+// time to park first, so every run pays for waking them
+void
+bench_batch_submit(void)
+{
+    const int job_count = 10000;
+    std::atomic<uint32_t> ran{0};
+    auto tiny = [&ran](jm::JobArgs) { ran.fetch_add(1, std::memory_order_relaxed); };
+
+    auto submit_time = [&](bool batched, bool foreign) {
+        double best = 1e300;
+        for (int rep = 0; rep < 5; rep++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+            jm::Context ctx;
+            double seconds = 0.0;
+            auto submit = [&] {
+                bl::Timer timer;
+                if (batched) {
+                    jm::JobBatch batch;
+                    for (int i = 0; i < job_count; i++)
+                        batch.execute(ctx, tiny);
+                    batch.submit();
+                } else {
+                    for (int i = 0; i < job_count; i++)
+                        jm::execute(ctx, tiny);
+                }
+                seconds = timer.elapsed_seconds();
+            };
+            if (foreign) {
+                std::thread thread(submit);
+                thread.join();
+            } else {
+                submit();
+            }
+            jm::wait_for(ctx);
+            best = std::min(best, seconds);
+        }
+        return best;
+    };
+
+    for (bool foreign : {false, true}) {
+        const std::string from = foreign ? " foreign thread" : " owner thread";
+        bl::report("execute x10k submit" + from,
+                   submit_time(false, foreign) * 1e6, "us");
+        bl::report("JobBatch x10k submit" + from,
+                   submit_time(true, foreign) * 1e6, "us");
+    }
+}
+
+// Cost of the timer wheel behind execute_after() with a thousand and with a
+// million timers pending, then a million timed jobs through the pool
+void
+bench_timers(void)
+{
+    std::mt19937_64 rng(7);
+    for (uint32_t pending : {1000u, 1000000u}) {
+        const std::string count = pending == 1000u ? " 1k pending" : " 1M pending";
+        arc::core::TimerWheel<uint32_t> wheel;
+        std::vector<arc::core::TimerWheel<uint32_t>::Handle> handles(pending);
+        /*deadlines far enough out that none falls due while ticking below*/
+        std::vector<uint64_t> deadlines(pending);
+        for (uint64_t& deadline : deadlines)
+            deadline = (1u << 20) + rng() % (1u << 24);
+        bl::Timer timer;
+        for (uint32_t i = 0; i < pending; i++)
+            handles[i] = wheel.insert(deadlines[i], i);
+        bl::report("TimerWheel insert" + count,
+                   timer.elapsed_seconds() * 1e9 / pending, "ns/op");
+
+        const uint64_t ticks = 1u << 16;
+        timer.reset();
+        for (uint64_t tick = 1; tick <= ticks; tick++)
+            wheel.advance(tick, [](uint32_t) {});
+        bl::report("TimerWheel tick" + count,
+                   timer.elapsed_seconds() * 1e9 / ticks, "ns/tick");
+
+        std::shuffle(handles.begin(), handles.end(), rng);
+        timer.reset();
+        for (const auto& handle : handles)
+            wheel.cancel(handle);
+        bl::report("TimerWheel cancel" + count,
+                   timer.elapsed_seconds() * 1e9 / pending, "ns/op");
+    }
+
+    /*a million jobs spread over half a second, none may run early*/
+    const uint32_t job_count = 1000000;
+    const auto spread = std::chrono::milliseconds(500);
+    std::atomic<uint32_t> early{0};
+    std::atomic<int64_t> latest{0};
+    jm::Context ctx;
+    const auto start = std::chrono::steady_clock::now();
+    bl::Timer timer;
+    for (uint32_t i = 0; i < job_count; i++) {
+        const auto due = start + spread * i / job_count;
+        jm::execute_at(ctx, due, [&, due](jm::JobArgs) {
+            const int64_t late = (std::chrono::steady_clock::now() - due).count();
+            if (late < 0)
+                early.fetch_add(1, std::memory_order_relaxed);
+            int64_t seen = latest.load(std::memory_order_relaxed);
+            while (late > seen && !latest.compare_exchange_weak(seen, late)) {
+            }
+        });
+    }
+    bl::report("execute_at x1M", timer.elapsed_seconds() * 1e9 / job_count, "ns/op");
+    jm::wait_for(ctx);
+    bl::report("execute_at x1M over 500ms, wall",
+               std::chrono::duration<double, std::milli>(
+                   std::chrono::steady_clock::now() - start).count(), "ms");
+    bl::report("execute_at x1M, latest job", latest.load() / 1e6, "ms");
+    bl::report("execute_at x1M, early jobs", early.load(), "");
+}
+
+// A scene load torn down shortly after it started: time until its Context
+// drained, letting the queued groups run against cancelling them
+void
+bench_cancel(void)
+{
+    const uint32_t group_count = 400;
+    auto load_time = [&](bool cancel) {
+        jm::CancelToken token;
+        jm::Context loading;
+        loading.cancel_token = &token;
+        bl::Timer timer;
+        jm::dispatch(loading, group_count * 64, 64, [](jm::JobArgs args) {
+            /*every job is a slice of a decode, about 20us on one core*/
+            float x = 0.0f;
+            for (uint32_t i = 0; i < 400 && !args.is_cancelled(); i++)
+                x += kernel(args.job_index + i);
+            volatile float sink = x;
+            (void)sink;
+        }, 0);
+        std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        if (cancel)
+            token.cancel();
+        jm::wait_for(loading);
+        return timer.elapsed_seconds();
+    };
+    bl::report("scene switch, queued groups run", load_time(false) * 1e3, "ms");
+    bl::report("scene switch, CancelToken", load_time(true) * 1e3, "ms");
+}
+
+// Process CPU time burned while the pool is idle, and while the main thread
+// waits on a long job
+void
+bench_idle_cpu(void)
+{
+    const double window = 0.25;
+
+    std::clock_t cpu = std::clock();
+    bl::Timer timer;
+    std::this_thread::sleep_for(std::chrono::duration<double>(window));
+    double idle = (double)(std::clock() - cpu) / CLOCKS_PER_SEC;
+    bl::report("idle pool cpu", 100.0 * idle / timer.elapsed_seconds(), "% of a core");
+
+    jm::Context ctx;
+    jm::execute(ctx, [&](jm::JobArgs) {
+        std::this_thread::sleep_for(std::chrono::duration<double>(window));
+    });
+    cpu = std::clock();
+    timer.reset();
+    jm::wait_for(ctx);
+    double waiting = (double)(std::clock() - cpu) / CLOCKS_PER_SEC;
+    bl::report("wait_for on sleeping job cpu",
+               100.0 * waiting / timer.elapsed_seconds(), "% of a core");
+}
+
+// Each job of a tree level dispatches the next level and waits on it
+static void
+nested_level(jm::JobSystem& system, uint32_t depth, std::atomic<uint32_t>& leaves)
+{
+    if (depth == 0) {
+        kernel(depth);
+        leaves.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    jm::Context ctx;
+    system.dispatch(ctx, 4, 1, [&](jm::JobArgs) {
+        nested_level(system, depth - 1, leaves);
+    }, 0);
+    system.wait_for(ctx);
+}
+
+// Throughput of jobs that wait on nested dispatches, with waits nesting on
+// the worker stack and with waiting jobs parked on fibers
+void
+bench_nested_depth(uint32_t thread_count)
+{
+    for (bool fibers : {false, true}) {
+#if !ARC_FIBERS
+        if (fibers)
+            continue;
+#endif
+        jm::JobSystemConfig config;
+        config.name = fibers ? "arc::fiber::" : "arc::nested::";
+        config.thread_count = thread_count;
+        config.oversubscribe = true;
+        config.fibers = fibers;
+        jm::JobSystem system(config);
+
+        for (uint32_t depth = 1; depth <= 7; depth++) {
+            std::atomic<uint32_t> leaves{0};
+            double seconds = bl::best_of(3, [&] {
+                jm::Context root;
+                system.dispatch(root, 16, 1, [&](jm::JobArgs) {
+                    nested_level(system, depth, leaves);
+                }, 0);
+                /*the main thread only polls, helping from it would nest
+                  whole trees on its stack*/
+                while (jm::is_busy(root))
+                    std::this_thread::yield();
+            });
+            const double per_run = leaves.load() / 3.0;
+            bl::report(std::string(fibers ? "fibers" : "nested") +
+                           " wait depth=" + std::to_string(depth),
+                       per_run / seconds / 1e6, "Mleaves/s");
+        }
+    }
+}
+
+// Cost of a single profiler event, and of recording a busy dispatch
+void
+bench_profiler(const char* trace_path)
+{
+    const int events = 1 << 20;
+    double idle = bl::best_of(5, [&] {
+        for (int i = 0; i < events; i++)
+            ARC_JOB_PROFILE(jm::PROFILE_SCOPE_BEGIN, "bench", 0);
+    });
+    jm::profiler_begin();
+    double recording = bl::best_of(5, [&] {
+        for (int i = 0; i < events; i++)
+            ARC_JOB_PROFILE(jm::PROFILE_SCOPE_BEGIN, "bench", 0);
+    });
+    jm::profiler_end();
+    bl::report("profiler event, not recording", idle / events * 1e9, "ns");
+    bl::report("profiler event, recording", recording / events * 1e9, "ns");
+
+    const uint32_t job_count = 1u << 18;
+    std::vector<float> out(job_count);
+    auto run = [&] {
+        jm::Context ctx(jm::PRIORITY_NORMAL, "bench dispatch");
+        jm::dispatch(ctx, job_count, 16, [&](jm::JobArgs args) {
+            out[args.job_index] = kernel(args.job_index);
+        }, 0);
+        jm::wait_for(ctx);
+    };
+    double plain = bl::best_of(5, run);
+    jm::profiler_begin();
+    double traced = bl::best_of(5, run);
+    jm::profiler_end();
+    bl::report("dispatch, not recording", plain * 1e3, "ms");
+    bl::report("dispatch, recording", traced * 1e3, "ms");
+
+    if (trace_path != nullptr) {
+        jm::profiler_begin();
+        run();
+        jm::profiler_end();
+        jm::save_chrome_trace(trace_path);
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    /*an optional argument names a Chrome trace file to write, --out <path>
+     * writes the results as JSON or CSV*/
+    const char* trace_path = argc > 1 && argv[1][0] != '-' ? argv[1] : nullptr;
+    const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+    const uint32_t max_threads = std::max(1u, cores - 1);
+
+    for (uint32_t threads = 1; threads <= max_threads; threads++) {
+        jm::initialize(threads);
+        bench_dispatch_scaling(jm::get_thread_count());
+        bench_execute_scaling(jm::get_thread_count());
+        jm::shutdown();
+    }
+
+    jm::initialize(max_threads);
+    bench_auto_group_size();
+    bench_wake_latency();
+    bench_wait_for_latency();
+    bench_batch_submit();
+    bench_timers();
+    bench_cancel();
+    bench_idle_cpu();
+    bench_nested_depth(max_threads);
+    bench_profiler(trace_path);
+    jm::shutdown();
+
+    if (const char* path = bl::output_path(argc, argv))
+        return bl::write_results(path, "bench-jobmanager") ? 0 : 1;
+    return 0;
+}
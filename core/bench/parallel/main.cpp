@@ -0,0 +1,119 @@
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "../benchlib.hpp"
+
+//#include <ArcCore/ParallelAlgorithms.hpp>
+#include "../../../core/inc/ParallelAlgorithms.hpp"
+
+namespace jm = arc::core::JobManager;
+
+// Larger ranges take long enough that a single run is stable
+static int repetitions(size_t count) { return count >= 10000000 ? 1 : 5; }
+
+static void
+report_pair(const std::string& name, size_t count, double serial,
+            double parallel)
+{
+    bl::report(name + " n=" + std::to_string(count) + " serial",
+               count / serial / 1e6, "Melem/s");
+    bl::report(name + " n=" + std::to_string(count) + " parallel",
+               count / parallel / 1e6, "Melem/s");
+    bl::report(name + " n=" + std::to_string(count) + " speedup",
+               serial / parallel, "x");
+}
+
+void
+bench_for(std::vector<float>& data)
+{
+    const size_t n = data.size();
+    auto kernel = [](float& v) { v = std::sqrt(v * v + 1.0f); };
+    double serial = bl::best_of(repetitions(n), [&] {
+        std::for_each(data.begin(), data.end(), kernel);
+    });
+    double parallel = bl::best_of(repetitions(n), [&] {
+        jm::parallel_for(data.begin(), data.end(), kernel);
+    });
+    report_pair("for", n, serial, parallel);
+}
+
+void
+bench_reduce(std::vector<float>& data)
+{
+    const size_t n = data.size();
+    volatile double sink = 0.0;
+    double serial = bl::best_of(repetitions(n), [&] {
+        sink = std::accumulate(data.begin(), data.end(), 0.0);
+    });
+    double parallel = bl::best_of(repetitions(n), [&] {
+        sink = jm::parallel_reduce(data.begin(), data.end(), 0.0);
+    });
+    (void)sink;
+    report_pair("reduce", n, serial, parallel);
+}
+
+void
+bench_scan(std::vector<float>& data, std::vector<float>& out)
+{
+    const size_t n = data.size();
+    double serial = bl::best_of(repetitions(n), [&] {
+        std::inclusive_scan(data.begin(), data.end(), out.begin());
+    });
+    double parallel = bl::best_of(repetitions(n), [&] {
+        jm::parallel_scan(data.begin(), data.end(), out.begin());
+    });
+    report_pair("scan", n, serial, parallel);
+}
+
+void
+bench_sort(const std::vector<float>& data, std::vector<float>& work)
+{
+    const size_t n = data.size();
+    double serial = 1e300, parallel = 1e300;
+    /*the copy back to unsorted input is not timed*/
+    for (int i = 0; i < repetitions(n); i++) {
+        std::copy(data.begin(), data.end(), work.begin());
+        bl::Timer timer;
+        std::sort(work.begin(), work.end());
+        serial = std::min(serial, timer.elapsed_seconds());
+
+        std::copy(data.begin(), data.end(), work.begin());
+        timer.reset();
+        jm::parallel_sort(work.begin(), work.end());
+        parallel = std::min(parallel, timer.elapsed_seconds());
+    }
+    report_pair("sort", n, serial, parallel);
+}
+
+int
+main(int argc, char** argv)
+{
+    /*largest size as a power of ten, 1e8 needs about 1.2 GB, --out <path>
+     * writes the results as JSON or CSV*/
+    int max_exponent = argc > 1 && argv[1][0] != '-' ? std::atoi(argv[1]) : 8;
+    const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+    jm::initialize(std::max(1u, cores - 1));
+    bl::report("threads", jm::get_thread_count() + 1, "");
+
+    std::mt19937 rng(42);
+    std::uniform_real_distribution<float> dist(0.0f, 1.0f);
+    for (int exponent = 3; exponent <= max_exponent; exponent++) {
+        const size_t n = (size_t)std::pow(10.0, exponent);
+        std::vector<float> data(n), work(n);
+        for (float& v : data)
+            v = dist(rng);
+        bench_for(work);
+        bench_reduce(data);
+        bench_scan(data, work);
+        bench_sort(data, work);
+    }
+
+    jm::shutdown();
+
+    if (const char* path = bl::output_path(argc, argv))
+        return bl::write_results(path, "bench-parallel") ? 0 : 1;
+    return 0;
+}
@@ -0,0 +1,125 @@
+#include <chrono>
+#include <cmath>
+#include <thread>
+#include <vector>
+
+#include "../benchlib.hpp"
+
+//#include <ArcCore/FramePipeline.hpp>
+#include "../../../core/inc/FramePipeline.hpp"
+
+namespace jm = arc::core::JobManager;
+
+// Rounds of the work kernel that take a microsecond, see calibrate()
+static double rounds_per_us = 0.0;
+
+static float work(uint64_t rounds, float seed) {
+    float x = seed;
+    for (uint64_t i = 0; i < rounds; i++)
+        x = std::sqrt(x * x + 1.0f);
+    return x;
+}
+
+// Work is a fixed amount of arithmetic rather than a wall clock deadline, so
+// threads sharing a core take longer, as real update and draw code would
+static void calibrate(void) {
+    const uint64_t rounds = 1u << 24;
+    double seconds = bl::best_of(3, [&] {
+        volatile float x = work(rounds, 1.0f);
+        (void)x;
+    });
+    rounds_per_us = rounds / (seconds * 1e6);
+}
+
+static float spin_for(std::chrono::microseconds duration, float seed) {
+    return work((uint64_t)(duration.count() * rounds_per_us), seed);
+}
+
+struct Particles {
+    std::vector<float> positions;
+};
+
+// A scene whose update simulates on a worker, and whose draw spends time on
+// the main thread and then waits for a present, like a vsync or GPU fence
+class SyntheticScene : public arc::core::IPipelinedScene<Particles> {
+  public:
+    SyntheticScene(std::chrono::microseconds _update,
+                   std::chrono::microseconds _draw,
+                   std::chrono::microseconds _present)
+        : m_update(_update), m_draw(_draw), m_present(_present) {}
+
+    bool init(void) override {
+        m_positions.assign(4096, 0.0f);
+        return true;
+    }
+    bool update(void) override {
+        const float step = spin_for(m_update, m_positions[0]);
+        for (float& p : m_positions)
+            p += step * 1e-6f;
+        return true;
+    }
+    bool destroy(void) override { return true; }
+
+    void snapshot(Particles& _out) override { _out.positions = m_positions; }
+    bool draw_snapshot(const Particles& _snapshot) override {
+        m_checksum += spin_for(m_draw, _snapshot.positions.back());
+        std::this_thread::sleep_for(m_present);
+        return true;
+    }
+
+    float checksum() const { return m_checksum; }
+
+  private:
+    std::chrono::microseconds m_update, m_draw, m_present;
+    std::vector<float> m_positions;
+    float m_checksum = 0.0f;
+};
+
+// Average frame time of the synthetic scene at every pipeline depth
+void
+bench_frame_pipeline(std::chrono::microseconds update,
+                     std::chrono::microseconds draw,
+                     std::chrono::microseconds present)
+{
+    const int frames = 120;
+    const std::string costs =
+        " u=" + std::to_string(update.count() / 1000.0).substr(0, 3) +
+        " d=" + std::to_string(draw.count() / 1000.0).substr(0, 3) +
+        " p=" + std::to_string(present.count() / 1000.0).substr(0, 3);
+    for (uint32_t depth = 0; depth <= 3; depth++) {
+        SyntheticScene scene(update, draw, present);
+        scene.init();
+        auto pipeline = arc::core::make_scene_pipeline(scene, depth);
+        /*fill the pipeline before timing*/
+        for (uint32_t i = 0; i < depth + 1; i++)
+            arc::core::draw_scene_frame(pipeline, scene);
+        bl::Timer timer;
+        for (int i = 0; i < frames; i++)
+            arc::core::draw_scene_frame(pipeline, scene);
+        const double ms = timer.elapsed_seconds() * 1e3 / frames;
+        pipeline.sync();
+        bl::report("frame depth=" + std::to_string(depth) + costs, ms, "ms");
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+    jm::initialize(std::max(1u, cores - 1));
+    bl::report("threads", jm::get_thread_count() + 1, "");
+    calibrate();
+
+    using std::chrono::microseconds;
+    /*update and draw both burn a core, only overlaps with a spare core*/
+    bench_frame_pipeline(microseconds(4000), microseconds(3000), microseconds(0));
+    /*draw mostly waits on the present, which overlaps even on one core*/
+    bench_frame_pipeline(microseconds(4000), microseconds(500), microseconds(3000));
+
+    jm::shutdown();
+
+    /*--out <path> writes the results as JSON or CSV*/
+    if (const char* path = bl::output_path(argc, argv))
+        return bl::write_results(path, "bench-pipeline") ? 0 : 1;
+    return 0;
+}
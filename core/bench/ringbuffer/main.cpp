@@ -0,0 +1,105 @@
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <thread>
+
+#include "../benchlib.hpp"
+
+//#include <ArcCore/RingBuffer.hpp>
+#include "../../../core/inc/RingBuffer.hpp"
+
+using arc::core::RingBuffer;
+using arc::core::RingBufferLocked;
+using arc::core::RingBufferSPSC;
+
+// Spin on a full or empty ring, and let the other side run when both share
+// a core
+template <typename F>
+static inline void retry(F&& fn) {
+    for (uint32_t spin = 0; !fn(); spin++) {
+        if (spin >= 64)
+            std::this_thread::yield();
+    }
+}
+
+// A token bounces between two threads through a ring in each direction,
+// every round trip waits on both rings
+template <typename Policy>
+double
+ping_pong(uint32_t round_trips)
+{
+    RingBuffer<uint32_t, 64, Policy> ping;
+    RingBuffer<uint32_t, 64, Policy> pong;
+    std::thread echo([&] {
+        uint32_t token = 0;
+        for (uint32_t i = 0; i < round_trips; i++) {
+            retry([&] { return ping.pop_front(token); });
+            retry([&] { return pong.push_back(token + 1); });
+        }
+    });
+    bl::Timer timer;
+    uint32_t token = 0;
+    for (uint32_t i = 0; i < round_trips; i++) {
+        retry([&] { return ping.push_back(token); });
+        retry([&] { return pong.pop_front(token); });
+    }
+    const double seconds = timer.elapsed_seconds();
+    echo.join();
+    return token == round_trips ? seconds : -1.0;
+}
+
+// Items per second from one producer to one consumer, the ring never drains
+// for long
+template <typename Policy>
+double
+stream(uint32_t count)
+{
+    RingBuffer<uint32_t, 1024, Policy> ring;
+    std::thread producer([&] {
+        for (uint32_t i = 0; i < count; i++)
+            retry([&] { return ring.push_back(i); });
+    });
+    bl::Timer timer;
+    uint32_t item = 0;
+    uint64_t sum = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        retry([&] { return ring.pop_front(item); });
+        sum += item;
+    }
+    const double seconds = timer.elapsed_seconds();
+    producer.join();
+    return sum == (uint64_t)count * (count - 1) / 2 ? seconds : -1.0;
+}
+
+int
+main(int argc, char** argv)
+{
+    const uint32_t round_trips = 200000;
+    const uint32_t count = 10000000;
+    bl::report("hardware threads", std::thread::hardware_concurrency(), "");
+
+    double locked = 1e300;
+    double spsc = 1e300;
+    for (int rep = 0; rep < 3; rep++) {
+        locked = std::min(locked, ping_pong<RingBufferLocked>(round_trips));
+        spsc = std::min(spsc, ping_pong<RingBufferSPSC>(round_trips));
+    }
+    bl::report("ping-pong mutex round trip", locked * 1e9 / round_trips, "ns");
+    bl::report("ping-pong spsc round trip", spsc * 1e9 / round_trips, "ns");
+    bl::report("ping-pong spsc speedup", locked / spsc, "x");
+
+    locked = 1e300;
+    spsc = 1e300;
+    for (int rep = 0; rep < 3; rep++) {
+        locked = std::min(locked, stream<RingBufferLocked>(count));
+        spsc = std::min(spsc, stream<RingBufferSPSC>(count));
+    }
+    bl::report("stream mutex", count / locked / 1e6, "Mitems/s");
+    bl::report("stream spsc", count / spsc / 1e6, "Mitems/s");
+    bl::report("stream spsc speedup", locked / spsc, "x");
+
+    if (const char* path = bl::output_path(argc, argv))
+        return bl::write_results(path, "bench-ringbuffer") ? 0 : 1;
+    return 0;
+}
@@ -0,0 +1,230 @@
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "../benchlib.hpp"
+
+//#include <ArcCore/JobManager.hpp>
+#include "../../../core/inc/JobManager.hpp"
+
+namespace jm = arc::core::JobManager;
+
+// The JobManager numbers worth tracking between versions, in one run:
+//
+//     bench-suite --out bench.json
+//
+// writes them as JSON, or as CSV for a path ending in .csv. Every run prints
+// the same rows in the same order, so the files of two versions can be
+// compared row by row.
+
+// A few hundred nanoseconds of arithmetic that cannot be optimized away
+static inline float kernel(uint32_t i) {
+    float x = (float)i;
+    for (int k = 0; k < 16; k++)
+        x = std::sqrt(x * x + 1.0f);
+    return x;
+}
+
+static double percentile(std::vector<double>& samples, uint32_t percent) {
+    std::sort(samples.begin(), samples.end());
+    return samples[std::min(samples.size() - 1, samples.size() * percent / 100)];
+}
+
+static jm::JobSystemConfig pool_config(uint32_t thread_count) {
+    jm::JobSystemConfig config;
+    config.name = "arc::bench::";
+    config.thread_count = thread_count;
+    /*the same pool sizes on every machine, even past one worker per core*/
+    config.oversubscribe = true;
+    return config;
+}
+
+// Cost of execute() for an empty job, and the time until such a job ran on a
+// worker while the submitter does not help
+void
+bench_execute_latency(jm::JobSystem& system)
+{
+    const uint32_t job_count = 100000;
+    double submit = 1e300;
+    for (int rep = 0; rep < 5; rep++) {
+        jm::Context ctx;
+        bl::Timer timer;
+        for (uint32_t i = 0; i < job_count; i++)
+            system.execute(ctx, [](jm::JobArgs) {});
+        submit = std::min(submit, timer.elapsed_seconds());
+        system.wait_for(ctx);
+    }
+    bl::report("execute empty job submit", submit * 1e9 / job_count, "ns/job");
+
+    std::vector<double> round_trips;
+    for (int i = 0; i < 2000; i++) {
+        jm::Context ctx;
+        bl::Timer timer;
+        system.execute(ctx, [](jm::JobArgs) {});
+        while (jm::is_busy(ctx))
+            std::this_thread::yield();
+        round_trips.push_back(timer.elapsed_seconds() * 1e6);
+    }
+    bl::report("execute empty job round trip median", percentile(round_trips, 50), "us");
+    bl::report("execute empty job round trip p99", percentile(round_trips, 99), "us");
+}
+
+// Jobs per second of one large dispatch at every group size
+void
+bench_dispatch_group_size(jm::JobSystem& system)
+{
+    const uint32_t job_count = 1u << 20;
+    std::vector<float> out(job_count);
+    for (uint32_t group_size : {1u, 4u, 16u, 64u, 256u, 1024u, 4096u}) {
+        double seconds = bl::best_of(5, [&] {
+            jm::Context ctx;
+            system.dispatch(ctx, job_count, group_size, [&](jm::JobArgs args) {
+                out[args.job_index] = kernel(args.job_index);
+            }, 0);
+            system.wait_for(ctx);
+        });
+        bl::report("dispatch group=" + std::to_string(group_size),
+                   job_count / seconds / 1e6, "Mjobs/s");
+    }
+}
+
+// Time from the last job finishing until wait_for() returns on a parked waiter
+void
+bench_wait_for_latency(jm::JobSystem& system)
+{
+    std::vector<double> latencies;
+    for (int i = 0; i < 200; i++) {
+        std::atomic<bool> started{false};
+        std::atomic<int64_t> finished{0};
+        jm::Context ctx;
+        system.execute(ctx, [&](jm::JobArgs) {
+            started.store(true);
+            std::this_thread::sleep_for(std::chrono::microseconds(500));
+            finished.store(std::chrono::steady_clock::now().time_since_epoch().count());
+        });
+        /*make sure a worker runs the job, so wait_for has nothing to help with*/
+        while (!started.load())
+            std::this_thread::yield();
+        system.wait_for(ctx);
+        auto returned = std::chrono::steady_clock::now().time_since_epoch().count();
+        latencies.push_back((returned - finished.load()) / 1e3);
+    }
+    bl::report("wait_for wake latency median", percentile(latencies, 50), "us");
+    bl::report("wait_for wake latency p99", percentile(latencies, 99), "us");
+}
+
+// Empty jobs per second when several threads outside of the pool submit at
+// once, all of them through the injection queue
+void
+bench_submit_contention(jm::JobSystem& system, uint32_t max_submitters)
+{
+    const uint32_t jobs_per_submitter = 20000;
+    for (uint32_t submitters = 1; submitters <= max_submitters; submitters++) {
+        double seconds = bl::best_of(3, [&] {
+            jm::Context ctx;
+            std::atomic<uint32_t> ready{0};
+            std::vector<std::thread> threads;
+            for (uint32_t s = 0; s < submitters; s++) {
+                threads.emplace_back([&] {
+                    ready++;
+                    while (ready.load() < submitters)
+                        std::this_thread::yield();
+                    for (uint32_t i = 0; i < jobs_per_submitter; i++)
+                        system.execute(ctx, [](jm::JobArgs) {});
+                });
+            }
+            for (std::thread& thread : threads)
+                thread.join();
+            system.wait_for(ctx);
+        });
+        bl::report("execute contention submitters=" + std::to_string(submitters),
+                   submitters * jobs_per_submitter / seconds / 1e6, "Mjobs/s");
+    }
+}
+
+// Each job of a tree level dispatches the next level and waits on it
+static void
+nested_level(jm::JobSystem& system, uint32_t depth)
+{
+    if (depth == 0) {
+        volatile float x = kernel(depth);
+        (void)x;
+        return;
+    }
+    jm::Context ctx;
+    system.dispatch(ctx, 4, 1, [&](jm::JobArgs) { nested_level(system, depth - 1); }, 0);
+    system.wait_for(ctx);
+}
+
+// Trees of jobs that wait on the dispatches they made, 4^depth leaves
+void
+bench_nested_dispatch(jm::JobSystem& system)
+{
+    for (uint32_t depth : {2u, 4u, 6u}) {
+        double seconds = bl::best_of(5, [&] {
+            jm::Context root;
+            system.execute(root, [&](jm::JobArgs) { nested_level(system, depth); });
+            /*only workers nest, the submitter polls*/
+            while (jm::is_busy(root))
+                std::this_thread::yield();
+        });
+        bl::report("nested dispatch depth=" + std::to_string(depth),
+                   seconds * 1e3, "ms");
+    }
+}
+
+// The same dispatch with 1 to hardware_concurrency threads taking part, the
+// submitter included, against a plain loop
+void
+bench_scaling(uint32_t max_threads)
+{
+    const uint32_t job_count = 1u << 22;
+    std::vector<float> out(job_count);
+    auto task = [&out](jm::JobArgs args) { out[args.job_index] = kernel(args.job_index); };
+
+    const double serial = bl::best_of(3, [&] {
+        jm::JobArgs args{};
+        for (uint32_t i = 0; i < job_count; i++) {
+            args.job_index = i;
+            task(args);
+        }
+    });
+    bl::report("scaling threads=1", job_count / serial / 1e6, "Mjobs/s");
+
+    for (uint32_t threads = 2; threads <= std::max(2u, max_threads); threads++) {
+        jm::JobSystem system(pool_config(threads - 1));
+        double seconds = bl::best_of(3, [&] {
+            jm::Context ctx;
+            system.dispatch(ctx, job_count, 1024, task, 0);
+            system.wait_for(ctx);
+        });
+        const std::string name = "scaling threads=" + std::to_string(threads);
+        bl::report(name, job_count / seconds / 1e6, "Mjobs/s");
+        bl::report(name + " efficiency", 100.0 * serial / (seconds * threads), "%");
+    }
+}
+
+int
+main(int argc, char** argv)
+{
+    const uint32_t cores = std::max(1u, std::thread::hardware_concurrency());
+    bl::report("hardware threads", cores, "");
+
+    /*pools of their own for every thread count, owned by this thread*/
+    bench_scaling(cores);
+
+    jm::JobSystem system(pool_config(std::max(1u, cores - 1)));
+    bl::report("workers", system.get_thread_count(), "");
+    bench_execute_latency(system);
+    bench_dispatch_group_size(system);
+    bench_wait_for_latency(system);
+    bench_submit_contention(system, std::max(2u, cores));
+    bench_nested_dispatch(system);
+    system.shutdown();
+
+    if (const char* path = bl::output_path(argc, argv))
+        return bl::write_results(path, "bench-suite") ? 0 : 1;
+    return 0;
+}
@@ -1,7 +1,10 @@
 #pragma once
 
+#include <chrono>
+
 #include "Defs.hpp"
 #include "Logger.hpp"
+#include "MainThreadQueue.hpp"
 #include "SceneManager.hpp"
 
 namespace arc {
@@ -24,6 +27,8 @@ class BaseScene : public IScene {
 class App {
     Logger* m_logger{nullptr};
     SceneManager m_scene_manager{};
+    core::MainThreadQueue m_main_thread_queue{};
+    std::chrono::microseconds m_main_thread_budget{2000};
 
   public:
     App(void);
@@ -46,6 +51,11 @@ class App {
     SceneKey scene_active_set(SceneKey _scene);
     [[nodiscard]] std::string scene_name(SceneKey _scene);
 
+    /*Main Thread Methods*/
+    core::MainThreadQueue& main_thread_queue(void);
+    void main_thread_budget_set(std::chrono::microseconds _budget);
+    /*Call once per frame from the main thread, the engine does not yet*/
+    size_t drain_main_thread(void);
 };
 
 }; /*namespace arc*/
@@ -0,0 +1,294 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <map>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
+#include "Defs.hpp"
+
+#ifdef PLATFORM_LINUX
+#include <sched.h>
+#endif // PLATFORM_LINUX
+
+namespace arc {
+namespace core {
+
+/* @brief A logical CPU and the hardware it shares with other CPUs.
+ *
+ * Everything besides cpu is a dense index, only comparable between CPUs of the
+ * same CpuTopology.
+ */
+struct CpuInfo {
+    uint32_t cpu;       // logical CPU number used by the OS
+    uint32_t core;      // physical core, shared by SMT siblings
+    uint32_t smt;       // position among the SMT siblings of core
+    uint32_t l3;        // last level cache domain, a CCX on multi-CCX parts
+    uint32_t numa_node;
+};
+
+/* @brief Order in which threads are handed out CPUs, see placement_order()
+ */
+enum PlacementPolicy : uint8_t {
+    PLACEMENT_NONE = 0,       // threads are left to the OS scheduler
+    PLACEMENT_PHYSICAL_CORES, // a CPU on every physical core before SMT siblings
+    PLACEMENT_COMPACT,        // fill a core, then its L3 domain, then move on
+    PLACEMENT_SCATTER,        // round robin over NUMA nodes and L3 domains
+};
+
+/* @brief Layout of the logical CPUs of the machine.
+ *
+ * On Linux it is read from sysfs: cores and SMT siblings from
+ * cpu/cpuN/topology, L3 domains from the level 3 entry of cpu/cpuN/cache and
+ * NUMA nodes from node/nodeN/cpulist. Anything that cannot be read falls back
+ * to every CPU being its own core in a single L3 domain and NUMA node.
+ */
+struct CpuTopology {
+    std::vector<CpuInfo> cpus; // sorted by cpu
+    uint32_t n_cores = 0;
+    uint32_t n_l3 = 0;
+    uint32_t n_numa_nodes = 0;
+
+    /* @brief Read the topology below a sysfs directory
+     *
+     * @param _sysfs: directory holding cpu/ and node/
+     */
+    static CpuTopology discover(
+        const std::string& _sysfs = "/sys/devices/system") {
+        CpuTopology topology;
+        std::string online;
+        if (!read_line(_sysfs + "/cpu/online", online)) {
+            return fallback();
+        }
+
+        std::map<uint32_t, uint32_t> numa_of;
+        std::string nodes;
+        if (read_line(_sysfs + "/node/online", nodes)) {
+            for (uint32_t node : parse_cpu_list(nodes)) {
+                std::string list;
+                read_line(_sysfs + "/node/node" + std::to_string(node) +
+                              "/cpulist",
+                          list);
+                for (uint32_t cpu : parse_cpu_list(list))
+                    numa_of[cpu] = node;
+            }
+        }
+
+        for (uint32_t cpu : parse_cpu_list(online)) {
+            const std::string dir = _sysfs + "/cpu/cpu" + std::to_string(cpu);
+            std::string line;
+            CpuInfo info{cpu, cpu, 0, ~0u, 0};
+
+            // A core is named by its first SMT sibling
+            if (read_line(dir + "/topology/thread_siblings_list", line)) {
+                std::vector<uint32_t> siblings = parse_cpu_list(line);
+                if (!siblings.empty())
+                    info.core = siblings.front();
+            }
+            // An L3 domain is named by its first CPU
+            for (int index = 0; index < 8; index++) {
+                const std::string cache =
+                    dir + "/cache/index" + std::to_string(index);
+                if (!read_line(cache + "/level", line))
+                    break;
+                if (line == "3" &&
+                    read_line(cache + "/shared_cpu_list", line)) {
+                    std::vector<uint32_t> shared = parse_cpu_list(line);
+                    if (!shared.empty())
+                        info.l3 = shared.front();
+                }
+            }
+            auto node = numa_of.find(cpu);
+            if (node != numa_of.end())
+                info.numa_node = node->second;
+            topology.cpus.push_back(info);
+        }
+        if (topology.cpus.empty()) {
+            return fallback();
+        }
+        topology.compact();
+        return topology;
+    }
+
+    /* @brief Topology of the CPUs the calling thread is allowed to run on
+     */
+    static CpuTopology current() {
+        CpuTopology topology = discover();
+#ifdef PLATFORM_LINUX
+        cpu_set_t allowed;
+        CPU_ZERO(&allowed);
+        if (sched_getaffinity(0, sizeof(allowed), &allowed) == 0) {
+            std::vector<CpuInfo> kept;
+            for (const CpuInfo& info : topology.cpus) {
+                if (info.cpu < CPU_SETSIZE && CPU_ISSET(info.cpu, &allowed))
+                    kept.push_back(info);
+            }
+            if (!kept.empty() && kept.size() != topology.cpus.size()) {
+                topology.cpus = kept;
+                topology.compact();
+            }
+        }
+#endif // PLATFORM_LINUX
+        return topology;
+    }
+
+    /* @brief The same topology restricted to some of its CPUs
+     *
+     * CPUs that are not part of the topology are ignored, if none are left the
+     * topology is returned unchanged.
+     */
+    CpuTopology subset(const std::vector<uint32_t>& _cpus) const {
+        CpuTopology topology;
+        for (const CpuInfo& info : cpus) {
+            if (std::find(_cpus.begin(), _cpus.end(), info.cpu) != _cpus.end())
+                topology.cpus.push_back(info);
+        }
+        if (topology.cpus.empty())
+            return *this;
+        topology.compact();
+        return topology;
+    }
+
+    /* @brief Every CPU, in the order threads should be placed on them
+     *
+     * @param _policy: see PlacementPolicy, PLACEMENT_NONE returns nothing
+     */
+    std::vector<CpuInfo> placement_order(PlacementPolicy _policy) const {
+        std::vector<CpuInfo> order;
+        if (_policy == PLACEMENT_NONE)
+            return order;
+        order = cpus;
+
+        auto compact_key = [](const CpuInfo& c) {
+            return std::make_tuple(c.numa_node, c.l3, c.core, c.smt);
+        };
+        if (_policy == PLACEMENT_COMPACT) {
+            std::stable_sort(order.begin(), order.end(),
+                             [&](const CpuInfo& a, const CpuInfo& b) {
+                                 return compact_key(a) < compact_key(b);
+                             });
+        } else if (_policy == PLACEMENT_PHYSICAL_CORES) {
+            std::stable_sort(order.begin(), order.end(),
+                             [&](const CpuInfo& a, const CpuInfo& b) {
+                                 return std::make_tuple(a.smt, compact_key(a)) <
+                                        std::make_tuple(b.smt, compact_key(b));
+                             });
+        } else {
+            // Rank every core within its L3 domain and every L3 domain within
+            // its NUMA node, then deal them out like cards
+            std::map<uint32_t, uint32_t> core_rank, l3_rank;
+            std::map<uint32_t, uint32_t> cores_in_l3, l3_in_numa;
+            for (const CpuInfo& c : sorted_by(compact_key)) {
+                if (c.smt != 0)
+                    continue;
+                if (core_rank.count(c.core) == 0)
+                    core_rank[c.core] = cores_in_l3[c.l3]++;
+                if (l3_rank.count(c.l3) == 0)
+                    l3_rank[c.l3] = l3_in_numa[c.numa_node]++;
+            }
+            auto scatter_key = [&](const CpuInfo& c) {
+                return std::make_tuple(c.smt, core_rank[c.core], l3_rank[c.l3],
+                                       c.numa_node);
+            };
+            std::stable_sort(order.begin(), order.end(),
+                             [&](const CpuInfo& a, const CpuInfo& b) {
+                                 return scatter_key(a) < scatter_key(b);
+                             });
+        }
+        return order;
+    }
+
+    const CpuInfo* find(uint32_t _cpu) const {
+        for (const CpuInfo& info : cpus) {
+            if (info.cpu == _cpu)
+                return &info;
+        }
+        return nullptr;
+    }
+
+    /* @brief Parse a sysfs CPU list such as "0-3,8,10-11"
+     */
+    static std::vector<uint32_t> parse_cpu_list(const std::string& _list) {
+        std::vector<uint32_t> out;
+        size_t pos = 0;
+        while (pos < _list.size()) {
+            size_t end = _list.find(',', pos);
+            if (end == std::string::npos)
+                end = _list.size();
+            const std::string range = _list.substr(pos, end - pos);
+            const size_t dash = range.find('-');
+            try {
+                if (dash == std::string::npos) {
+                    out.push_back((uint32_t)std::stoul(range));
+                } else {
+                    uint32_t first = (uint32_t)std::stoul(range.substr(0, dash));
+                    uint32_t last = (uint32_t)std::stoul(range.substr(dash + 1));
+                    for (uint32_t cpu = first; cpu <= last; cpu++)
+                        out.push_back(cpu);
+                }
+            } catch (const std::exception&) {
+                // malformed entries are skipped
+            }
+            pos = end + 1;
+        }
+        return out;
+    }
+
+  private:
+    static bool read_line(const std::string& _path, std::string& _line) {
+        std::ifstream file(_path);
+        if (!file || !std::getline(file, _line))
+            return false;
+        while (!_line.empty() && (_line.back() == '\n' || _line.back() == ' '))
+            _line.pop_back();
+        return true;
+    }
+
+    static CpuTopology fallback() {
+        CpuTopology topology;
+        const uint32_t count = std::max(1u, std::thread::hardware_concurrency());
+        for (uint32_t cpu = 0; cpu < count; cpu++)
+            topology.cpus.push_back(CpuInfo{cpu, cpu, 0, 0, 0});
+        topology.compact();
+        return topology;
+    }
+
+    template <typename Key>
+    std::vector<CpuInfo> sorted_by(Key key) const {
+        std::vector<CpuInfo> sorted = cpus;
+        std::stable_sort(sorted.begin(), sorted.end(),
+                         [&](const CpuInfo& a, const CpuInfo& b) {
+                             return key(a) < key(b);
+                         });
+        return sorted;
+    }
+
+    // Turn the raw core, L3 and node names into dense indices and number the
+    // SMT siblings of every core
+    void compact() {
+        std::sort(cpus.begin(), cpus.end(),
+                  [](const CpuInfo& a, const CpuInfo& b) { return a.cpu < b.cpu; });
+        std::map<uint32_t, uint32_t> cores, l3s, nodes, siblings;
+        for (CpuInfo& info : cpus) {
+            if (info.l3 == ~0u)
+                info.l3 = info.core; // no shared L3, every core is a domain
+            auto core = cores.emplace(info.core, (uint32_t)cores.size()).first;
+            auto l3 = l3s.emplace(info.l3, (uint32_t)l3s.size()).first;
+            auto node = nodes.emplace(info.numa_node, (uint32_t)nodes.size()).first;
+            info.smt = siblings[core->second]++;
+            info.core = core->second;
+            info.l3 = l3->second;
+            info.numa_node = node->second;
+        }
+        n_cores = (uint32_t)cores.size();
+        n_l3 = (uint32_t)l3s.size();
+        n_numa_nodes = (uint32_t)nodes.size();
+    }
+};
+
+} /*ns*/
+} /*ns*/
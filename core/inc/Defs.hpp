@@ -20,6 +20,12 @@
 //   #include <deque>
 //   #include <thread>
 
+#ifndef PLATFORM_LINUX
+#  if defined(__linux__)
+#    define PLATFORM_LINUX
+#  endif
+#endif
+
 #ifndef ARC_ASSERT
 #  define ARC_ASSERT(X) assert(X)
 #endif
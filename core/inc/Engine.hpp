@@ -2,6 +2,8 @@
 
 #include "Defs.hpp"
 #include "App.hpp"
+#include "ParallelAlgorithms.hpp"
+#include "SystemScheduler.hpp"
 
 namespace arc {
     
@@ -11,9 +13,27 @@ class GameScene;
 using ECSSystem = std::function<void(GameScene*)>;
 //using ECSSystem = std::function<void(Engine*, entt::registry*)>;
 
+// Call fn(entity) for every entity of an entt view, in parallel chunks of
+// grain entities, see core::JobManager::parallel_for()
+//	Chunks are taken from the smallest storage of the view, fn must only
+// touch the components of its own entity
+template <typename View, typename F>
+void parallel_each(View& _view, F&& _fn, size_t _grain = 0)
+{
+    const auto& leading = *_view.handle();
+    core::JobManager::parallel_for(
+        leading.begin(), leading.end(),
+        [&](const entt::entity entity) {
+            if (_view.contains(entity))
+                _fn(entity);
+        },
+        _grain);
+}
+
 class GameScene : public IScene {
     entt::registry m_ECS = entt::registry();
     Engine* m_engine = nullptr;
+    core::SystemScheduler<GameScene> m_systems{};
 
 public:
     entt::registry* ECS(void)
@@ -28,9 +48,23 @@ public:
 
     void set_engine(Engine* _e) {m_engine = _e;};
 
+    // Systems of ECS_tick(), added with the components they read and write
+    core::SystemScheduler<GameScene>& systems(void)
+    {
+        return m_systems;
+    };
+
+    // Run systems() on the job pool, systems that touch different components
+    // at the same time, and wait for them
+    void ECS_tick(void)
+    {
+        m_systems.run(*this);
+    };
+
+    // Run _systems one after another on the calling thread
     void ECS_tick(std::vector<ECSSystem>& _systems)
     {
-        for (auto system: _systems)
+        for (const auto& system: _systems)
             system(this);
     };
 };
@@ -0,0 +1,209 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "Defs.hpp"
+
+// Fibers need mmap for their stacks, so they are only available on Linux
+#ifdef PLATFORM_LINUX
+#define ARC_FIBERS 1
+
+#include <new>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if !defined(__x86_64__)
+#include <ucontext.h>
+#endif
+
+#if defined(__SANITIZE_ADDRESS__)
+#include <sanitizer/common_interface_defs.h>
+#endif
+
+namespace arc {
+namespace core {
+
+#if defined(__x86_64__)
+// Save the callee saved registers of the System V ABI on the current stack,
+// store the stack pointer in *from_sp and continue on to_sp
+//	Written by hand as swapcontext() also saves the signal mask, which costs a
+// system call on every switch
+__attribute__((naked, noinline)) inline void fiber_switch(void** /*from_sp*/,
+                                                          void* /*to_sp*/) {
+    asm volatile("pushq %rbp\n\t"
+                 "pushq %rbx\n\t"
+                 "pushq %r12\n\t"
+                 "pushq %r13\n\t"
+                 "pushq %r14\n\t"
+                 "pushq %r15\n\t"
+                 "subq $8, %rsp\n\t"
+                 "stmxcsr (%rsp)\n\t"
+                 "fnstcw 4(%rsp)\n\t"
+                 "movq %rsp, (%rdi)\n\t"
+                 "movq %rsi, %rsp\n\t"
+                 "ldmxcsr (%rsp)\n\t"
+                 "fldcw 4(%rsp)\n\t"
+                 "addq $8, %rsp\n\t"
+                 "popq %r15\n\t"
+                 "popq %r14\n\t"
+                 "popq %r13\n\t"
+                 "popq %r12\n\t"
+                 "popq %rbx\n\t"
+                 "popq %rbp\n\t"
+                 "ret\n\t");
+}
+
+// First code run by a fiber, calls entry(arg) from r13 and r12 with the stack
+// aligned like any other call
+__attribute__((naked, noinline)) inline void fiber_trampoline() {
+    asm volatile("movq %r12, %rdi\n\t"
+                 "callq *%r13\n\t"
+                 "ud2\n\t");
+}
+#endif // __x86_64__
+
+/* @brief A stack and the registers to continue on it.
+ *
+ * Fibers are switched cooperatively with switch_to(). A default constructed
+ * Fiber stands for the stack of the calling thread, so the thread can switch
+ * to other fibers and be switched back to. Other fibers get a stack of their
+ * own, with an unmapped guard page below it so an overflow faults instead of
+ * corrupting the neighbouring memory.
+ */
+class Fiber {
+  public:
+    using Entry = void (*)(void*);
+
+    Fiber() = default;
+
+    /* @brief Create a fiber that runs entry(arg) when it is first switched to
+     *
+     * entry must never return, it has to switch to another fiber instead.
+     * @param _stack_size: usable bytes of stack, rounded up to whole pages
+     */
+    Fiber(size_t _stack_size, Entry _entry, void* _arg) {
+        const size_t page = (size_t)sysconf(_SC_PAGESIZE);
+        m_stack_size = (_stack_size + page - 1) / page * page;
+        m_mapped = m_stack_size + page;
+        void* memory = mmap(nullptr, m_mapped, PROT_READ | PROT_WRITE,
+                            MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE |
+                                MAP_STACK,
+                            -1, 0);
+        if (memory == MAP_FAILED)
+            throw std::bad_alloc();
+        mprotect(memory, page, PROT_NONE); // the stack grows down into it
+        m_mapping = memory;
+        m_stack = static_cast<uint8_t*>(memory) + page;
+
+#if defined(__x86_64__)
+        // Lay out the frame fiber_switch() pops: control words, r15-r12,
+        // rbx, rbp and the return address, leaving the stack 16 byte aligned
+        // after the return
+        uintptr_t top = (reinterpret_cast<uintptr_t>(m_stack) + m_stack_size) &
+                        ~uintptr_t(15);
+        void** frame = reinterpret_cast<void**>(top - 80);
+        const uint32_t control[2] = {0x1F80, 0x037F}; // default mxcsr, x87 cw
+        __builtin_memcpy(&frame[0], control, sizeof(control));
+        frame[1] = nullptr;                               // r15
+        frame[2] = nullptr;                               // r14
+        frame[3] = reinterpret_cast<void*>(_entry);       // r13
+        frame[4] = _arg;                                  // r12
+        frame[5] = nullptr;                               // rbx
+        frame[6] = nullptr;                               // rbp
+        frame[7] = reinterpret_cast<void*>(&fiber_trampoline); // return address
+        m_sp = frame;
+#else
+        getcontext(&m_context);
+        m_context.uc_stack.ss_sp = m_stack;
+        m_context.uc_stack.ss_size = m_stack_size;
+        m_context.uc_link = nullptr;
+        // makecontext only passes ints, the pointers are split in halves
+        const uint64_t entry = reinterpret_cast<uintptr_t>(_entry);
+        const uint64_t arg = reinterpret_cast<uintptr_t>(_arg);
+        makecontext(&m_context, reinterpret_cast<void (*)()>(&ucontext_entry),
+                    4, (uint32_t)(entry >> 32), (uint32_t)entry,
+                    (uint32_t)(arg >> 32), (uint32_t)arg);
+#endif
+    }
+
+    Fiber(const Fiber&) = delete;
+    Fiber& operator=(const Fiber&) = delete;
+
+    ~Fiber() {
+        if (m_mapping != nullptr)
+            munmap(m_mapping, m_mapped);
+    }
+
+    /* @brief Suspend the calling fiber, which must be this one, and continue
+     * next. Returns once some fiber switches back to this one.
+     */
+    void switch_to(Fiber& _next) {
+#if defined(__SANITIZE_ADDRESS__)
+        void* fake_stack = nullptr;
+        s_previous = this;
+        __sanitizer_start_switch_fiber(&fake_stack, _next.m_stack,
+                                       _next.m_stack_size);
+#endif
+#if defined(__x86_64__)
+        fiber_switch(&m_sp, _next.m_sp);
+#else
+        swapcontext(&m_context, &_next.m_context);
+#endif
+#if defined(__SANITIZE_ADDRESS__)
+        started_on(fake_stack);
+#endif
+    }
+
+    /* @brief Must be the first call of a fiber entry, keeps sanitizers in
+     * step with the switch that started the fiber
+     */
+    void started() {
+#if defined(__SANITIZE_ADDRESS__)
+        started_on(nullptr);
+#endif
+    }
+
+    bool owns_stack() const { return m_mapping != nullptr; }
+    size_t stack_size() const { return m_stack_size; }
+
+  private:
+#if defined(__SANITIZE_ADDRESS__)
+    // Records the bounds of the stack that was left, which is how the stack
+    // of a thread fiber becomes known
+    void started_on(void* _fake_stack) {
+        const void* bottom = nullptr;
+        size_t size = 0;
+        __sanitizer_finish_switch_fiber(_fake_stack, &bottom, &size);
+        if (s_previous != nullptr && s_previous->m_mapping == nullptr) {
+            s_previous->m_stack = const_cast<void*>(bottom);
+            s_previous->m_stack_size = size;
+        }
+    }
+
+    static inline thread_local Fiber* s_previous = nullptr; // fiber left last
+#endif
+
+#if !defined(__x86_64__)
+    static void ucontext_entry(uint32_t _entry_high, uint32_t _entry_low,
+                               uint32_t _arg_high, uint32_t _arg_low) {
+        Entry entry = reinterpret_cast<Entry>(
+            (uintptr_t)(((uint64_t)_entry_high << 32) | _entry_low));
+        entry(reinterpret_cast<void*>(
+            (uintptr_t)(((uint64_t)_arg_high << 32) | _arg_low)));
+    }
+
+    ucontext_t m_context;
+#else
+    void* m_sp = nullptr;
+#endif
+    void* m_mapping = nullptr; // stack plus guard page, nullptr for a thread
+    size_t m_mapped = 0;
+    void* m_stack = nullptr;
+    size_t m_stack_size = 0;
+};
+
+} /*ns*/
+} /*ns*/
+
+#endif // PLATFORM_LINUX
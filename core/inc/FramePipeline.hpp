@@ -0,0 +1,194 @@
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+
+#include "JobManager.hpp"
+#include "MainThreadQueue.hpp"
+#include "SceneManager.hpp"
+
+namespace arc {
+namespace core {
+
+/* @brief Runs the update of later frames on the job pool while the calling
+ * thread draws an earlier one.
+ *
+ * Every update writes what drawing needs into a Snapshot of its own, and the
+ * draw of that frame only reads the snapshot, so the update of frame N+1 can
+ * run while frame N is drawn. With a depth of d, up to d updates run ahead of
+ * the frame being drawn and frame time drops from update + draw towards
+ * max(update, draw), at the cost of d frames of latency:
+ *
+ *     FramePipeline<DrawList> pipeline(
+ *         [&](uint64_t frame, DrawList& out) {
+ *             world.step(dt);
+ *             world.build_draw_list(out);
+ *         },
+ *         2);
+ *
+ *     while (running) {
+ *         pipeline.frame([&](const DrawList& list, uint64_t frame) {
+ *             renderer.submit(list);
+ *         });
+ *     }
+ *     pipeline.sync();
+ *
+ * Given a MainThreadQueue, see set_main_thread_queue(), every frame() also
+ * runs the jobs posted to it, so the drawing thread is the main thread.
+ *
+ * Updates run one after another, each starts when the previous one finished,
+ * so the update function owns the simulation state without locking. Anything
+ * else that touches that state from the calling thread has to sync() first.
+ * Depth 0 runs update and draw back to back, like a plain frame loop.
+ */
+template <typename Snapshot>
+class FramePipeline {
+  public:
+    using Update = std::function<void(uint64_t frame, Snapshot& out)>;
+
+    static constexpr uint32_t max_depth = 3;
+
+    explicit FramePipeline(
+        Update _update, uint32_t _depth = 1,
+        JobManager::JobSystem& _system = JobManager::default_job_system())
+        : m_update(std::move(_update)), m_system(&_system) {
+        set_depth(_depth);
+    }
+
+    // Waits for the updates in flight, their frames are never drawn
+    ~FramePipeline() { sync(); }
+
+    FramePipeline(const FramePipeline&) = delete;
+    FramePipeline& operator=(const FramePipeline&) = delete;
+
+    /* @brief Draw the next frame, starting updates up to depth frames ahead
+     *
+     * Drains the MainThreadQueue, if there is one, then blocks until the
+     * update of the frame to draw has finished, helping with jobs meanwhile,
+     * then calls draw(const Snapshot&, frame) on the calling thread.
+     * @return index of the frame that was drawn
+     */
+    template <typename Draw>
+    uint64_t frame(Draw&& draw) {
+        while (m_next_update <= m_next_draw + m_depth) {
+            launch(m_next_update++);
+        }
+        if (m_main_queue != nullptr) {
+            m_main_queue->drain(m_main_budget);
+        }
+        Slot& slot = m_slots[m_next_draw % slot_count];
+        m_system->wait_for(slot.updated);
+        draw(static_cast<const Snapshot&>(slot.snapshot), m_next_draw);
+        return m_next_draw++;
+    }
+
+    /* @brief Wait until every update in flight has finished
+     *
+     * Their snapshots are still drawn by the following frames. No update runs
+     * between sync() and the next frame(), so the calling thread may touch the
+     * simulation state.
+     */
+    void sync() {
+        for (Slot& slot : m_slots) {
+            m_system->wait_for(slot.updated);
+        }
+    }
+
+    /* @brief Frames that may be updated ahead of the one being drawn, from 0
+     * to max_depth. Takes effect on the next frame()
+     *
+     * Lowering the depth does not cancel updates that already started.
+     */
+    void set_depth(uint32_t _depth) {
+        m_depth = std::min(_depth, max_depth);
+    }
+
+    uint32_t depth() const { return m_depth; }
+
+    /* @brief Run the jobs posted to _queue at the start of every frame(), for
+     * at most _budget, see MainThreadQueue::drain(). Null stops draining
+     *
+     * Updates must not wait on jobs posted to the queue, the thread draining
+     * it waits on them.
+     */
+    void set_main_thread_queue(
+        MainThreadQueue* _queue,
+        std::chrono::microseconds _budget = std::chrono::microseconds(2000)) {
+        m_main_queue = _queue;
+        m_main_budget = _budget;
+    }
+
+    // Frames drawn so far
+    uint64_t frames_drawn() const { return m_next_draw; }
+
+  private:
+    // Enough for max_depth updates in flight next to the frame being drawn
+    static constexpr uint32_t slot_count = max_depth + 1;
+
+    struct Slot {
+        Snapshot snapshot{};
+        JobManager::Context updated; // busy while the update of the slot runs
+    };
+
+    // Queue the update of a frame behind the update of the frame before it
+    //	The slot was last written for frame - slot_count, which was drawn
+    // already, and the slot of the previous frame is not reused before this
+    // update drained
+    void launch(uint64_t frame) {
+        Slot& slot = m_slots[frame % slot_count];
+        Slot& previous = m_slots[(frame + slot_count - 1) % slot_count];
+        m_system->execute(slot.updated, {&previous.updated},
+                          [this, frame, &slot](JobManager::JobArgs) {
+                              m_update(frame, slot.snapshot);
+                          });
+    }
+
+    Update m_update;
+    JobManager::JobSystem* m_system;
+    uint32_t m_depth = 1;
+    uint64_t m_next_update = 0; // first frame whose update was not started
+    uint64_t m_next_draw = 0;
+    std::array<Slot, slot_count> m_slots;
+    MainThreadQueue* m_main_queue = nullptr; // drained by frame()
+    std::chrono::microseconds m_main_budget{2000};
+};
+
+/* @brief A scene whose draw() can overlap its next update(), see
+ * FramePipeline and make_scene_pipeline()
+ */
+template <typename Snapshot>
+class IPipelinedScene : public IScene {
+  public:
+    // Copy what drawing needs, called on a worker right after update()
+    virtual void snapshot(Snapshot& _out) = 0;
+    // Draw from a snapshot instead of the live state, on the drawing thread
+    virtual bool draw_snapshot(const Snapshot& _snapshot) = 0;
+};
+
+// Pipeline running update() and snapshot() of a scene on the job pool, draw
+// its frames with draw_scene_frame()
+template <typename Snapshot>
+FramePipeline<Snapshot> make_scene_pipeline(
+    IPipelinedScene<Snapshot>& _scene, uint32_t _depth = 1,
+    JobManager::JobSystem& _system = JobManager::default_job_system()) {
+    return FramePipeline<Snapshot>(
+        [&_scene](uint64_t, Snapshot& out) {
+            _scene.update();
+            _scene.snapshot(out);
+        },
+        _depth, _system);
+}
+
+template <typename Snapshot>
+uint64_t draw_scene_frame(FramePipeline<Snapshot>& _pipeline,
+                          IPipelinedScene<Snapshot>& _scene) {
+    return _pipeline.frame([&_scene](const Snapshot& snapshot, uint64_t) {
+        _scene.draw_snapshot(snapshot);
+    });
+}
+
+} /*ns*/
+} /*ns*/
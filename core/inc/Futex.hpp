@@ -0,0 +1,68 @@
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <cstdint>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif // __linux__
+
+namespace arc {
+namespace core {
+
+// Hint to the CPU that we are busy waiting, lets an SMT sibling run
+inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#elif defined(__aarch64__)
+    asm volatile("yield");
+#endif
+}
+
+// Block while word == expected, or until woken by futex_wake()
+//	May return spuriously, callers must re-check their condition
+//	On Linux this is a private futex, elsewhere std::atomic::wait is used when
+// available and a yield otherwise
+inline void futex_wait(std::atomic<uint32_t>& word, uint32_t expected) {
+#if defined(__linux__)
+    static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t));
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAIT_PRIVATE,
+            expected, nullptr, nullptr, 0);
+#elif defined(__cpp_lib_atomic_wait)
+    word.wait(expected);
+#else
+    (void)word;
+    (void)expected;
+    std::this_thread::yield();
+#endif
+}
+
+// Wake up to count threads blocked in futex_wait() on word
+//	Only the address of word is used, so it is safe to call after the waiter
+// may have returned and released the memory
+inline void futex_wake(std::atomic<uint32_t>& word, int count) {
+#if defined(__linux__)
+    syscall(SYS_futex, reinterpret_cast<uint32_t*>(&word), FUTEX_WAKE_PRIVATE,
+            count, nullptr, nullptr, 0);
+#elif defined(__cpp_lib_atomic_wait)
+    if (count == 1) {
+        word.notify_one();
+    } else {
+        word.notify_all();
+    }
+#else
+    (void)word;
+    (void)count;
+#endif
+}
+
+inline void futex_wake_all(std::atomic<uint32_t>& word) {
+    futex_wake(word, INT_MAX);
+}
+
+} /*ns*/
+} /*ns*/
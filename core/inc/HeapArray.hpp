@@ -4,6 +4,9 @@
 #include <memory>
 #include <exception>
 #include <initializer_list>
+#include <algorithm>
+#include <ostream>
+#include <stdexcept>
 
 namespace arc {
 namespace core {
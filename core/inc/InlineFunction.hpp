@@ -0,0 +1,122 @@
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace arc {
+namespace core {
+
+template <typename Signature, size_t Capacity = 64>
+class InlineFunction;
+
+/* @brief InlineFunction is a move-only, fixed capacity std::function.
+ *
+ * The callable is always stored inside the object, there is no heap fallback.
+ * Constructing an InlineFunction from a callable larger than Capacity is a
+ * compile error, instead of a silent allocation.
+ *
+ * @template R(Args...): call signature.
+ * @template Capacity: bytes of inline storage for the callable.
+ */
+template <typename R, typename... Args, size_t Capacity>
+class InlineFunction<R(Args...), Capacity> {
+  public:
+    InlineFunction() noexcept = default;
+    InlineFunction(std::nullptr_t) noexcept {}
+
+    template <typename F,
+              typename = std::enable_if_t<
+                  !std::is_same_v<std::decay_t<F>, InlineFunction>>>
+    InlineFunction(F&& _f) {
+        emplace(std::forward<F>(_f));
+    }
+
+    InlineFunction(InlineFunction&& _other) noexcept { move_from(_other); }
+
+    InlineFunction& operator=(InlineFunction&& _other) noexcept {
+        if (this != &_other) {
+            reset();
+            move_from(_other);
+        }
+        return *this;
+    }
+
+    InlineFunction(const InlineFunction&) = delete;
+    InlineFunction& operator=(const InlineFunction&) = delete;
+
+    ~InlineFunction() { reset(); }
+
+    /* @brief Replace the stored callable
+     */
+    template <typename F>
+    void emplace(F&& _f) {
+        using Fn = std::decay_t<F>;
+        static_assert(sizeof(Fn) <= Capacity,
+                      "callable does not fit in InlineFunction, capture less "
+                      "or increase Capacity");
+        static_assert(alignof(Fn) <= alignof(std::max_align_t),
+                      "callable is over-aligned for InlineFunction");
+        static_assert(std::is_invocable_r_v<R, Fn&, Args...>,
+                      "callable does not match the InlineFunction signature");
+        reset();
+        ::new (static_cast<void*>(m_storage)) Fn(std::forward<F>(_f));
+        m_ops = &s_ops<Fn>;
+    }
+
+    /* @brief Destroy the stored callable, if any
+     */
+    void reset() noexcept {
+        if (m_ops != nullptr) {
+            m_ops->destroy(m_storage);
+            m_ops = nullptr;
+        }
+    }
+
+    R operator()(Args... _args) {
+        return m_ops->invoke(m_storage, std::forward<Args>(_args)...);
+    }
+
+    explicit operator bool() const noexcept { return m_ops != nullptr; }
+
+  private:
+    struct Ops {
+        R (*invoke)(void*, Args&&...);
+        void (*move)(void*, void*) noexcept;
+        void (*destroy)(void*) noexcept;
+    };
+
+    template <typename Fn>
+    static R invoke_fn(void* _f, Args&&... _args) {
+        return (*static_cast<Fn*>(_f))(std::forward<Args>(_args)...);
+    }
+
+    template <typename Fn>
+    static void move_fn(void* _dst, void* _src) noexcept {
+        ::new (_dst) Fn(std::move(*static_cast<Fn*>(_src)));
+        static_cast<Fn*>(_src)->~Fn();
+    }
+
+    template <typename Fn>
+    static void destroy_fn(void* _f) noexcept {
+        static_cast<Fn*>(_f)->~Fn();
+    }
+
+    template <typename Fn>
+    static constexpr Ops s_ops{&invoke_fn<Fn>, &move_fn<Fn>, &destroy_fn<Fn>};
+
+    void move_from(InlineFunction& _other) noexcept {
+        if (_other.m_ops != nullptr) {
+            _other.m_ops->move(m_storage, _other.m_storage);
+            m_ops = _other.m_ops;
+            _other.m_ops = nullptr;
+        }
+    }
+
+    alignas(std::max_align_t) unsigned char m_storage[Capacity];
+    const Ops* m_ops{nullptr};
+};
+
+} /*ns*/
+} /*ns*/
@@ -0,0 +1,356 @@
+#pragma once
+
+#include "JobManager.hpp"
+#include "MainThreadQueue.hpp"
+
+/* Coroutine tasks on top of the JobManager pools, needs C++20.
+ *
+ * A Task suspends instead of blocking, so waiting on a Context from inside a
+ * coroutine does not hold on to a worker the way wait_for() inside a job
+ * does. Multi-stage work reads top to bottom:
+ *
+ *     Task<void> load_scene(Scene& scene, JobSystem& io) {
+ *         co_await schedule_on(io);
+ *         Bytes bytes = read_file(scene.path);
+ *
+ *         co_await schedule_on(default_job_system());
+ *         Context decode;
+ *         dispatch(decode, bytes.chunks(), 1, decode_chunk(bytes), 0);
+ *         co_await decode;
+ *
+ *         co_await resume_on(main_queue);
+ *         upload(scene);
+ *     }
+ *
+ *     Context loading;
+ *     launch(loading, load_scene(scene, io));
+ *
+ * Awaiting a Context resumes the coroutine on the JobSystem, or the
+ * MainThreadQueue, it was last scheduled on. A launched task keeps its Context
+ * busy until it returns, so other code can keep using is_busy() on it. A
+ * thread that calls wait_for() on that Context must not be the one draining
+ * the MainThreadQueue that the task resumes on.
+ */
+
+#if defined(__cpp_impl_coroutine) && __has_include(<coroutine>)
+#define ARC_JOB_COROUTINES 1
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <type_traits>
+
+namespace arc {
+namespace core {
+namespace JobManager {
+
+// State shared by every Task promise
+struct TaskPromiseBase {
+    Context* root = nullptr;        // busy until the launched task returns
+    JobSystem* system = nullptr;    // where the coroutine is resumed
+    MainThreadQueue* main_queue = nullptr; // set instead of system by resume_on()
+    std::coroutine_handle<> continuation; // task awaiting this one
+    TaskPromiseBase* parent = nullptr;
+    std::exception_ptr exception;
+    bool detached = false; // launched, destroys itself when done
+
+    // Hands the location back to the awaiting task, or ends a launched one
+    struct FinalAwaiter {
+        bool await_ready() noexcept { return false; }
+
+        template <typename P>
+        std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<P> handle) noexcept {
+            TaskPromiseBase& promise = handle.promise();
+            if (promise.continuation) {
+                promise.parent->system = promise.system;
+                promise.parent->main_queue = promise.main_queue;
+                return promise.continuation;
+            }
+            if (promise.detached) {
+                Context* root = promise.root;
+                if (promise.exception) {
+                    std::terminate(); // nobody is left to rethrow it
+                }
+                handle.destroy();
+                complete(*root);
+            }
+            return std::noop_coroutine();
+        }
+
+        void await_resume() noexcept {}
+    };
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { exception = std::current_exception(); }
+};
+
+// Queue a job on ctx that resumes handle
+//	The job is not cancellable, a coroutine that is never resumed would
+// keep its launched Context busy and leak its frame. Tasks see a cancelled
+// Context through co_await cancelled() instead
+inline void resume_in_job(JobSystem& system, Context& ctx,
+                          std::coroutine_handle<> handle) {
+    Job* job = make_job(ctx, [handle](JobArgs) { handle.resume(); });
+    job->cancellable = false;
+    system.submit(job);
+    system.wake_workers(1, ctx.priority);
+}
+
+// Resume handle later on the thread of its promise
+//	Job resumes are counted in the root Context, so it cannot drain between
+// the suspension and the resume
+inline void resume_later(TaskPromiseBase& promise,
+                         std::coroutine_handle<> handle) {
+    if (promise.main_queue != nullptr) {
+        promise.main_queue->post(
+            [](void* address) {
+                std::coroutine_handle<>::from_address(address).resume();
+            },
+            handle.address());
+    } else {
+        resume_in_job(*promise.system, *promise.root, handle);
+    }
+}
+
+template <typename T>
+struct TaskPromise;
+
+/* @brief A lazily started coroutine, see the top of JobCoroutine.hpp.
+ *
+ * A Task runs when it is co_awaited by another Task, which continues with its
+ * result, or when it is handed to launch(). Exceptions are rethrown into the
+ * awaiting task, a launched task must not throw.
+ */
+template <typename T = void>
+class [[nodiscard]] Task {
+  public:
+    using promise_type = TaskPromise<T>;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+    explicit Task(handle_type handle) : m_handle(handle) {}
+    Task(Task&& other) noexcept : m_handle(other.m_handle) {
+        other.m_handle = nullptr;
+    }
+    Task& operator=(Task&& other) noexcept {
+        if (this != &other) {
+            if (m_handle) {
+                m_handle.destroy();
+            }
+            m_handle = other.m_handle;
+            other.m_handle = nullptr;
+        }
+        return *this;
+    }
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+    ~Task() {
+        if (m_handle) {
+            m_handle.destroy();
+        }
+    }
+
+    // Starts the task on the thread of the awaiting task, which continues
+    // where this one returns
+    struct Awaiter {
+        handle_type handle;
+
+        bool await_ready() noexcept { return false; }
+
+        template <typename P>
+        std::coroutine_handle<> await_suspend(
+            std::coroutine_handle<P> awaiting) noexcept {
+            TaskPromiseBase& parent = awaiting.promise();
+            TaskPromiseBase& child = handle.promise();
+            child.root = parent.root;
+            child.system = parent.system;
+            child.main_queue = parent.main_queue;
+            child.continuation = awaiting;
+            child.parent = &parent;
+            return handle;
+        }
+
+        T await_resume() { return handle.promise().result(); }
+    };
+
+    Awaiter operator co_await() && noexcept { return Awaiter{m_handle}; }
+
+    // Give up ownership of the coroutine frame
+    handle_type release() {
+        handle_type handle = m_handle;
+        m_handle = nullptr;
+        return handle;
+    }
+
+  private:
+    handle_type m_handle;
+};
+
+template <typename T>
+struct TaskPromise : TaskPromiseBase {
+    std::optional<T> value;
+
+    Task<T> get_return_object() {
+        return Task<T>(std::coroutine_handle<TaskPromise>::from_promise(*this));
+    }
+
+    template <typename U>
+    void return_value(U&& result) {
+        value.emplace(std::forward<U>(result));
+    }
+
+    T result() {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+        return std::move(*value);
+    }
+};
+
+template <>
+struct TaskPromise<void> : TaskPromiseBase {
+    Task<void> get_return_object() {
+        return Task<void>(
+            std::coroutine_handle<TaskPromise>::from_promise(*this));
+    }
+
+    void return_void() {}
+
+    void result() {
+        if (exception) {
+            std::rethrow_exception(exception);
+        }
+    }
+};
+
+/* @brief Start a task on the workers of system, ctx stays busy until it
+ * returns
+ */
+inline void launch(JobSystem& system, Context& ctx, Task<void> task) {
+    Task<void>::handle_type handle = task.release();
+    TaskPromiseBase& promise = handle.promise();
+    promise.root = &ctx;
+    promise.system = &system;
+    promise.detached = true;
+    ctx.counter.fetch_add(1); // dropped by the FinalAwaiter
+    resume_in_job(system, ctx, handle);
+}
+
+// Start a task on default_job_system()
+inline void launch(Context& ctx, Task<void> task) {
+    launch(default_job_system(), ctx, std::move(task));
+}
+
+// Suspends a task until a Context drains, see operator co_await(Context&)
+struct ContextAwaiter : ContextWaiter {
+    Context& ctx;
+    TaskPromiseBase* promise = nullptr;
+    std::coroutine_handle<> handle;
+
+    explicit ContextAwaiter(Context& _ctx) : ctx(_ctx) {}
+
+    bool await_ready() const { return !is_busy(ctx); }
+
+    template <typename P>
+    bool await_suspend(std::coroutine_handle<P> awaiting) {
+        static_assert(std::is_base_of_v<TaskPromiseBase, P>,
+                      "only a Task can co_await a Context");
+        promise = &awaiting.promise();
+        handle = awaiting;
+        notify = [](ContextWaiter* waiter) {
+            auto* self = static_cast<ContextAwaiter*>(waiter);
+            resume_later(*self->promise, self->handle);
+        };
+        // The task may be resumed on another thread before this returns, so
+        // nothing is touched after the waiter is registered
+        return add_waiter(ctx, this);
+    }
+
+    void await_resume() const {}
+};
+
+// Suspend until ctx drains without holding on to the thread, the suspending
+// counterpart of wait_for()
+inline ContextAwaiter operator co_await(Context& ctx) {
+    return ContextAwaiter(ctx);
+}
+
+// Tells a task whether its launched Context was cancelled, see cancelled()
+struct CancelledAwaiter {
+    const Context* root = nullptr;
+
+    bool await_ready() const { return false; }
+
+    // Never suspends, only looks up the root Context of the task
+    template <typename P>
+    bool await_suspend(std::coroutine_handle<P> awaiting) {
+        static_assert(std::is_base_of_v<TaskPromiseBase, P>,
+                      "only a Task can co_await cancelled()");
+        root = awaiting.promise().root;
+        return false;
+    }
+
+    bool await_resume() const { return root != nullptr && is_cancelled(*root); }
+};
+
+// The CancelToken of the Context the task was launched on was cancelled
+//	Tasks are resumed even then, so they can release what they hold and
+// return early:
+//
+//     const bool stop = co_await cancelled();
+//     if (stop)
+//         co_return;
+//
+// GCC 12 miscompiles a co_await inside an if condition, keep it a statement
+// of its own
+inline CancelledAwaiter cancelled() { return CancelledAwaiter{}; }
+
+// Moves a task to another JobSystem, see schedule_on()
+struct ScheduleAwaiter {
+    JobSystem& system;
+
+    bool await_ready() const { return false; }
+
+    template <typename P>
+    void await_suspend(std::coroutine_handle<P> awaiting) {
+        TaskPromiseBase& promise = awaiting.promise();
+        promise.system = &system;
+        promise.main_queue = nullptr;
+        resume_later(promise, awaiting);
+    }
+
+    void await_resume() const {}
+};
+
+// Continue the task on a worker of system
+inline ScheduleAwaiter schedule_on(JobSystem& system) {
+    return ScheduleAwaiter{system};
+}
+
+// Moves a task to the main thread, see resume_on()
+struct MainThreadAwaiter {
+    MainThreadQueue& queue;
+
+    bool await_ready() const { return false; }
+
+    template <typename P>
+    void await_suspend(std::coroutine_handle<P> awaiting) {
+        TaskPromiseBase& promise = awaiting.promise();
+        promise.main_queue = &queue;
+        resume_later(promise, awaiting);
+    }
+
+    void await_resume() const {}
+};
+
+// Continue the task on the next MainThreadQueue::drain() of queue
+inline MainThreadAwaiter resume_on(MainThreadQueue& queue) {
+    return MainThreadAwaiter{queue};
+}
+
+} /*ns*/
+} /*ns*/
+} /*ns*/
+
+#endif // __cpp_impl_coroutine
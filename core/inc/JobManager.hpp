@@ -8,19 +8,41 @@
 
 #include <algorithm>
 #include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cmath>
 #include <condition_variable>
 #include <deque>
 #include <functional>
+#include <initializer_list>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <system_error>
+#include <typeinfo>
 #include <vector>
 #include <thread>
 
+#include "CpuTopology.hpp"
+#include "Defs.hpp"
+#include "Fiber.hpp"
+#include "Futex.hpp"
+#include "InlineFunction.hpp"
+#include "JobProfiler.hpp"
+#include "ScratchArena.hpp"
+#include "TimerWheel.hpp"
+#include "WorkStealingQueue.hpp"
+
 #ifdef PLATFORM_LINUX
+#include <climits>
 #include <pthread.h>
 #endif // PLATFORM_LINUX
 
+// Bytes of inline storage for a job kernel and its captures
+#ifndef ARC_JOB_FUNCTION_SIZE
+#define ARC_JOB_FUNCTION_SIZE 64
+#endif
+
 namespace arc {
 namespace core {
 namespace JobManager {
@@ -29,9 +51,7 @@ const std::string impl_name = "arc::core";
 const std::string threadname_prefix = impl_name + "::JobManager::";
 const std::string job_prefix = impl_name + "::Job::";
 
-std::atomic<bool> _is_initialized_{false};
-
-bool ready() { return _is_initialized_; }
+struct CancelToken;
 
 struct JobArgs {
     uint32_t job_index; // job index relative to dispatch (like
@@ -44,14 +64,111 @@ struct JobArgs {
         is_first_job_in_group; // is the current job the first one in the group?
     bool is_last_job_in_group; // is the current job the last one in the group?
     void* sharedmemory; // stack memory shared within the current group (jobs
-                        // within a group execute serially)
+                        // within a group execute serially), aligned to
+                        // sharedmemory_alignment
+    uint32_t sharedmemory_size; // usable bytes behind sharedmemory
+    const CancelToken* cancel_token; // of the Context, may be null
+
+    // The Context of the job was cancelled, long kernels should poll this and
+    // return early, see CancelToken
+    inline bool is_cancelled() const;
+};
+
+// Alignment guaranteed for JobArgs::sharedmemory, enough for any SIMD type
+constexpr size_t sharedmemory_alignment = ScratchArena::alignment;
+
+// How JobArgs::sharedmemory is prepared at the start of every group
+enum SharedMemoryInit : uint8_t {
+    SHAREDMEMORY_UNINITIALIZED = 0, // contents left over from earlier groups
+    SHAREDMEMORY_ZEROED,            // cleared, like HLSL groupshared memory
+};
+
+// Scheduling class of a Context, every job submitted to it inherits it
+//	Workers always take the most urgent job they can find, and wait_for()
+// only helps with jobs that are at least as urgent as the Context it waits on
+enum Priority : uint8_t {
+    PRIORITY_CRITICAL = 0, // per-frame work that the frame is waiting on
+    PRIORITY_NORMAL,
+    PRIORITY_BACKGROUND, // streaming, asset decompression, may run for long
+    PRIORITY_COUNT,
+};
+
+// Bit set of the priorities a thread takes jobs from, see find_job()
+constexpr uint32_t lanes_up_to(Priority priority) {
+    return (2u << priority) - 1;
+}
+constexpr uint32_t all_lanes = lanes_up_to(PRIORITY_BACKGROUND);
+
+// Something that wants to be notified once a Context drains, see add_waiter()
+//	Waiters are linked intrusively, so an object can only wait on one Context
+// at a time
+struct ContextWaiter {
+    void (*notify)(ContextWaiter*) = nullptr;
+    ContextWaiter* next_waiter = nullptr;
+};
+
+/* @brief Cancels the jobs of every Context it is attached to.
+ *
+ * Jobs that were queued but did not start yet are dropped without running
+ * their task, and the remaining jobs of a group that is running are skipped,
+ * so the Contexts drain as usual and waiting on them stays correct. Kernels
+ * that are already running can poll JobArgs::is_cancelled() to return early:
+ *
+ *     CancelToken loading_token;
+ *     Context loading;
+ *     loading.cancel_token = &loading_token;
+ *     dispatch(loading, chunks.size(), 1, [&](JobArgs args) {
+ *         for (Block& block : chunks[args.job_index].blocks) {
+ *             if (args.is_cancelled())
+ *                 return;
+ *             decode(block);
+ *         }
+ *     }, 0);
+ *     ...
+ *     loading_token.cancel(); // the scene is torn down
+ *     wait_for(loading);      // returns once the running kernels gave up
+ *
+ * Checking is a relaxed load of a flag that is written once, so polling it
+ * from hot loops is cheap. A token must outlive the jobs of its Contexts.
+ */
+struct CancelToken {
+    std::atomic<bool> cancelled{false};
+
+    inline void cancel() { cancelled.store(true, std::memory_order_relaxed); }
+    // Lets the token be attached to new jobs again, once the cancelled
+    // Contexts drained
+    inline void reset() { cancelled.store(false, std::memory_order_relaxed); }
+    inline bool is_cancelled() const {
+        return cancelled.load(std::memory_order_relaxed);
+    }
 };
 
+inline bool JobArgs::is_cancelled() const {
+    return cancel_token != nullptr && cancel_token->is_cancelled();
+}
+
 // Defines a state of execution, can be waited on
+//	The top bit of counter is set while waiters are registered, so a Context
+// with waiters stays busy until they have been notified
 struct Context {
+    static constexpr uint32_t has_waiters = 1u << 31;
+
     std::atomic<uint32_t> counter{0};
+    ContextWaiter* waiters = nullptr;
+    Priority priority = PRIORITY_NORMAL;
+    const char* name = nullptr; // label of its jobs in profiler traces
+    CancelToken* cancel_token = nullptr; // drops its jobs once cancelled
+
+    Context() = default;
+    explicit Context(Priority _priority, const char* _name = nullptr)
+        : priority(_priority), name(_name) {}
 };
 
+// The jobs of ctx are being cancelled, see CancelToken
+inline bool is_cancelled(const Context& ctx) {
+    return ctx.cancel_token != nullptr && ctx.cancel_token->is_cancelled();
+}
+
 struct Timer {
     std::chrono::high_resolution_clock::time_point timestamp =
         std::chrono::high_resolution_clock::now();
@@ -103,7 +220,7 @@ class SpinLock {
         int spin = 0;
         while (!try_lock()) {
             if (spin < 10) {
-                //_mm_pause(); // SMT thread swap can occur here
+                cpu_relax(); // SMT thread swap can occur here
             } else {
                 std::this_thread::yield(); // OS thread swap can occur here. It
                                            // is important to keep it as
@@ -120,289 +237,2643 @@ class SpinLock {
     inline void unlock() { lck.clear(std::memory_order_release); }
 };
 
-struct Job {
-    std::function<void(JobArgs)> task;
+// Maximum Contexts a single job can depend on, see execute()
+#ifndef ARC_JOB_MAX_DEPENDENCIES
+#define ARC_JOB_MAX_DEPENDENCIES 4
+#endif
+
+// Waiter lists are guarded by a striped lock outside of the Context, so the
+// last touch of a Context is the atomic that makes it idle
+inline SpinLock& context_lock(const Context& ctx) {
+    static SpinLock locks[64];
+    uintptr_t key = reinterpret_cast<uintptr_t>(&ctx);
+    return locks[((key >> 4) * 0x9E3779B1u) >> 26 & 63];
+}
+
+// Register a waiter to be notified when ctx drains
+//	Returns false if ctx is already idle, in which case waiter is not added
+//	Dependencies are resolved by draining, so a Context should not be refilled
+// while others are waiting on it
+inline bool add_waiter(Context& ctx, ContextWaiter* waiter) {
+    SpinLock& lock = context_lock(ctx);
+    lock.lock();
+    // The flag must be set in the same step as the busy check, otherwise the
+    // last job could finish in between without seeing it
+    uint32_t counter = ctx.counter.load();
+    do {
+        if ((counter & ~Context::has_waiters) == 0) {
+            lock.unlock();
+            return false;
+        }
+    } while (!ctx.counter.compare_exchange_weak(
+        counter, counter | Context::has_waiters));
+    waiter->next_waiter = ctx.waiters;
+    ctx.waiters = waiter;
+    lock.unlock();
+    return true;
+}
+
+// Mark count jobs of ctx as finished, notifying waiters if it drained
+inline void complete(Context& ctx, uint32_t count = 1) {
+    const uint32_t previous = ctx.counter.fetch_sub(count);
+    if (previous != (Context::has_waiters | count)) {
+        return;
+    }
+    SpinLock& lock = context_lock(ctx);
+    lock.lock();
+    ContextWaiter* waiter = ctx.waiters;
+    ctx.waiters = nullptr;
+    ctx.counter.fetch_and(~Context::has_waiters); // ctx may be gone after this
+    lock.unlock();
+
+    while (waiter != nullptr) {
+        ContextWaiter* next = waiter->next_waiter;
+        waiter->notify(waiter);
+        waiter = next;
+    }
+}
+
+// Pass as groupSize to let dispatch() pick the group size, see GrainStats
+constexpr uint32_t auto_group_size = 0;
+
+// Automatic group sizes aim for this many groups per thread, so threads that
+// finish early have something left to take
+constexpr uint32_t auto_groups_per_thread = 4;
+// Automatic groups are made at least this long, shorter groups spend a
+// noticeable part of their time in the queues
+constexpr double auto_min_group_ns = 10000.0;
+// Weight of the newest group in GrainStats::ns_per_job
+constexpr double auto_cost_weight = 0.125;
+
+/* @brief Measured cost of the kernel of one dispatch call site.
+ *
+ * Dispatches with auto_group_size time every group they run and keep a moving
+ * average of the cost per job, keyed by the kernel type, so each lambda gets
+ * its own entry while type erased std::function dispatches share one. Every
+ * entry stays registered for the lifetime of the program, see
+ * for_each_grain_stats().
+ */
+struct GrainStats {
+    const char* name;                    // mangled kernel type
+    std::atomic<double> ns_per_job{0.0}; // 0 until the first group finished
+    std::atomic<uint32_t> group_size{0}; // picked by the latest dispatch
+    std::atomic<uint32_t> dispatches{0};
+    GrainStats* next = nullptr;
+
+    explicit GrainStats(const char* _name) : name(_name) {
+        std::atomic<GrainStats*>& head = list();
+        next = head.load();
+        while (!head.compare_exchange_weak(next, this)) {
+        }
+    }
+
+    static std::atomic<GrainStats*>& list() {
+        static std::atomic<GrainStats*> head{nullptr};
+        return head;
+    }
+};
+
+template <typename F>
+GrainStats& grain_stats() {
+    static GrainStats stats(typeid(F).name());
+    return stats;
+}
+
+// Stats of the call site that dispatches task
+template <typename F>
+const GrainStats& grain_stats_of(const F&) {
+    return grain_stats<F>();
+}
+
+// Call fn(const GrainStats&) for every call site that used auto_group_size
+template <typename F>
+void for_each_grain_stats(F&& fn) {
+    for (GrainStats* stats = GrainStats::list().load(); stats != nullptr;
+         stats = stats->next) {
+        fn(static_cast<const GrainStats&>(*stats));
+    }
+}
+
+struct JobPool;
+class JobSystem;
+
+// One group of a dispatch, or a single executed job
+//	task runs every job of the group, jobs are recycled through a JobPool so
+// submitting does not touch the heap once the pool is warm
+struct Job : ContextWaiter {
+    InlineFunction<void(const Job&), ARC_JOB_FUNCTION_SIZE> task;
     Context* context;
     uint32_t group_ID;
     uint32_t group_job_offset;
     uint32_t group_job_end;
     uint32_t sharedmemory_size;
+    SharedMemoryInit sharedmemory_init;
+    GrainStats* grain = nullptr; // set when the group size was picked for us
+    JobSystem* system = nullptr; // queued on once dependencies drained
+    // Runs even once its Context was cancelled, for jobs that own something
+    // that has to be released, such as the resume of a coroutine
+    bool cancellable = true;
+
+    // Contexts that must drain before this job is queued
+    Context* dependencies[ARC_JOB_MAX_DEPENDENCIES];
+    uint32_t dependency_count = 0;
+
+    Job* next = nullptr;
+    JobPool* pool = nullptr;
 };
 
-struct JobQueue {
-    std::deque<Job> queue;
+// Free list of Job objects owned by one thread
+//	The owner allocates and frees through the local list, other threads
+// return jobs through a lock-free stack that the owner takes in a single swap
+struct JobPool {
+    static constexpr uint32_t block_size = 256;
+
+    Job* local = nullptr;
+    std::atomic<Job*> remote{nullptr};
+    std::vector<std::unique_ptr<Job[]>> blocks;
+    bool in_use = false;
+
+    inline Job* allocate() {
+        if (local == nullptr) {
+            local = remote.exchange(nullptr, std::memory_order_acquire);
+        }
+        if (local == nullptr) {
+            blocks.emplace_back(new Job[block_size]);
+            Job* block = blocks.back().get();
+            for (uint32_t i = 0; i < block_size; ++i) {
+                block[i].pool = this;
+                block[i].next = (i + 1 < block_size) ? &block[i + 1] : nullptr;
+            }
+            local = block;
+        }
+        Job* job = local;
+        local = job->next;
+        return job;
+    }
+
+    inline void free_local(Job* job) {
+        job->next = local;
+        local = job;
+    }
+
+    inline void free_remote(Job* job) {
+        Job* head = remote.load(std::memory_order_relaxed);
+        do {
+            job->next = head;
+        } while (!remote.compare_exchange_weak(head, job,
+                                               std::memory_order_release,
+                                               std::memory_order_relaxed));
+    }
+};
+
+// Owns every JobPool ever handed out, pools of exited threads are reused
+//	Pools are shared by every JobSystem, a job may be allocated by a worker of
+// one system and released by a worker of another
+struct JobPoolRegistry {
     std::mutex locker;
+    std::vector<std::unique_ptr<JobPool>> pools;
 
-    inline void push_back(const Job& item) {
+    inline JobPool* acquire() {
         std::scoped_lock lock(locker);
-        queue.push_back(item);
+        for (auto& pool : pools) {
+            if (!pool->in_use) {
+                pool->in_use = true;
+                return pool.get();
+            }
+        }
+        pools.emplace_back(new JobPool);
+        pools.back()->in_use = true;
+        return pools.back().get();
     }
 
-    inline bool pop_front(Job& item) {
+    inline void release(JobPool* pool) {
         std::scoped_lock lock(locker);
+        pool->in_use = false;
+    }
+};
+
+// What the worker loop of a thread is doing, see stats_enter()
+enum WorkerPeriod : uint8_t {
+    PERIOD_NONE = 0, // not a worker, or the loop was left
+    PERIOD_BUSY,     // running jobs, wait_for() in them included
+    PERIOD_IDLE,     // looking for jobs, spinning
+    PERIOD_PARKED,   // asleep until jobs are queued
+};
+
+/* @brief Counters of one thread of a JobSystem, see JobSystem::stats()
+ *
+ * Only the thread they belong to writes them, with relaxed loads and stores
+ * rather than read-modify-writes, and each thread has cache lines of its own.
+ * The worker loop reads the clock when it goes from one WorkerPeriod to
+ * another, not for every job it runs. The period it is in is published with
+ * its start, and snapshots add it, so a long job or a long sleep shows up
+ * while it lasts.
+ */
+struct alignas(64) WorkerStats {
+    std::atomic<uint64_t> jobs_executed{0}; // cancelled jobs are not counted
+    std::atomic<uint64_t> jobs_stolen{0};   // taken from the queue of another thread
+    std::atomic<uint64_t> busy_ns{0};       // time of each WorkerPeriod that ended
+    std::atomic<uint64_t> idle_ns{0};
+    std::atomic<uint64_t> parked_ns{0};
+    std::atomic<uint64_t> lock_wait_ns{0};  // blocked on a contended JobQueue
+    // Time inside wait_for(), running jobs meanwhile, spinning on the
+    // Context, and asleep until it drained
+    std::atomic<uint64_t> wait_help_ns{0};
+    std::atomic<uint64_t> wait_spin_ns{0};
+    std::atomic<uint64_t> wait_sleep_ns{0};
+    std::atomic<uint32_t> queue_high_water{0}; // most jobs in one own lane
+    std::atomic<uint64_t> period_start{0};
+    std::atomic<uint8_t> period{PERIOD_NONE};
+
+    // Counter of the time spent in period, null for PERIOD_NONE
+    std::atomic<uint64_t>* period_counter(uint8_t _period) {
+        switch (_period) {
+        case PERIOD_BUSY:
+            return &busy_ns;
+        case PERIOD_IDLE:
+            return &idle_ns;
+        case PERIOD_PARKED:
+            return &parked_ns;
+        default:
+            return nullptr;
+        }
+    }
+};
+
+// WorkerStats of the current thread, null outside of a JobSystem
+//	A worker of one system that helps another one counts in its own system
+inline thread_local WorkerStats* tls_worker_stats = nullptr;
+
+inline uint64_t stats_now() {
+    return (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(
+               std::chrono::steady_clock::now().time_since_epoch())
+        .count();
+}
+
+// Counters have a single writer, a plain store is enough
+inline void stats_add(std::atomic<uint64_t>& counter, uint64_t value) {
+    counter.store(counter.load(std::memory_order_relaxed) + value,
+                  std::memory_order_relaxed);
+}
+
+inline void stats_count(std::atomic<uint64_t> WorkerStats::*counter) {
+    if (WorkerStats* stats = tls_worker_stats) {
+        stats_add(stats->*counter, 1);
+    }
+}
+
+// Add the time since mark to a counter of the current thread, and move mark
+// to now
+inline void stats_lap(uint64_t& mark,
+                      std::atomic<uint64_t> WorkerStats::*counter) {
+    if (WorkerStats* stats = tls_worker_stats) {
+        const uint64_t now = stats_now();
+        stats_add(stats->*counter, now - mark);
+        mark = now;
+    }
+}
+
+// The worker loop of the current thread goes to another WorkerPeriod
+//	Free when it stays in the same one. The new start is stored before the
+// counter of the period that ended, so a snapshot that sees the counter sees
+// the start too and never counts that period twice
+inline void stats_enter(WorkerPeriod next) {
+    WorkerStats* stats = tls_worker_stats;
+    if (stats == nullptr) {
+        return;
+    }
+    const uint8_t current = stats->period.load(std::memory_order_relaxed);
+    if (current == next) {
+        return;
+    }
+    const uint64_t now = stats_now();
+    const uint64_t start = stats->period_start.load(std::memory_order_relaxed);
+    stats->period_start.store(now, std::memory_order_relaxed);
+    if (std::atomic<uint64_t>* counter = stats->period_counter(current)) {
+        counter->store(counter->load(std::memory_order_relaxed) + now - start,
+                       std::memory_order_release);
+    }
+    stats->period.store(next, std::memory_order_relaxed);
+}
+
+inline void stats_high_water(WorkerStats& stats, size_t depth) {
+    if (depth > stats.queue_high_water.load(std::memory_order_relaxed)) {
+        stats.queue_high_water.store((uint32_t)depth,
+                                     std::memory_order_relaxed);
+    }
+}
+
+// Locked queue for jobs submitted from threads that do not own a
+// WorkStealingQueue in the pool
+struct JobQueue {
+    std::deque<Job*> queue;
+    std::mutex locker;
+    std::atomic<uint32_t> count{0}; // lets idle threads skip the lock
+    std::atomic<uint32_t> high_water{0}; // most jobs queued at once
+
+    inline void push_back(Job* item) {
+        auto lock = acquire();
+        queue.push_back(item);
+        count.fetch_add(1, std::memory_order_relaxed);
+        record_high_water();
+    }
+
+    // Queue n jobs under a single lock
+    inline void push_back(Job* const* items, size_t n) {
+        auto lock = acquire();
+        queue.insert(queue.end(), items, items + n);
+        count.fetch_add((uint32_t)n, std::memory_order_relaxed);
+        record_high_water();
+    }
+
+    inline bool pop_front(Job*& item) {
+        if (empty()) {
+            return false;
+        }
+        auto lock = acquire();
         if (queue.empty()) {
             return false;
         }
-        item = std::move(queue.front());
+        item = queue.front();
         queue.pop_front();
+        count.fetch_sub(1, std::memory_order_relaxed);
         return true;
     }
-};
 
-// This structure is responsible to stop worker thread loops.
-//	Once this is destroyed, worker threads will be woken up and end their loops.
-struct InternalState {
-    uint32_t n_cores = 0;
-    uint32_t n_threads = 0;
-    std::unique_ptr<JobQueue[]> job_queue_per_thread;
-    std::atomic_bool alive{true};
-    std::condition_variable wake_condition;
-    std::mutex wake_mutex;
-    std::atomic<uint32_t> next_queue{0};
-    std::vector<std::thread> threads;
-    void shutdown() {
-        alive.store(
-            false); // indicate that new jobs cannot be started from this point
-        bool wake_loop = true;
-        std::thread waker([&] {
-            while (wake_loop) {
-                wake_condition.notify_all(); // wakes up sleeping worker threads
-            }
-        });
-        for (auto& thread : threads) {
-            thread.join();
-        }
-        wake_loop = false;
-        waker.join();
-        job_queue_per_thread.reset();
-        threads.clear();
-        n_cores = 0;
-        n_threads = 0;
-    }
-    ~InternalState() { shutdown(); }
-} static internal_state;
-
-// Start working on a job queue
-//	After the job queue is finished, it can switch to an other queue and steal
-// jobs from there
-inline void work(uint32_t startingQueue) {
-    Job job;
-    for (uint32_t i = 0; i < internal_state.n_threads; ++i) {
-        JobQueue& job_queue =
-            internal_state
-                .job_queue_per_thread[startingQueue % internal_state.n_threads];
-        while (job_queue.pop_front(job)) {
-            JobArgs args;
-            args.group_ID = job.group_ID;
-            if (job.sharedmemory_size > 0) {
-                thread_local static std::vector<uint8_t> shared_allocation_data;
-                shared_allocation_data.reserve(job.sharedmemory_size);
-                args.sharedmemory = shared_allocation_data.data();
-            } else {
-                args.sharedmemory = nullptr;
-            }
+    inline bool pop_back(Job*& item) {
+        if (empty()) {
+            return false;
+        }
+        auto lock = acquire();
+        if (queue.empty()) {
+            return false;
+        }
+        item = queue.back();
+        queue.pop_back();
+        count.fetch_sub(1, std::memory_order_relaxed);
+        return true;
+    }
 
-            for (uint32_t j = job.group_job_offset; j < job.group_job_end;
-                 ++j) {
-                args.job_index = j;
-                args.group_index = j - job.group_job_offset;
-                args.is_first_job_in_group = (j == job.group_job_offset);
-                args.is_last_job_in_group = (j == job.group_job_end - 1);
-                job.task(args);
-            }
+    inline bool empty() const {
+        return count.load(std::memory_order_relaxed) == 0;
+    }
+
+    // Lock, the clock is only read when another thread holds the lock
+    inline std::unique_lock<std::mutex> acquire() {
+        std::unique_lock lock(locker, std::try_to_lock);
+        if (!lock.owns_lock()) {
+            uint64_t mark = tls_worker_stats != nullptr ? stats_now() : 0;
+            lock.lock();
+            stats_lap(mark, &WorkerStats::lock_wait_ns);
+        }
+        return lock;
+    }
 
-            job.context->counter.fetch_sub(1);
+  private:
+    inline void record_high_water() {
+        if (queue.size() > high_water.load(std::memory_order_relaxed)) {
+            high_water.store((uint32_t)queue.size(), std::memory_order_relaxed);
         }
-        startingQueue++; // go to next queue
     }
+};
+
+// Idle threads retry this many times before parking, about a microsecond
+constexpr uint32_t idle_spin_count = 64;
+
+// JobPool of the current thread, see local_job_pool()
+inline thread_local JobPool* tls_job_pool = nullptr;
+
+
+// JobSystem the current thread works for, see JobSystem::current()
+inline thread_local JobSystem* tls_job_system = nullptr;
+
+// Index of the WorkerQueues owned by the current thread in tls_job_system,
+// workers own [0, n_threads) and the thread that called initialize() owns
+// n_threads
+inline thread_local uint32_t tls_queue_index = ~0u;
+
+// Cheap per-thread xorshift used to pick steal victims
+inline uint32_t random_victim(uint32_t range) {
+    thread_local uint32_t seed =
+        (uint32_t)std::hash<std::thread::id>{}(std::this_thread::get_id()) |
+        1u;
+    seed ^= seed << 13;
+    seed ^= seed >> 17;
+    seed ^= seed << 5;
+    return seed % range;
 }
 
-void initialize(uint32_t maxThreadCount = 4) {
-    if (internal_state.n_threads > 0)
-        return;
-    maxThreadCount = std::max(1u, maxThreadCount);
+// Registry behind every JobPool of the process
+//	It is never destroyed, workers of a JobSystem with static storage still
+// return their pools to it while the program exits
+inline JobPoolRegistry& job_pool_registry() {
+    static JobPoolRegistry* registry = new JobPoolRegistry;
+    return *registry;
+}
+
+// Hands the JobPool back to the registry when its thread exits
+struct JobPoolHandle {
+    JobPoolHandle() { tls_job_pool = job_pool_registry().acquire(); }
+    ~JobPoolHandle() {
+        job_pool_registry().release(tls_job_pool);
+        tls_job_pool = nullptr;
+    }
+};
+
+inline JobPool& local_job_pool() {
+    if (tls_job_pool == nullptr) {
+        thread_local JobPoolHandle handle;
+        (void)handle;
+    }
+    return *tls_job_pool;
+}
+
+inline Job* allocate_job() { return local_job_pool().allocate(); }
+
+// Destroys the task and returns the job to the pool it was allocated from
+inline void release_job(Job* job) {
+    job->task.reset();
+    job->cancellable = true;
+    if (job->pool == tls_job_pool) {
+        job->pool->free_local(job);
+    } else {
+        job->pool->free_remote(job);
+    }
+}
+
+// One WorkStealingQueue per priority, owned by a single thread
+struct WorkerQueues {
+    WorkStealingQueue<Job*> lanes[PRIORITY_COUNT];
+    // Groups of dispatch_affine() placed on this worker by any thread. The
+    // owner takes them in order, others only once nothing else is left
+    JobQueue affine[PRIORITY_COUNT];
+    // Jobs of execute_on(), only ever run by the owner
+    JobQueue pinned[PRIORITY_COUNT];
+    // Futex word the owner sleeps on in wait_for(), bumped by execute_on()
+    // while it sleeps and by the Context it waits on
+    std::atomic<uint32_t> inbox_epoch{0};
+    std::atomic<uint32_t> inbox_sleeping{0};
+    uint32_t l3 = 0; // L3 domain of the owner, see ThreadPlacement
+    WorkerStats stats; // of the owner
+};
+
+// Where worker threads run, see CpuTopology::placement_order()
+struct ThreadPlacement {
+    PlacementPolicy policy = PLACEMENT_NONE;
+    // Pin the thread calling initialize() to the first core of the order and
+    // keep every worker off that core, SMT siblings included
+    bool reserve_main_core = false;
+    // Only place workers on these CPUs, such as the fast cores of a hybrid
+    // CPU. Empty allows every CPU, a non empty list with PLACEMENT_NONE is
+    // placed as PLACEMENT_COMPACT
+    std::vector<uint32_t> cpus;
+};
+
+// L3 domain of threads that are not pinned
+constexpr uint32_t unknown_l3 = ~0u;
+
+// Idle workers of one kind park here, general and background workers are
+// kept apart so a wake never lands on a worker that cannot take the job
+struct ParkingLot {
+    std::atomic<uint32_t> wake_epoch{0}; // futex word parked workers wait on
+    std::atomic<uint32_t> sleeping{0};   // workers parked, or about to park
+};
+
+/* @brief Load driven sizing of the general workers of a JobSystem.
+ *
+ * Every interval the queued jobs and the parked workers are sampled. A worker
+ * is added when more than grow_queue_depth jobs per worker have been queued
+ * for grow_samples samples in a row, and one is retired when at least
+ * shrink_idle_ratio of the workers have been parked for shrink_samples samples
+ * in a row. Growing reacts within a few samples while shrinking waits much
+ * longer, so a pool does not flap between sizes on bursty loads.
+ */
+struct AutoScale {
+    bool enabled = false;
+    uint32_t min_thread_count = 1;
+    std::chrono::milliseconds interval{10};
+    uint32_t grow_queue_depth = 4;
+    uint32_t grow_samples = 2;
+    double shrink_idle_ratio = 0.5;
+    uint32_t shrink_samples = 50;
+};
+
+/* @brief Settings of a JobSystem, fixed from initialize() to shutdown()
+ */
+struct JobSystemConfig {
+    // Prefix of the worker thread names, the worker index is appended
+    std::string name = "arc::job::";
+    // General workers, at most one per core besides the calling thread
+    uint32_t thread_count = 4;
+    // Lift the one worker per core limit of thread_count, for pools whose
+    // jobs mostly block, such as file or network I/O
+    bool oversubscribe = false;
+    // Extra workers that only take PRIORITY_BACKGROUND jobs. When there are
+    // any, general workers leave background jobs to them, so a long background
+    // job never occupies a worker that frame jobs need
+    uint32_t background_thread_count = 0;
+    // How workers are pinned to CPUs, by default they are not. With
+    // PLACEMENT_PHYSICAL_CORES there is at most one general worker per
+    // physical core
+    ThreadPlacement placement = {};
+    // Stack of every worker in bytes, 0 keeps the platform default
+    size_t stack_size = 0;
+    // Run jobs on fibers, so a job that calls wait_for() is parked on the
+    // Context and its worker moves on to other jobs, instead of running them
+    // nested on its own stack. Only available where ARC_FIBERS is defined
+    bool fibers = false;
+    // Stack of every fiber in bytes, fibers are pooled per worker and only
+    // the pages a job touches are committed
+    size_t fiber_stack_size = 256 * 1024;
+    // Most general workers set_thread_count() and autoscale may run, limited
+    // like thread_count. 0 makes thread_count the most
+    uint32_t max_thread_count = 0;
+    // Grow and shrink the general workers with the load, see AutoScale
+    AutoScale autoscale = {};
+    // Granularity of execute_at() and execute_after(), jobs run at most one
+    // tick late and never early
+    std::chrono::microseconds timer_tick{1000};
+};
 
-    Timer timer;
+/* @brief A job waiting in execute_at(), execute_after() or
+ * execute_after_frames(), see JobSystem::cancel_timer()
+ */
+struct TimerHandle {
+    TimerWheel<Job*>::Handle handle;
+    bool frames = false; // counted in frames rather than ticks
+};
+
+#if ARC_FIBERS
+struct WorkerFibers;
+
+// A fiber that a worker runs its loop and jobs on, see WorkerFibers
+struct JobFiber : ContextWaiter {
+    Fiber fiber;
+    ScratchArena scratch; // sharedmemory of the groups running on this fiber
+    WorkerFibers* owner = nullptr;
+    JobFiber* next = nullptr;
+
+    JobFiber() = default; // the stack of the thread itself
+    JobFiber(size_t stack_size, Fiber::Entry entry, void* arg)
+        : fiber(stack_size, entry, arg) {}
+};
+
+// Fibers of one worker in fiber mode, see JobSystemConfig::fibers
+//	The worker loop runs on a fiber and jobs run on the same fiber as the loop
+// that picked them. A job waiting on a busy Context parks its fiber and the
+// loop continues on a fresh one, once the Context drains the parked fiber is
+// resumed by the same worker, so thread_local state stays valid across a wait
+//	Everything but the ready list is only touched by the worker itself
+struct WorkerFibers {
+    JobSystem* system;
+    ParkingLot* lot;
+    uint32_t lanes;
+    size_t stack_size;
+    JobFiber root;              // the stack of the thread, only left and joined
+    JobFiber* current = &root;
+    JobFiber* free_fibers = nullptr;
+    JobFiber* release_after_switch = nullptr;
+    uint32_t parked = 0; // fibers waiting on a Context, ready ones included
+    std::vector<std::unique_ptr<JobFiber>> fibers;
+
+    SpinLock ready_lock;
+    JobFiber* ready_head = nullptr; // parked fibers whose Context drained
+    JobFiber* ready_tail = nullptr;
+    std::atomic<uint32_t> ready_count{0};
+
+    WorkerFibers(JobSystem* _system, ParkingLot* _lot, uint32_t _lanes,
+                 size_t _stack_size)
+        : system(_system), lot(_lot), lanes(_lanes), stack_size(_stack_size) {
+        root.owner = this;
+    }
+
+    // A fiber that starts in entry, or continues the worker loop it was
+    // released from
+    JobFiber* acquire(Fiber::Entry entry) {
+        if (free_fibers != nullptr) {
+            JobFiber* fiber = free_fibers;
+            free_fibers = fiber->next;
+            return fiber;
+        }
+        fibers.emplace_back(new JobFiber(stack_size, entry, this));
+        fibers.back()->owner = this;
+        return fibers.back().get();
+    }
 
-    // Retrieve the number of hardware threads in this system:
-    internal_state.n_cores = std::thread::hardware_concurrency();
+    // Continue on next, the current fiber is released to the pool when it
+    // has nothing left on its stack
+    void switch_to(JobFiber* next, bool release_current) {
+        JobFiber* from = current;
+        release_after_switch = release_current ? from : nullptr;
+        current = next;
+        from->fiber.switch_to(next->fiber);
+        finish_switch();
+    }
+
+    // Called by whichever fiber a switch lands on
+    void finish_switch() {
+        if (release_after_switch != nullptr) {
+            release_after_switch->next = free_fibers;
+            free_fibers = release_after_switch;
+            release_after_switch = nullptr;
+        }
+    }
 
-    // Calculate the actual number of worker threads we want (-1 main thread):
-    internal_state.n_threads =
-        std::min(maxThreadCount, std::max(1u, internal_state.n_cores - 1));
-    internal_state.job_queue_per_thread.reset(
-        new JobQueue[internal_state.n_threads]);
-    internal_state.threads.reserve(internal_state.n_threads);
+    // Park the current fiber until ctx drains and continue the worker loop on
+    // another one
+    void park(Context& ctx, Fiber::Entry entry) {
+        JobFiber* self = current;
+        self->notify = [](ContextWaiter* waiter) {
+            auto* fiber = static_cast<JobFiber*>(waiter);
+            fiber->owner->push_ready(fiber);
+        };
+        // Once registered the fiber may be pushed as ready right away, it is
+        // only popped by this thread, after the switch
+        if (add_waiter(ctx, self)) {
+            parked++;
+#if ARC_JOB_PROFILER
+            // The spans of the job end here on the timeline of the thread and
+            // start again when the fiber continues
+            ProfileSpans spans;
+            profile_suspend(spans);
+#endif // ARC_JOB_PROFILER
+            switch_to(acquire(entry), false);
+#if ARC_JOB_PROFILER
+            profile_resume(spans);
+#endif // ARC_JOB_PROFILER
+        }
+    }
 
-    for (uint32_t threadID = 0; threadID < internal_state.n_threads;
-         ++threadID) {
-        internal_state.threads.emplace_back([threadID] {
-            while (internal_state.alive.load()) {
-                work(threadID);
+    // Queue a parked fiber to be resumed, may be called from any thread
+    void push_ready(JobFiber* fiber) {
+        fiber->next = nullptr;
+        ready_lock.lock();
+        if (ready_tail != nullptr) {
+            ready_tail->next = fiber;
+        } else {
+            ready_head = fiber;
+        }
+        ready_tail = fiber;
+        ready_count.fetch_add(1);
+        ready_lock.unlock();
+        // The owner may be parked with the other workers of its lot, which
+        // all have to be woken as there is no way to wake just the owner
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (lot->sleeping.load(std::memory_order_relaxed) > 0) {
+            lot->wake_epoch.fetch_add(1);
+            futex_wake_all(lot->wake_epoch);
+        }
+    }
 
-                // finished with jobs, put to sleep
-                std::unique_lock<std::mutex> lock(internal_state.wake_mutex);
-                internal_state.wake_condition.wait(lock);
+    JobFiber* pop_ready() {
+        if (ready_count.load(std::memory_order_relaxed) == 0) {
+            return nullptr;
+        }
+        ready_lock.lock();
+        JobFiber* fiber = ready_head;
+        if (fiber != nullptr) {
+            ready_head = fiber->next;
+            if (ready_head == nullptr) {
+                ready_tail = nullptr;
             }
-        });
-        // std::thread& worker = internal_state.threads.back();
+            ready_count.fetch_sub(1);
+        }
+        ready_lock.unlock();
+        return fiber;
+    }
 
-#ifdef _WIN32
-        // Do Windows-specific thread setup:
-        HANDLE handle = (HANDLE)worker.native_handle();
+    bool has_ready() const { return ready_count.load() > 0; }
+};
 
-        // Put each thread on to dedicated core:
-        DWORD_PTR affinityMask = 1ull << threadID;
-        DWORD_PTR affinity_result = SetThreadAffinityMask(handle, affinityMask);
-        assert(affinity_result > 0);
+// Fibers of the current worker, null outside of fiber mode
+inline thread_local WorkerFibers* tls_worker_fibers = nullptr;
+#endif // ARC_FIBERS
 
-        //// Increase thread priority:
-        // BOOL priority_result = SetThreadPriority(handle,
-        // THREAD_PRIORITY_HIGHEST); assert(priority_result != 0);
+// Thread of a JobSystem worker
+//	std::thread cannot be given a stack size, so on Linux workers are created
+// through pthreads directly
+class WorkerThread {
+  public:
+#ifdef PLATFORM_LINUX
+    using native_handle_type = pthread_t;
+#else
+    using native_handle_type = std::thread::native_handle_type;
+#endif // PLATFORM_LINUX
 
-        // Name the thread:
-        std::string wthreadname =
-            L"ArcSystems::JobManager::" + std::to_string(threadID);
-        HRESULT hr = SetThreadDescription(handle, wthreadname.c_str());
-        assert(SUCCEEDED(hr));
-#elif defined(PLATFORM_LINUX)
-#define handle_error_en(en, msg)                                               \
-    do {                                                                       \
-        errno = en;                                                            \
-        perror(msg);                                                           \
-    } while (0)
+    WorkerThread(std::function<void()> entry, size_t stack_size) {
+#ifdef PLATFORM_LINUX
+        pthread_attr_t attr;
+        pthread_attr_init(&attr);
+        if (stack_size > 0) {
+            pthread_attr_setstacksize(
+                &attr, std::max<size_t>(stack_size, PTHREAD_STACK_MIN));
+        }
+        auto* fn = new std::function<void()>(std::move(entry));
+        const int ret = pthread_create(
+            &m_handle, &attr,
+            [](void* arg) -> void* {
+                std::unique_ptr<std::function<void()>> fn(
+                    static_cast<std::function<void()>*>(arg));
+                (*fn)();
+                return nullptr;
+            },
+            fn);
+        pthread_attr_destroy(&attr);
+        if (ret != 0) {
+            delete fn;
+            throw std::system_error(ret, std::generic_category(),
+                                    "pthread_create");
+        }
+#else
+        ARC_UNUSED(stack_size);
+        m_thread = std::thread(std::move(entry));
+#endif // PLATFORM_LINUX
+    }
 
-        int ret;
-        cpu_set_t cpuset;
-        CPU_ZERO(&cpuset);
-        size_t cpusetsize = sizeof(cpuset);
+    WorkerThread(const WorkerThread&) = delete;
+    WorkerThread& operator=(const WorkerThread&) = delete;
 
-        CPU_SET(threadID, &cpuset);
-        ret =
-            pthread_setaffinity_np(worker.native_handle(), cpusetsize, &cpuset);
-        if (ret != 0)
-            handle_error_en(ret, std::string(" pthread_setaffinity_np[" +
-                                             std::to_string(threadID) + ']')
-                                     .c_str());
+    void join() {
+#ifdef PLATFORM_LINUX
+        pthread_join(m_handle, nullptr);
+#else
+        m_thread.join();
+#endif // PLATFORM_LINUX
+    }
 
-        // Name the thread
-        std::string thread_name = "wi::job::" + std::to_string(threadID);
-        ret = pthread_setname_np(worker.native_handle(), thread_name.c_str());
-        if (ret != 0)
-            handle_error_en(ret, std::string(" pthread_setname_np[" +
-                                             std::to_string(threadID) + ']')
-                                     .c_str());
-#undef handle_error_en
-#endif // _WIN32
+    native_handle_type native_handle() {
+#ifdef PLATFORM_LINUX
+        return m_handle;
+#else
+        return m_thread.native_handle();
+#endif // PLATFORM_LINUX
     }
 
-    // wi::backlog::post("wi::jobsystem Initialized with [" +
-    // std::to_string(internal_state.numCores) + " cores] [" +
-    // std::to_string(internal_state.numThreads) + " threads] (" +
-    // std::to_string((int)std::round(timer.elapsed())) + " ms)");
-    _is_initialized_ = true;
-}
+  private:
+#ifdef PLATFORM_LINUX
+    pthread_t m_handle;
+#else
+    std::thread m_thread;
+#endif // PLATFORM_LINUX
+};
 
-void shutdown() { internal_state.shutdown(); }
+// Per-thread arena backing JobArgs::sharedmemory
+//	Groups push their memory on entry and pop it on exit, so a group started
+// from a nested wait_for() gets memory above the waiting group
+inline ScratchArena& local_scratch_arena() {
+#if ARC_FIBERS
+    // Parked groups keep their memory, so in fiber mode every fiber has an
+    // arena of its own
+    if (tls_worker_fibers != nullptr) {
+        return tls_worker_fibers->current->scratch;
+    }
+#endif // ARC_FIBERS
+    thread_local ScratchArena arena;
+    return arena;
+}
 
-uint32_t get_thread_count() { return internal_state.n_threads; }
+// Fold the cost of a finished group into the moving average
+//	Concurrent groups may overwrite each other's sample, which only slows the
+// average down a little
+inline void record_group_cost(GrainStats& stats, double ns, uint32_t jobs) {
+    const double sample = ns / jobs;
+    const double average = stats.ns_per_job.load(std::memory_order_relaxed);
+    stats.ns_per_job.store(
+        average == 0.0 ? sample
+                       : average + (sample - average) * auto_cost_weight,
+        std::memory_order_relaxed);
+}
 
-// Add a task to execute asynchronously. Any idle thread will execute this.
-void execute(Context& ctx, const std::function<void(JobArgs)>& task) {
-    // Context state is updated:
-    ctx.counter.fetch_add(1);
+// Group size for jobCount jobs of a kernel with the given stats, run by
+// threadCount workers and the submitting thread
+//	Enough groups to balance over every thread, unless that makes groups so
+// short that queueing them costs more than running them. Before the first
+// measurement only the balance is considered
+inline uint32_t pick_group_size(const GrainStats& stats, uint32_t jobCount,
+                                uint32_t threadCount) {
+    const uint32_t groups = (threadCount + 1) * auto_groups_per_thread;
+    uint32_t groupSize = std::max(1u, (jobCount + groups - 1) / groups);
+    const double ns_per_job = stats.ns_per_job.load(std::memory_order_relaxed);
+    if (ns_per_job > 0.0) {
+        const double shortest = std::ceil(auto_min_group_ns / ns_per_job);
+        if (shortest > groupSize) {
+            groupSize = (uint32_t)std::min<double>(shortest, jobCount);
+        }
+    }
+    return groupSize;
+}
 
-    Job job;
-    job.context = &ctx;
-    job.task = task;
-    job.group_ID = 0;
-    job.group_job_offset = 0;
-    job.group_job_end = 1;
-    job.sharedmemory_size = 0;
-
-    internal_state
-        .job_queue_per_thread[internal_state.next_queue.fetch_add(1) %
-                              internal_state.n_threads]
-        .push_back(job);
-    internal_state.wake_condition.notify_one();
-}
-
-uint32_t dispatch_group_count(uint32_t jobCount, uint32_t groupSize);
-// Divide a task onto multiple jobs and execute in parallel.
-//	jobCount	: how many jobs to generate for this task.
-//	groupSize	: how many jobs to execute per thread. Jobs inside a group
-// execute serially. It might be worth to increase for small jobs 	task :
-// receives a JobArgs as parameter
-void dispatch(Context& ctx, uint32_t jobCount, uint32_t groupSize,
-              const std::function<void(JobArgs)>& task,
-              size_t sharedmemory_size) {
-    if (jobCount == 0 || groupSize == 0) {
-        return;
+// Runs every job of a group serially on the calling thread
+//	The kernel is called directly, so it can be inlined into the loop
+template <typename F>
+inline void run_group(F& task, const Job& job) {
+    JobArgs args;
+    args.group_ID = job.group_ID;
+    args.sharedmemory_size = job.sharedmemory_size;
+    args.cancel_token = job.context->cancel_token;
+    ScratchArena* scratch = nullptr;
+    if (job.sharedmemory_size > 0) {
+        scratch = &local_scratch_arena();
+        args.sharedmemory =
+            scratch->push(job.sharedmemory_size,
+                          job.sharedmemory_init == SHAREDMEMORY_ZEROED);
+    } else {
+        args.sharedmemory = nullptr;
     }
 
-    const uint32_t groupCount = dispatch_group_count(jobCount, groupSize);
+    std::chrono::steady_clock::time_point start;
+    if (job.grain != nullptr) {
+        start = std::chrono::steady_clock::now();
+    }
 
-    // Context state is updated:
-    ctx.counter.fetch_add(groupCount);
+    for (uint32_t j = job.group_job_offset; j < job.group_job_end; ++j) {
+        if (job.cancellable && args.is_cancelled()) {
+            break;
+        }
+        args.job_index = j;
+        args.group_index = j - job.group_job_offset;
+        args.is_first_job_in_group = (j == job.group_job_offset);
+        args.is_last_job_in_group = (j == job.group_job_end - 1);
+        task(args);
+    }
 
-    Job job;
-    job.context = &ctx;
-    job.task = task;
-    job.sharedmemory_size = (uint32_t)sharedmemory_size;
+    if (job.grain != nullptr) {
+        const std::chrono::duration<double, std::nano> elapsed =
+            std::chrono::steady_clock::now() - start;
+        record_group_cost(*job.grain, elapsed.count(),
+                          job.group_job_end - job.group_job_offset);
+    }
 
-    for (uint32_t groupID = 0; groupID < groupCount; ++groupID) {
-        // For each group, generate one real job:
-        job.group_ID = groupID;
-        job.group_job_offset = groupID * groupSize;
-        job.group_job_end =
-            std::min(job.group_job_offset + groupSize, jobCount);
+    if (scratch != nullptr) {
+        const bool intact = scratch->pop();
+        ARC_ASSERT(intact && "job wrote past the end of its sharedmemory");
+        ARC_UNUSED(intact);
+    }
+}
 
-        internal_state
-            .job_queue_per_thread[internal_state.next_queue.fetch_add(1) %
-                                  internal_state.n_threads]
-            .push_back(job);
+// Runs the task of a job and completes it on its Context, a cancelled job is
+// only completed
+inline void run_job(Job* job) {
+    Context* ctx = job->context;
+    if (job->cancellable && is_cancelled(*ctx)) {
+        release_job(job);
+        complete(*ctx);
+        return;
     }
+    ARC_JOB_PROFILE(PROFILE_JOB_BEGIN, ctx->name, job->group_ID);
+    stats_count(&WorkerStats::jobs_executed);
+    job->task(*job);
+    release_job(job);
+    ARC_JOB_PROFILE(PROFILE_JOB_END, nullptr, 0);
+    complete(*ctx);
+}
+
+// A job running task once on ctx, ctx is busy from here on
+//	The job is not queued anywhere, it is run and released by run_job()
+template <typename F>
+inline Job* make_job(Context& ctx, F&& task) {
+    ctx.counter.fetch_add(1);
 
-    internal_state.wake_condition.notify_all();
+    Job* job = allocate_job();
+    job->context = &ctx;
+    job->task.emplace([task = std::forward<F>(task)](const Job& job) mutable {
+        run_group(task, job);
+    });
+    job->group_ID = 0;
+    job->group_job_offset = 0;
+    job->group_job_end = 1;
+    job->sharedmemory_size = 0;
+    job->sharedmemory_init = SHAREDMEMORY_UNINITIALIZED;
+    job->grain = nullptr;
+    job->dependency_count = 0;
+    return job;
 }
 
 // Returns the amount of job groups that will be created for a set number of
 // jobs and group size
-uint32_t dispatch_group_count(uint32_t jobCount, uint32_t groupSize) {
+inline uint32_t dispatch_group_count(uint32_t jobCount, uint32_t groupSize) {
     // Calculate the amount of job groups to dispatch (overestimate, or "ceil"):
     return (jobCount + groupSize - 1) / groupSize;
 }
 
 // Check if any threads are working currently or not
-bool is_busy(const Context& ctx) {
+inline bool is_busy(const Context& ctx) {
     // Whenever the context label is greater than zero, it means that there is
     // still work that needs to be done
     return ctx.counter.load() > 0;
 }
 
-// Wait until all threads become idle
-//	Current thread will become a worker thread, executing jobs
-void wait_for(const Context& ctx) {
-    if (is_busy(ctx)) {
-        // Wake any threads that might be sleeping:
-        internal_state.wake_condition.notify_all();
+// Parks a thread in wait_for() until its Context drains
+struct ContextParker : ContextWaiter {
+    std::atomic<uint32_t> signaled{0};
+    // Futex word the thread sleeps on, a thread of the system also waits for
+    // jobs of execute_on() on WorkerQueues::inbox_epoch
+    std::atomic<uint32_t>* wake_word = &signaled;
+
+    ContextParker() {
+        notify = [](ContextWaiter* waiter) {
+            auto* parker = static_cast<ContextParker*>(waiter);
+            std::atomic<uint32_t>* word = parker->wake_word;
+            const bool own = word == &parker->signaled;
+            parker->signaled.store(1); // the parker may be gone after this
+            if (!own) {
+                word->fetch_add(1);
+            }
+            futex_wake(*word, 1);
+        };
+    }
+};
 
-        // work() will pick up any jobs that are on stand by and execute them on
-        // this thread:
-        work(internal_state.next_queue.fetch_add(1) % internal_state.n_threads);
+// Values of a WorkerStats at one point in time
+struct WorkerCounters {
+    uint64_t jobs_executed = 0;
+    uint64_t jobs_stolen = 0;
+    uint64_t busy_ns = 0;
+    uint64_t idle_ns = 0;
+    uint64_t parked_ns = 0;
+    uint64_t lock_wait_ns = 0;
+    uint64_t wait_help_ns = 0;
+    uint64_t wait_spin_ns = 0;
+    uint64_t wait_sleep_ns = 0;
+    uint32_t queue_high_water = 0;
 
-        while (is_busy(ctx)) {
-            // If we are here, then there are still remaining jobs that work()
-            // couldn't pick up.
-            //	In this case those jobs are not standing by on a queue but
-            // currently executing 	on other threads, so they cannot be picked
-            // up by this thread. 	Allow to swap out this thread by OS to not
-            // spin endlessly for nothing
-            std::this_thread::yield();
+    // Counters of stats at now, the period the worker is in included
+    static WorkerCounters load(const WorkerStats& stats, uint64_t now) {
+        constexpr auto relaxed = std::memory_order_relaxed;
+        constexpr auto acquire = std::memory_order_acquire;
+        WorkerCounters counters;
+        counters.jobs_executed = stats.jobs_executed.load(relaxed);
+        counters.jobs_stolen = stats.jobs_stolen.load(relaxed);
+        counters.busy_ns = stats.busy_ns.load(acquire);
+        counters.idle_ns = stats.idle_ns.load(acquire);
+        counters.parked_ns = stats.parked_ns.load(acquire);
+        // After the counters, see stats_enter()
+        const uint64_t start = stats.period_start.load(relaxed);
+        const uint8_t period = stats.period.load(relaxed);
+        if (now > start) {
+            if (period == PERIOD_BUSY) {
+                counters.busy_ns += now - start;
+            } else if (period == PERIOD_IDLE) {
+                counters.idle_ns += now - start;
+            } else if (period == PERIOD_PARKED) {
+                counters.parked_ns += now - start;
+            }
         }
+        counters.lock_wait_ns = stats.lock_wait_ns.load(relaxed);
+        counters.wait_help_ns = stats.wait_help_ns.load(relaxed);
+        counters.wait_spin_ns = stats.wait_spin_ns.load(relaxed);
+        counters.wait_sleep_ns = stats.wait_sleep_ns.load(relaxed);
+        counters.queue_high_water = stats.queue_high_water.load(relaxed);
+        return counters;
     }
+
+    // Counters added up, the higher of the high-water marks
+    WorkerCounters& operator+=(const WorkerCounters& other) {
+        jobs_executed += other.jobs_executed;
+        jobs_stolen += other.jobs_stolen;
+        busy_ns += other.busy_ns;
+        idle_ns += other.idle_ns;
+        parked_ns += other.parked_ns;
+        lock_wait_ns += other.lock_wait_ns;
+        wait_help_ns += other.wait_help_ns;
+        wait_spin_ns += other.wait_spin_ns;
+        wait_sleep_ns += other.wait_sleep_ns;
+        queue_high_water = std::max(queue_high_water, other.queue_high_water);
+        return *this;
+    }
+
+    // Counted since earlier, the high-water mark is kept as it is
+    //	A period that ended while earlier was taken can be counted a few
+    // nanoseconds long there, differences stop at 0
+    WorkerCounters operator-(const WorkerCounters& earlier) const {
+        auto since = [](uint64_t now, uint64_t then) {
+            return now > then ? now - then : 0;
+        };
+        WorkerCounters delta = *this;
+        delta.jobs_executed = since(jobs_executed, earlier.jobs_executed);
+        delta.jobs_stolen = since(jobs_stolen, earlier.jobs_stolen);
+        delta.busy_ns = since(busy_ns, earlier.busy_ns);
+        delta.idle_ns = since(idle_ns, earlier.idle_ns);
+        delta.parked_ns = since(parked_ns, earlier.parked_ns);
+        delta.lock_wait_ns = since(lock_wait_ns, earlier.lock_wait_ns);
+        delta.wait_help_ns = since(wait_help_ns, earlier.wait_help_ns);
+        delta.wait_spin_ns = since(wait_spin_ns, earlier.wait_spin_ns);
+        delta.wait_sleep_ns = since(wait_sleep_ns, earlier.wait_sleep_ns);
+        return delta;
+    }
+
+    // Share of the time the worker was running jobs, 0 without any time
+    double utilization() const {
+        const uint64_t total = busy_ns + idle_ns + parked_ns;
+        return total > 0 ? (double)busy_ns / total : 0.0;
+    }
+};
+
+/* @brief Snapshot of the counters of every thread of a JobSystem.
+ *
+ * Cheap enough to take once per second from a logger thread:
+ *
+ *     JobSystemStats last = stats();
+ *     every_second([&] {
+ *         JobSystemStats now = stats();
+ *         WorkerCounters second = now.delta(last).total();
+ *         logger->info("jobs " + std::to_string(second.jobs_executed) +
+ *                      " busy " + std::to_string(second.utilization()));
+ *         last = now;
+ *     });
+ *
+ * Counters are read one at a time while the workers update them, so they may
+ * be off by the jobs that ran during the read. High-water marks count since
+ * initialize(), a delta keeps them.
+ */
+struct JobSystemStats {
+    std::chrono::steady_clock::time_point time;
+    // One entry per worker slot, general workers first and then background
+    // ones, the last is the thread that called initialize(). Slots of workers
+    // that are not running keep what they counted
+    std::vector<WorkerCounters> workers;
+    uint32_t injection_high_water = 0; // most jobs queued by other threads
+
+    WorkerCounters total() const {
+        WorkerCounters sum;
+        for (const WorkerCounters& worker : workers) {
+            sum += worker;
+        }
+        return sum;
+    }
+
+    // Counted since earlier, a snapshot of the same system
+    JobSystemStats delta(const JobSystemStats& earlier) const {
+        JobSystemStats delta = *this;
+        for (size_t i = 0; i < workers.size() && i < earlier.workers.size();
+             ++i) {
+            delta.workers[i] = workers[i] - earlier.workers[i];
+        }
+        return delta;
+    }
+
+    // Wall time covered by a delta
+    double seconds_since(const JobSystemStats& earlier) const {
+        return std::chrono::duration<double>(time - earlier.time).count();
+    }
+};
+
+/* @brief A pool of worker threads with its own queues and configuration.
+ *
+ * The free functions of this namespace run on default_job_system(), further
+ * systems keep different kinds of work apart, such as a compute pool pinned
+ * to the fast cores next to an oversubscribed pool for blocking I/O:
+ *
+ *     JobSystemConfig config;
+ *     config.name = "arc::io::";
+ *     config.thread_count = 16;
+ *     config.oversubscribe = true;
+ *     JobSystem io(config);
+ *
+ *     io.execute(load, [&](JobArgs) {
+ *         read_file(path, bytes);
+ *         execute(decode, [&](JobArgs) { decompress(bytes); });
+ *     });
+ *
+ * Any thread may submit to any system, including workers of another system.
+ * A Context may hold jobs of several systems, and waiting on it only helps
+ * with jobs of the system that is waited through.
+ */
+class JobSystem {
+  public:
+    JobSystem() = default;
+    explicit JobSystem(const JobSystemConfig& _config) { initialize(_config); }
+    ~JobSystem() { shutdown(); }
+
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    /* @brief Start the worker threads, does nothing if they are running
+     *
+     * Unless it already works for another system, the calling thread gets a
+     * queue of its own in this system, its submissions skip the shared
+     * injection queue. Use set_thread_count() to resize a running system.
+     */
+    void initialize(const JobSystemConfig& _config) {
+        if (m_n_queues > 0)
+            return;
+        m_config = _config;
+        const uint32_t maxThreadCount = std::max(1u, m_config.thread_count);
+        const ThreadPlacement& placement = m_config.placement;
+
+        Timer timer;
+
+        // Retrieve the number of hardware threads in this system:
+        m_n_cores = std::thread::hardware_concurrency();
+
+        std::vector<CpuInfo> order;
+        const PlacementPolicy policy =
+            placement.policy == PLACEMENT_NONE && !placement.cpus.empty()
+                ? PLACEMENT_COMPACT
+                : placement.policy;
+        if (policy != PLACEMENT_NONE) {
+            CpuTopology topology = CpuTopology::current();
+            if (!placement.cpus.empty()) {
+                topology = topology.subset(placement.cpus);
+            }
+            order = topology.placement_order(policy);
+            m_n_cores = policy == PLACEMENT_PHYSICAL_CORES
+                            ? topology.n_cores
+                            : (uint32_t)topology.cpus.size();
+        }
+
+        // Calculate the actual number of worker threads we want (-1 main
+        // thread):
+        const uint32_t n_general_threads = limit_thread_count(maxThreadCount);
+        const uint32_t backgroundThreadCount =
+            m_config.background_thread_count;
+        // Every general worker the system may grow to has its slot from the
+        // start, so thieves never see the queues move. Background workers
+        // come after them
+        m_n_max_general = std::max(
+            n_general_threads, limit_thread_count(m_config.max_thread_count));
+        m_n_background_threads = backgroundThreadCount;
+        m_n_slots = m_n_max_general + backgroundThreadCount;
+        m_n_general.store(n_general_threads);
+        m_n_threads.store(n_general_threads + backgroundThreadCount);
+        // One queue per worker slot, plus one for the thread calling
+        // initialize():
+        m_n_queues = m_n_slots + 1;
+        m_job_queue_per_thread.reset(new WorkerQueues[m_n_queues]);
+        for (JobQueue& injection : m_injection_queue) {
+            injection.high_water.store(0);
+        }
+        m_threads.resize(m_n_slots);
+        m_retire.reset(new std::atomic<bool>[m_n_slots]);
+        m_alive.store(true);
+        if (tls_job_system == nullptr) {
+            tls_job_system = this;
+            tls_queue_index = m_n_slots;
+            tls_worker_stats = &m_job_queue_per_thread[m_n_slots].stats;
+            m_owner = &tls_job_system;
+            m_owner_stats = &tls_worker_stats;
+#if ARC_JOB_PROFILER
+            profile_thread_name("arc::main");
+#endif // ARC_JOB_PROFILER
+        }
+
+        // Hand out CPUs in placement order, the main thread takes the first
+        // core if it is reserved, and workers wrap around when there are more
+        // of them than CPUs
+        WorkerQueues* queues = m_job_queue_per_thread.get();
+        m_worker_cpus.assign(m_n_slots, -1);
+        if (!order.empty()) {
+            queues[m_n_slots].l3 = unknown_l3;
+            if (placement.reserve_main_core && order.size() > 1) {
+                const CpuInfo main = order.front();
+                order.erase(std::remove_if(order.begin(), order.end(),
+                                           [&](const CpuInfo& c) {
+                                               return c.core == main.core;
+                                           }),
+                            order.end());
+                if (order.empty()) {
+                    order.push_back(main); // a single core is shared after all
+                }
+#ifdef PLATFORM_LINUX
+                pthread_getaffinity_np(pthread_self(), sizeof(m_main_affinity),
+                                       &m_main_affinity);
+                cpu_set_t cpuset;
+                CPU_ZERO(&cpuset);
+                CPU_SET(main.cpu, &cpuset);
+                if (pthread_setaffinity_np(pthread_self(), sizeof(cpuset),
+                                           &cpuset) == 0) {
+                    m_main_cpu = (int32_t)main.cpu;
+                    queues[m_n_slots].l3 = main.l3;
+                }
+#endif // PLATFORM_LINUX
+            }
+            for (uint32_t threadID = 0; threadID < m_n_slots; ++threadID) {
+                const CpuInfo& cpu = order[threadID % order.size()];
+                m_worker_cpus[threadID] = (int32_t)cpu.cpu;
+                queues[threadID].l3 = cpu.l3;
+            }
+        }
+
+        for (uint32_t threadID = 0; threadID < m_n_slots; ++threadID) {
+            m_retire[threadID].store(false);
+            if (threadID < n_general_threads || threadID >= m_n_max_general) {
+                start_worker(threadID);
+            }
+        }
+
+        if (m_config.autoscale.enabled) {
+            m_scaler_stop = false;
+            m_scaler = std::thread([this] { run_scaler(); });
+        }
+
+        // Ticks carry on from the previous run, the wheel never goes back
+        m_timer_epoch = std::chrono::steady_clock::now() -
+                        (int64_t)m_timers.now() * m_config.timer_tick;
+
+        // wi::backlog::post("wi::jobsystem Initialized with [" +
+        // std::to_string(internal_state.numCores) + " cores] [" +
+        // std::to_string(internal_state.numThreads) + " threads] (" +
+        // std::to_string((int)std::round(timer.elapsed())) + " ms)");
+    }
+
+    /* @brief Stop and join the workers, jobs that never got to run are dropped
+     *
+     * Should be called from the thread that called initialize(), or once that
+     * thread stopped submitting. In fiber mode no job may be parked in
+     * wait_for() anymore, as the stack it is parked on is freed.
+     */
+    void shutdown() {
+        if (m_timer_thread.joinable()) {
+            {
+                std::scoped_lock lock(m_timer_locker);
+                m_timer_stop = true;
+            }
+            m_timer_wake.notify_one();
+            m_timer_thread.join();
+            m_timer_stop = false;
+        }
+        if (m_scaler.joinable()) {
+            {
+                std::scoped_lock lock(m_scaler_locker);
+                m_scaler_stop = true;
+            }
+            m_scaler_wake.notify_one();
+            m_scaler.join();
+        }
+        std::scoped_lock lock(m_resize_locker);
+        m_alive.store(
+            false); // indicate that new jobs cannot be started from this point
+        for (ParkingLot* lot : {&m_general_workers, &m_background_workers}) {
+            lot->wake_epoch.fetch_add(1);
+            futex_wake_all(lot->wake_epoch); // wakes up sleeping worker threads
+        }
+        for (auto& thread : m_threads) {
+            if (thread != nullptr) {
+                thread->join();
+            }
+        }
+
+        // Jobs that never got to run are dropped
+        Job* job;
+        for (uint32_t lane = 0; lane < PRIORITY_COUNT; ++lane) {
+            for (uint32_t i = 0; i < m_n_queues; ++i) {
+                while (m_job_queue_per_thread[i].lanes[lane].pop(job))
+                    release_job(job);
+                while (m_job_queue_per_thread[i].affine[lane].pop_front(job))
+                    release_job(job);
+                while (m_job_queue_per_thread[i].pinned[lane].pop_front(job))
+                    release_job(job);
+            }
+            while (m_injection_queue[lane].pop_front(job))
+                release_job(job);
+        }
+        {
+            std::scoped_lock lock(m_timer_locker);
+            m_timers.clear([](Job* job) { release_job(job); });
+            m_frame_timers.clear([](Job* job) { release_job(job); });
+        }
+
+#ifdef PLATFORM_LINUX
+        if (m_main_cpu >= 0) {
+            pthread_setaffinity_np(pthread_self(), sizeof(m_main_affinity),
+                                   &m_main_affinity);
+        }
+#endif // PLATFORM_LINUX
+        if (m_owner != nullptr && *m_owner == this) {
+            *m_owner = nullptr;
+            *m_owner_stats = nullptr;
+        }
+        m_owner = nullptr;
+        m_owner_stats = nullptr;
+        m_main_cpu = -1;
+        m_worker_cpus.clear();
+        m_job_queue_per_thread.reset();
+        m_threads.clear();
+        m_retire.reset();
+        m_n_cores = 0;
+        m_n_threads.store(0);
+        m_n_general.store(0);
+        m_n_max_general = 0;
+        m_n_background_threads = 0;
+        m_n_slots = 0;
+        m_n_queues = 0;
+    }
+
+    /* @brief Resize the general workers while the system runs
+     *
+     * count is clamped to [1, max general workers], see
+     * JobSystemConfig::max_thread_count. New workers start taking jobs right
+     * away, submitters are never blocked. Retired workers first run every job
+     * left in their own queue and wait for their parked jobs, then this call
+     * joins them. Must not be called from a worker of this system.
+     * @return the new number of general workers
+     */
+    uint32_t set_thread_count(uint32_t count) {
+        ARC_ASSERT(!(tls_job_system == this && tls_queue_index < m_n_slots) &&
+                   "a worker cannot resize its own system");
+        std::scoped_lock lock(m_resize_locker);
+        if (m_n_queues == 0) {
+            return 0;
+        }
+        count = std::min(std::max(count, 1u), m_n_max_general);
+        uint32_t general = m_n_general.load();
+        for (; general < count; ++general) {
+            start_worker(general);
+            m_n_general.fetch_add(1);
+            m_n_threads.fetch_add(1);
+        }
+        if (count < general) {
+            for (uint32_t threadID = count; threadID < general; ++threadID) {
+                m_retire[threadID].store(true);
+            }
+            m_n_general.store(count);
+            m_n_threads.fetch_sub(general - count);
+            m_general_workers.wake_epoch.fetch_add(1);
+            futex_wake_all(m_general_workers.wake_epoch);
+            for (uint32_t threadID = count; threadID < general; ++threadID) {
+                m_threads[threadID]->join();
+                m_threads[threadID].reset();
+                m_retire[threadID].store(false);
+            }
+        }
+        return count;
+    }
+
+    // Workers are running, between initialize() and shutdown()
+    bool ready() const { return m_n_queues > 0; }
+
+    const JobSystemConfig& config() const { return m_config; }
+
+    // Every worker, background ones included, changes with
+    // set_thread_count()
+    uint32_t get_thread_count() const { return m_n_threads.load(); }
+
+    /* @brief Counters of every thread of the system, see JobSystemStats
+     *
+     * Only reads, any thread may call it while the system runs. Empty once
+     * shut down.
+     */
+    JobSystemStats stats() const {
+        JobSystemStats stats;
+        stats.time = std::chrono::steady_clock::now();
+        const uint64_t now = stats_now();
+        stats.workers.reserve(m_n_queues);
+        for (uint32_t i = 0; i < m_n_queues; ++i) {
+            const WorkerQueues& queues = m_job_queue_per_thread[i];
+            WorkerCounters counters = WorkerCounters::load(queues.stats, now);
+            for (uint32_t lane = 0; lane < PRIORITY_COUNT; ++lane) {
+                counters.queue_high_water = std::max(
+                    {counters.queue_high_water,
+                     queues.affine[lane].high_water.load(
+                         std::memory_order_relaxed),
+                     queues.pinned[lane].high_water.load(
+                         std::memory_order_relaxed)});
+            }
+            stats.workers.push_back(counters);
+        }
+        for (const JobQueue& injection : m_injection_queue) {
+            stats.injection_high_water = std::max(
+                stats.injection_high_water,
+                injection.high_water.load(std::memory_order_relaxed));
+        }
+        return stats;
+    }
+
+    // Most general workers the system can be resized to
+    uint32_t get_max_thread_count() const { return m_n_max_general; }
+
+    uint32_t get_background_thread_count() const {
+        return m_n_background_threads;
+    }
+
+    // CPU a worker is pinned to, or -1 if it may run anywhere
+    int32_t get_worker_cpu(uint32_t threadID) const {
+        return threadID < m_worker_cpus.size() ? m_worker_cpus[threadID] : -1;
+    }
+
+    // System the calling thread is a worker of, or initialized, if any
+    static JobSystem* current() { return tls_job_system; }
+
+    // Index of the calling thread in this system, the threadID of
+    // get_worker_cpu() and execute_on(), or ~0u for threads outside of it
+    //	Below get_max_thread_count() + get_background_thread_count() for
+    // workers, the thread that called initialize() takes the index after them
+    uint32_t get_worker_id() const {
+        return tls_job_system == this ? tls_queue_index : ~0u;
+    }
+
+    // Add a task to execute asynchronously. Any idle thread will execute this.
+    //	task is stored inline in the job, it must fit in ARC_JOB_FUNCTION_SIZE
+    template <typename F>
+    void execute(Context& ctx, F&& task) {
+        submit(make_job(ctx, std::forward<F>(task)));
+        wake_workers(1, ctx.priority);
+    }
+
+    /* @brief Run task on one thread of the system, no other thread takes it
+     *
+     * For jobs that use resources of a worker that are not thread safe, such
+     * as a per-worker RNG stream, scratch allocator or command buffer, which
+     * can then be kept per worker instead of behind a lock:
+     *
+     *     std::vector<CommandBuffer> buffers(pool.get_max_thread_count());
+     *     for (uint32_t id = 0; id < pool.get_thread_count(); ++id) {
+     *         pool.execute_on(ctx, id, [&buffers, id](JobArgs) {
+     *             buffers[id].flush();
+     *         });
+     *     }
+     *     pool.wait_for(ctx);
+     *
+     * threadID is a get_worker_id(): general workers count from 0, background
+     * workers from get_max_thread_count(). The worker takes the job from an
+     * inbox of its own, whatever the priority of ctx, while it also waits on
+     * a Context of the same or a lower priority. Naming the thread that
+     * called initialize() queues the job until that thread waits on a Context
+     * or calls work(). The worker must be running and must not be retired by
+     * set_thread_count() before the job ran.
+     */
+    template <typename F>
+    void execute_on(Context& ctx, uint32_t threadID, F&& task) {
+        ARC_ASSERT(threadID < m_n_queues && "no such worker");
+        ARC_ASSERT((threadID == m_n_slots || m_threads[threadID] != nullptr) &&
+                   "the worker is not running");
+        Job* job = make_job(ctx, std::forward<F>(task));
+        WorkerQueues& queues = m_job_queue_per_thread[threadID];
+        queues.pinned[ctx.priority].push_back(job);
+        // The fence pairs with the one in wait_for(), so either the thread
+        // is seen asleep there or it sees the job before it sleeps
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (queues.inbox_sleeping.load(std::memory_order_relaxed) != 0) {
+            queues.inbox_epoch.fetch_add(1);
+            futex_wake(queues.inbox_epoch, 1);
+        }
+        if (threadID < m_n_slots) {
+            wake_worker(threadID);
+        }
+    }
+
+    // Add a task that is queued once every Context in dependencies has
+    // drained.
+    //	The caller does not block, ctx is busy from this call until task
+    // finished
+    template <typename F>
+    void execute(Context& ctx, std::initializer_list<Context*> dependencies,
+                 F&& task) {
+        ARC_ASSERT(dependencies.size() <= ARC_JOB_MAX_DEPENDENCIES);
+        Job* job = make_job(ctx, std::forward<F>(task));
+        job->system = this;
+        for (Context* dependency : dependencies) {
+            job->dependencies[job->dependency_count++] = dependency;
+        }
+
+        submit_when_ready(job);
+    }
+
+    // Type erased overload, copying the std::function may allocate
+    void execute(Context& ctx, const std::function<void(JobArgs)>& task) {
+        execute<const std::function<void(JobArgs)>&>(ctx, task);
+    }
+
+    // Divide a task onto multiple jobs and execute in parallel.
+    //	jobCount	: how many jobs to generate for this task.
+    //	groupSize	: how many jobs to execute per thread. Jobs inside a group
+    // execute serially. It might be worth to increase for small jobs, or pass
+    // auto_group_size to have it picked from the measured cost of task
+    //	task	: receives a JobArgs as parameter
+    //	sharedmemory_size	: bytes of JobArgs::sharedmemory per group, see
+    // SharedMemoryInit
+    //	task is copied into every group, so it must be copyable and fit in
+    // ARC_JOB_FUNCTION_SIZE
+    template <typename F>
+    void dispatch(Context& ctx, uint32_t jobCount, uint32_t groupSize, F&& task,
+                  size_t sharedmemory_size,
+                  SharedMemoryInit sharedmemory_init = SHAREDMEMORY_UNINITIALIZED) {
+        if (jobCount == 0) {
+            return;
+        }
+        const uint32_t groupCount =
+            make_groups(ctx, jobCount, groupSize, task, sharedmemory_size,
+                        sharedmemory_init, [this](Job* job) { submit(job); });
+        wake_workers(groupCount, ctx.priority);
+    }
+
+    // Dispatch once every Context in dependencies has drained.
+    //	A single launcher job waits on the dependencies and then dispatches the
+    // groups, so the kernel gets slightly less inline storage than dispatch()
+    template <typename F>
+    void dispatch(Context& ctx, std::initializer_list<Context*> dependencies,
+                  uint32_t jobCount, uint32_t groupSize, F&& task,
+                  size_t sharedmemory_size,
+                  SharedMemoryInit sharedmemory_init = SHAREDMEMORY_UNINITIALIZED) {
+        if (jobCount == 0) {
+            return;
+        }
+        Context* target = &ctx;
+        execute(ctx, dependencies,
+                [this, target, jobCount, groupSize,
+                 sharedmemory = (uint32_t)sharedmemory_size, sharedmemory_init,
+                 task = std::forward<F>(task)](JobArgs) {
+                    dispatch(*target, jobCount, groupSize, task, sharedmemory,
+                             sharedmemory_init);
+                });
+    }
+
+    // Type erased overload, copying the std::function may allocate
+    void dispatch(Context& ctx, uint32_t jobCount, uint32_t groupSize,
+                  const std::function<void(JobArgs)>& task,
+                  size_t sharedmemory_size,
+                  SharedMemoryInit sharedmemory_init = SHAREDMEMORY_UNINITIALIZED) {
+        dispatch<const std::function<void(JobArgs)>&>(
+            ctx, jobCount, groupSize, task, sharedmemory_size,
+            sharedmemory_init);
+    }
+
+    /* @brief Execute task once time has come, ctx is busy until then
+     *
+     * The job is kept in a timer wheel, inserting and cancelling it take the
+     * same time however many timers are pending. A timer thread, started
+     * with the first timed job, queues it when its tick has passed, rounding
+     * up to JobSystemConfig::timer_tick.
+     */
+    template <typename F>
+    TimerHandle execute_at(Context& ctx, std::chrono::steady_clock::time_point time,
+                           F&& task) {
+        ARC_ASSERT(ready());
+        Job* job = make_job(ctx, std::forward<F>(task));
+        const auto since_epoch = time - m_timer_epoch;
+        const uint64_t tick =
+            since_epoch.count() <= 0
+                ? 0
+                : (uint64_t)((since_epoch + m_config.timer_tick -
+                              std::chrono::nanoseconds(1)) /
+                             m_config.timer_tick);
+        std::scoped_lock lock(m_timer_locker);
+        TimerHandle timer{m_timers.insert(tick, job), false};
+        if (!m_timer_thread.joinable()) {
+            m_timer_thread = std::thread([this] { run_timers(); });
+        } else if (tick < m_timer_wake_tick) {
+            m_timer_wake.notify_one(); // due before the timer thread wakes up
+        }
+        return timer;
+    }
+
+    // Execute task once delay has passed, see execute_at()
+    template <typename F>
+    TimerHandle execute_after(Context& ctx, std::chrono::nanoseconds delay,
+                              F&& task) {
+        return execute_at(ctx, std::chrono::steady_clock::now() + delay,
+                          std::forward<F>(task));
+    }
+
+    /* @brief Execute task on the frames-th call of advance_frame() from now,
+     * ctx is busy until then
+     *
+     * 0 frames executes right away.
+     */
+    template <typename F>
+    TimerHandle execute_after_frames(Context& ctx, uint32_t frames, F&& task) {
+        if (frames == 0) {
+            execute(ctx, std::forward<F>(task));
+            return TimerHandle{{}, true};
+        }
+        Job* job = make_job(ctx, std::forward<F>(task));
+        std::scoped_lock lock(m_timer_locker);
+        return TimerHandle{
+            m_frame_timers.insert(m_frame_timers.now() + frames - 1, job), true};
+    }
+
+    /* @brief Drop a timed job that was not queued yet, its Context counts it
+     * as done
+     *
+     * @return false if the job was queued or cancelled already
+     */
+    bool cancel_timer(const TimerHandle& timer) {
+        Job* job = nullptr;
+        {
+            std::scoped_lock lock(m_timer_locker);
+            TimerWheel<Job*>& wheel = timer.frames ? m_frame_timers : m_timers;
+            if (!wheel.cancel(timer.handle, &job)) {
+                return false;
+            }
+        }
+        Context& ctx = *job->context;
+        release_job(job);
+        complete(ctx);
+        return true;
+    }
+
+    /* @brief Start the next frame, queueing the jobs of execute_after_frames()
+     * that are due. Call once per frame from the main loop
+     *
+     * @return number of jobs that were queued
+     */
+    uint32_t advance_frame() {
+        std::vector<Job*> due[PRIORITY_COUNT];
+        {
+            std::scoped_lock lock(m_timer_locker);
+            m_frame_timers.advance(m_frame_timers.now() + 1, [&due](Job* job) {
+                due[job->context->priority].push_back(job);
+            });
+        }
+        return submit_and_wake(due);
+    }
+
+    // Calls of advance_frame() so far
+    uint64_t frame_index() {
+        std::scoped_lock lock(m_timer_locker);
+        return m_frame_timers.now();
+    }
+
+    /* @brief Dispatch whose groups go to the same threads from run to run
+     *
+     * The groups are split into contiguous blocks, one per worker that takes
+     * jobs of ctx plus the calling thread if it has a queue in this system.
+     * As long as jobCount, groupSize and the number of workers stay the same,
+     * group k lands on the same worker every frame and finds its data still
+     * in that core's caches. Workers run their own blocks first, and only
+     * take from the blocks of others once no other work is left.
+     */
+    template <typename F>
+    void dispatch_affine(
+        Context& ctx, uint32_t jobCount, uint32_t groupSize, F&& task,
+        size_t sharedmemory_size,
+        SharedMemoryInit sharedmemory_init = SHAREDMEMORY_UNINITIALIZED) {
+        if (jobCount == 0) {
+            return;
+        }
+        // Workers of the lane, background jobs go to background workers
+        // when there are any
+        const Priority lane = ctx.priority;
+        const bool background =
+            lane == PRIORITY_BACKGROUND && m_n_background_threads > 0;
+        const uint32_t first = background ? m_n_max_general : 0;
+        const uint32_t workers =
+            background ? m_n_background_threads : m_n_general.load();
+        const uint32_t self =
+            tls_job_system == this ? tls_queue_index : ~0u;
+        const bool own_block =
+            self < m_n_queues && (self < first || self >= first + workers);
+        const uint32_t participants = workers + (own_block ? 1 : 0);
+
+        // Consecutive groups of a block are queued under one lock
+        Job* run[64];
+        uint32_t run_size = 0;
+        uint32_t run_owner = 0;
+        auto flush = [&] {
+            if (run_size == 0) {
+                return;
+            }
+            if (run_owner < workers) {
+                m_job_queue_per_thread[first + run_owner].affine[lane].push_back(
+                    run, run_size);
+            } else {
+                submit(run, run_size); // the block of the calling thread
+            }
+            run_size = 0;
+        };
+        const uint32_t made = make_groups(
+            ctx, jobCount, groupSize, task, sharedmemory_size,
+            sharedmemory_init, [&](Job* job) {
+                const uint32_t owner = (uint32_t)(
+                    (uint64_t)job->group_job_offset * participants / jobCount);
+                if (owner != run_owner || run_size == 64) {
+                    flush();
+                    run_owner = owner;
+                }
+                run[run_size++] = job;
+            });
+        flush();
+        wake_workers(made, lane);
+    }
+
+    // Wait until all threads become idle
+    //	Current thread will become a worker thread, executing jobs of this
+    // system
+    //	Only jobs at least as urgent as ctx are picked up, so waiting on a frame
+    // Context never gets stuck behind a background job
+    //	On a worker in fiber mode the job is parked until ctx drains instead
+    void wait_for(const Context& ctx) {
+        if (!is_busy(ctx)) {
+            return;
+        }
+#if ARC_FIBERS
+        if (tls_worker_fibers != nullptr) {
+            // Registering a waiter only touches the waiter list
+            tls_worker_fibers->park(const_cast<Context&>(ctx), &fiber_main);
+            return;
+        }
+#endif // ARC_FIBERS
+        ARC_JOB_PROFILE(PROFILE_WAIT_BEGIN, ctx.name, 0);
+        const uint32_t lanes = lanes_up_to(ctx.priority);
+        uint32_t spin = 0;
+        uint64_t mark = tls_worker_stats != nullptr ? stats_now() : 0;
+        Job* job;
+        while (is_busy(ctx)) {
+            // find_job() will pick up any job that is on stand by and execute
+            // it on this thread:
+            if (find_job(job, lanes)) {
+                if (spin > 0) {
+                    stats_lap(mark, &WorkerStats::wait_spin_ns);
+                }
+                run_job(job);
+                stats_lap(mark, &WorkerStats::wait_help_ns);
+                spin = 0;
+                continue;
+            }
+            // If we are here, then there are still remaining jobs that work()
+            // couldn't pick up.
+            //	In this case those jobs are not standing by on a queue but
+            // currently executing 	on other threads, so they cannot be
+            // picked up by this thread. 	Spin for a short while, then sleep
+            // until the last of them finishes instead of burning a core
+            if (spin < idle_spin_count) {
+                cpu_relax();
+                spin++;
+                continue;
+            }
+            // A thread of the system sleeps on its inbox, so jobs pinned to
+            // it by execute_on() still run while it waits
+            WorkerQueues* inbox = tls_job_system == this &&
+                                          tls_queue_index < m_n_queues
+                                      ? &m_job_queue_per_thread[tls_queue_index]
+                                      : nullptr;
+            ContextParker parker;
+            if (inbox != nullptr) {
+                parker.wake_word = &inbox->inbox_epoch;
+            }
+            // Registering a waiter only touches the waiter list, ctx is not
+            // otherwise modified
+            if (add_waiter(const_cast<Context&>(ctx), &parker)) {
+                ARC_JOB_PROFILE(PROFILE_SLEEP, nullptr, 0);
+                stats_lap(mark, &WorkerStats::wait_spin_ns);
+                while (parker.signaled.load() == 0) {
+                    if (inbox == nullptr) {
+                        futex_wait(parker.signaled, 0);
+                        continue;
+                    }
+                    // Set again on every round, a wait_for() nested in a
+                    // pinned job clears it
+                    inbox->inbox_sleeping.store(1);
+                    std::atomic_thread_fence(std::memory_order_seq_cst);
+                    const uint32_t epoch = inbox->inbox_epoch.load();
+                    if (find_pinned_job(job, lanes)) {
+                        inbox->inbox_sleeping.store(0);
+                        stats_lap(mark, &WorkerStats::wait_sleep_ns);
+                        run_job(job);
+                        stats_lap(mark, &WorkerStats::wait_help_ns);
+                    } else if (parker.signaled.load() == 0) {
+                        futex_wait(inbox->inbox_epoch, epoch);
+                    }
+                }
+                if (inbox != nullptr) {
+                    inbox->inbox_sleeping.store(0);
+                }
+                stats_lap(mark, &WorkerStats::wait_sleep_ns);
+                ARC_JOB_PROFILE(PROFILE_WAKE, nullptr, 0);
+            }
+            spin = 0;
+        }
+        if (spin > 0) {
+            stats_lap(mark, &WorkerStats::wait_spin_ns);
+        }
+        ARC_JOB_PROFILE(PROFILE_WAIT_END, nullptr, 0);
+    }
+
+    // Push a job to the lane of its priority in the queue owned by the
+    // current thread, threads outside of the system go through the locked
+    // injection queue
+    void submit(Job* job) {
+        const Priority lane = job->context->priority;
+        if (tls_job_system == this && tls_queue_index < m_n_queues) {
+            WorkerQueues& queues = m_job_queue_per_thread[tls_queue_index];
+            queues.lanes[lane].push(job);
+            stats_high_water(queues.stats, queues.lanes[lane].size());
+        } else {
+            m_injection_queue[lane].push_back(job);
+        }
+    }
+
+    // Push count jobs that share a priority in one go, threads outside of the
+    // system take the injection queue lock once for all of them
+    //	Workers are not woken, see wake_workers()
+    void submit(Job* const* jobs, size_t count) {
+        if (count == 0) {
+            return;
+        }
+        const Priority lane = jobs[0]->context->priority;
+        if (tls_job_system == this && tls_queue_index < m_n_queues) {
+            WorkerQueues& queues = m_job_queue_per_thread[tls_queue_index];
+            WorkStealingQueue<Job*>& queue = queues.lanes[lane];
+            for (size_t i = 0; i < count; ++i) {
+                ARC_ASSERT(jobs[i]->context->priority == lane);
+                queue.push(jobs[i]);
+            }
+            stats_high_water(queues.stats, queue.size());
+        } else {
+            m_injection_queue[lane].push_back(jobs, count);
+        }
+    }
+
+    // Queue the job once every dependency has drained
+    //	Dependencies are walked one at a time, the job waits on the first busy
+    // one and continues from there when notified
+    void submit_when_ready(Job* job) {
+        while (job->dependency_count > 0) {
+            Context* dependency = job->dependencies[--job->dependency_count];
+            job->notify = [](ContextWaiter* waiter) {
+                Job* job = static_cast<Job*>(waiter);
+                job->system->submit_when_ready(job);
+            };
+            if (add_waiter(*dependency, job)) {
+                return;
+            }
+        }
+        submit(job);
+        wake_workers(1, job->context->priority);
+    }
+
+    // Wake up to count parked workers after jobs of priority were queued
+    //	Skips the syscall when nobody is parked. The fence pairs with the one in
+    // park_worker(), so either the submitter sees the sleeper or the sleeper
+    // sees the new job
+    void wake_workers(uint32_t count, Priority priority) {
+        ParkingLot& lot = parking_lot(priority);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (lot.sleeping.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        lot.wake_epoch.fetch_add(1);
+        futex_wake(lot.wake_epoch, (int)std::min(count, 1u << 30));
+    }
+
+    // Make sure the worker threadID looks at its queues again
+    //	Parked workers cannot be woken one by one, every worker of its kind is
+    // woken if any of them is parked
+    void wake_worker(uint32_t threadID) {
+        ParkingLot& lot = threadID >= m_n_max_general ? m_background_workers
+                                                      : m_general_workers;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (lot.sleeping.load(std::memory_order_relaxed) == 0) {
+            return;
+        }
+        lot.wake_epoch.fetch_add(1);
+        futex_wake_all(lot.wake_epoch);
+    }
+
+    // Run a single job from lanes if one can be found
+    bool work_one(uint32_t lanes = all_lanes) {
+        Job* job;
+        if (!find_job(job, lanes)) {
+            return false;
+        }
+        run_job(job);
+        return true;
+    }
+
+    // Keep working until no more jobs can be found in any queue
+    void work() {
+        while (work_one()) {
+        }
+    }
+
+  private:
+    friend class JobBatch;
+
+    // Queue the jobs of every lane, indexed by priority, and wake workers for
+    // them at most once per kind of worker. The lanes are left empty
+    //	Returns the number of jobs that were queued
+    uint32_t submit_and_wake(std::vector<Job*>* lanes) {
+        uint32_t general = 0;
+        uint32_t background = 0;
+        for (uint32_t lane = 0; lane < PRIORITY_COUNT; ++lane) {
+            std::vector<Job*>& jobs = lanes[lane];
+            submit(jobs.data(), jobs.size());
+            (lane == PRIORITY_BACKGROUND ? background : general) +=
+                (uint32_t)jobs.size();
+            jobs.clear(); // keeps the capacity for the next batch
+        }
+        // Background jobs share the general workers unless the system has
+        // workers of its own for them
+        if (m_n_background_threads == 0) {
+            general += background;
+            background = 0;
+        }
+        if (general > 0) {
+            wake_workers(general, PRIORITY_NORMAL);
+        }
+        if (background > 0) {
+            wake_workers(background, PRIORITY_BACKGROUND);
+        }
+        return general + background;
+    }
+
+    // Split a dispatch into group jobs and pass each to out(Job*), ctx is
+    // busy from here on
+    //	Returns the number of groups
+    template <typename F, typename Out>
+    uint32_t make_groups(Context& ctx, uint32_t jobCount, uint32_t groupSize,
+                         F& task, size_t sharedmemory_size,
+                         SharedMemoryInit sharedmemory_init, Out&& out) {
+        if (jobCount == 0) {
+            return 0;
+        }
+
+        GrainStats* grain = nullptr;
+        if (groupSize == auto_group_size) {
+            grain = &grain_stats<std::decay_t<F>>();
+            const uint32_t threads =
+                m_n_threads.load(std::memory_order_relaxed);
+            groupSize = pick_group_size(*grain, jobCount, threads);
+            grain->group_size.store(groupSize, std::memory_order_relaxed);
+            grain->dispatches.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        const uint32_t groupCount = dispatch_group_count(jobCount, groupSize);
+
+        // Context state is updated:
+        ctx.counter.fetch_add(groupCount);
+
+        for (uint32_t groupID = 0; groupID < groupCount; ++groupID) {
+            // For each group, generate one real job:
+            Job* job = allocate_job();
+            job->context = &ctx;
+            job->task.emplace(
+                [task](const Job& job) mutable { run_group(task, job); });
+            job->sharedmemory_size = (uint32_t)sharedmemory_size;
+            job->sharedmemory_init = sharedmemory_init;
+            job->grain = grain;
+            job->group_ID = groupID;
+            job->group_job_offset = groupID * groupSize;
+            job->group_job_end =
+                std::min(job->group_job_offset + groupSize, jobCount);
+            job->dependency_count = 0;
+
+            out(job);
+        }
+        return groupCount;
+    }
+
+    // Start the worker of a slot, its previous thread must have been joined
+    void start_worker(uint32_t threadID) {
+        const bool background = threadID >= m_n_max_general;
+        ParkingLot* lot =
+            background ? &m_background_workers : &m_general_workers;
+        const uint32_t lanes =
+            background ? (1u << PRIORITY_BACKGROUND)
+            : m_n_background_threads > 0 ? lanes_up_to(PRIORITY_NORMAL)
+                                         : all_lanes;
+        // Linux allows 15 characters, the prefix is cut rather than the
+        // index
+        const std::string index = std::to_string(threadID);
+        const std::string thread_name =
+            m_config.name.substr(0, 15 - std::min<size_t>(15, index.size())) +
+            index;
+        m_threads[threadID].reset(
+            new WorkerThread(
+                [this, threadID, lot, lanes, thread_name] {
+                    tls_job_system = this;
+                    tls_queue_index = threadID;
+                    tls_worker_stats = &m_job_queue_per_thread[threadID].stats;
+#if ARC_JOB_PROFILER
+                    profile_thread_name(thread_name.c_str());
+#endif // ARC_JOB_PROFILER
+#if ARC_FIBERS
+                    if (m_config.fibers) {
+                        run_worker_on_fibers(*lot, lanes);
+                        return;
+                    }
+#endif // ARC_FIBERS
+                    run_worker(*lot, lanes);
+                },
+                m_config.stack_size));
+        WorkerThread& worker = *m_threads[threadID];
+
+#ifdef _WIN32
+        // Do Windows-specific thread setup:
+        HANDLE handle = (HANDLE)worker.native_handle();
+
+        // Put each thread on to the core picked by the placement:
+        if (m_worker_cpus[threadID] >= 0) {
+            DWORD_PTR affinityMask = 1ull << m_worker_cpus[threadID];
+            DWORD_PTR affinity_result =
+                SetThreadAffinityMask(handle, affinityMask);
+            assert(affinity_result > 0);
+        }
+
+        //// Increase thread priority:
+        // BOOL priority_result = SetThreadPriority(handle,
+        // THREAD_PRIORITY_HIGHEST); assert(priority_result != 0);
+
+        // Name the thread:
+        std::wstring wthreadname(thread_name.begin(), thread_name.end());
+        HRESULT hr = SetThreadDescription(handle, wthreadname.c_str());
+        assert(SUCCEEDED(hr));
+#elif defined(PLATFORM_LINUX)
+#define handle_error_en(en, msg)                                               \
+    do {                                                                       \
+        errno = en;                                                            \
+        perror(msg);                                                           \
+    } while (0)
+
+        int ret;
+        const int32_t cpu = m_worker_cpus[threadID];
+        if (cpu >= 0) {
+            cpu_set_t cpuset;
+            CPU_ZERO(&cpuset);
+            size_t cpusetsize = sizeof(cpuset);
+
+            CPU_SET(cpu, &cpuset);
+            ret = pthread_setaffinity_np(worker.native_handle(), cpusetsize,
+                                         &cpuset);
+            if (ret != 0)
+                handle_error_en(ret, std::string(" pthread_setaffinity_np[" +
+                                                 std::to_string(threadID) +
+                                                 ']')
+                                         .c_str());
+        }
+
+        // Name the thread
+        ret = pthread_setname_np(worker.native_handle(),
+                                 thread_name.c_str());
+        if (ret != 0)
+            handle_error_en(ret, std::string(" pthread_setname_np[" +
+                                             std::to_string(threadID) + ']')
+                                     .c_str());
+#undef handle_error_en
+#endif // _WIN32
+        ARC_UNUSED(worker);
+    }
+
+    // Loop of a worker until shutdown(), or until it is retired and has
+    // nothing left to run
+    void run_worker(ParkingLot& lot, uint32_t lanes) {
+        uint32_t spin = 0;
+        Job* job;
+        while (m_alive.load()) {
+            if (resume_parked_job()) {
+                spin = 0;
+            } else if (find_job(job, lanes) || find_pinned_job(job)) {
+                stats_enter(PERIOD_BUSY);
+                run_job(job);
+                spin = 0;
+            } else if (retiring()) {
+                break;
+            } else if (spin < idle_spin_count) {
+                // finished with jobs, spin a little before sleeping
+                stats_enter(PERIOD_IDLE);
+                cpu_relax();
+                spin++;
+            } else {
+                park_worker(lot, lanes);
+                spin = 0;
+            }
+        }
+        stats_enter(PERIOD_NONE);
+    }
+
+#if ARC_FIBERS
+    // Worker in fiber mode, the thread stack only starts the first fiber and
+    // is returned to on shutdown
+    void run_worker_on_fibers(ParkingLot& lot, uint32_t lanes) {
+        WorkerFibers fibers(this, &lot, lanes, m_config.fiber_stack_size);
+        tls_worker_fibers = &fibers;
+        fibers.switch_to(fibers.acquire(&fiber_main), false);
+        // The stacks of the fibers are freed with fibers, a job still parked
+        // on one of them would continue on freed memory
+        ARC_ASSERT(fibers.parked == 0 &&
+                   "shutdown() while jobs are parked in wait_for()");
+        tls_worker_fibers = nullptr;
+    }
+
+    // Entry of every fiber, runs the worker loop until shutdown
+    static void fiber_main(void* arg) {
+        WorkerFibers& fibers = *static_cast<WorkerFibers*>(arg);
+        fibers.current->fiber.started();
+        fibers.finish_switch();
+        fibers.system->run_worker(*fibers.lot, fibers.lanes);
+        fibers.switch_to(&fibers.root, true);
+    }
+#endif // ARC_FIBERS
+
+    // Continue a job whose fiber was parked in wait_for(), if one is ready
+    //	The loop that is left here continues when its fiber is reused
+    bool resume_parked_job() {
+#if ARC_FIBERS
+        WorkerFibers* fibers = tls_worker_fibers;
+        if (fibers != nullptr) {
+            if (JobFiber* ready = fibers->pop_ready()) {
+                stats_enter(PERIOD_BUSY);
+                fibers->parked--;
+                fibers->switch_to(ready, true);
+                return true;
+            }
+        }
+#endif // ARC_FIBERS
+        return false;
+    }
+
+    // The calling worker was retired by set_thread_count() and none of its
+    // jobs are parked, its own queue is empty once work_one() found nothing
+    bool retiring() const {
+        if (!m_retire[tls_queue_index].load(std::memory_order_relaxed)) {
+            return false;
+        }
+#if ARC_FIBERS
+        return tls_worker_fibers == nullptr || tls_worker_fibers->parked == 0;
+#else
+        return true;
+#endif // ARC_FIBERS
+    }
+
+    // Parked jobs of the calling worker that are ready to continue
+    bool has_ready_parked_job() const {
+#if ARC_FIBERS
+        return tls_worker_fibers != nullptr && tls_worker_fibers->has_ready();
+#else
+        return false;
+#endif // ARC_FIBERS
+    }
+
+    // General workers that count can be met with, at most one per core
+    // besides the calling thread unless the system oversubscribes
+    uint32_t limit_thread_count(uint32_t count) const {
+        return m_config.oversubscribe
+                   ? count
+                   : std::min(count, std::max(1u, m_n_cores - 1));
+    }
+
+    // Jobs waiting in the lanes general workers take, a racy estimate
+    size_t queued_job_count() const {
+        const uint32_t lanes = m_n_background_threads > 0
+                                   ? lanes_up_to(PRIORITY_NORMAL)
+                                   : all_lanes;
+        size_t count = 0;
+        for (uint32_t lane = 0; lane < PRIORITY_COUNT; ++lane) {
+            if ((lanes & (1u << lane)) == 0) {
+                continue;
+            }
+            for (uint32_t i = 0; i < m_n_queues; ++i) {
+                count += m_job_queue_per_thread[i].lanes[lane].size();
+                count += m_job_queue_per_thread[i].affine[lane].count.load(
+                    std::memory_order_relaxed);
+            }
+            count +=
+                m_injection_queue[lane].count.load(std::memory_order_relaxed);
+        }
+        return count;
+    }
+
+    // Samples the load every interval and resizes the general workers, see
+    // AutoScale
+    void run_scaler() {
+        const AutoScale& config = m_config.autoscale;
+        const uint32_t min_count =
+            std::min(std::max(config.min_thread_count, 1u), m_n_max_general);
+        uint32_t busy_samples = 0;
+        uint32_t idle_samples = 0;
+        std::unique_lock lock(m_scaler_locker);
+        while (!m_scaler_wake.wait_for(lock, config.interval,
+                                       [this] { return m_scaler_stop; })) {
+            const uint32_t count = m_n_general.load();
+            const size_t queued = queued_job_count();
+            const uint32_t sleeping = m_general_workers.sleeping.load();
+            if (queued > (size_t)config.grow_queue_depth * count &&
+                count < m_n_max_general) {
+                idle_samples = 0;
+                if (++busy_samples < config.grow_samples) {
+                    continue;
+                }
+                busy_samples = 0;
+                lock.unlock();
+                set_thread_count(count + 1);
+                lock.lock();
+            } else if (sleeping >= config.shrink_idle_ratio * count &&
+                       count > min_count) {
+                busy_samples = 0;
+                if (++idle_samples < config.shrink_samples) {
+                    continue;
+                }
+                idle_samples = 0;
+                lock.unlock();
+                set_thread_count(count - 1);
+                lock.lock();
+            } else {
+                busy_samples = 0;
+                idle_samples = 0;
+            }
+        }
+    }
+
+    // Queues the timed jobs whose tick has passed and sleeps until the next
+    // one is due, or until execute_at() inserts an earlier one
+    void run_timers() {
+        std::vector<Job*> due[PRIORITY_COUNT];
+        std::unique_lock lock(m_timer_locker);
+        while (!m_timer_stop) {
+            const uint64_t tick =
+                (uint64_t)((std::chrono::steady_clock::now() - m_timer_epoch) /
+                           m_config.timer_tick);
+            bool any = false;
+            m_timers.advance(tick + 1, [&due, &any](Job* job) {
+                due[job->context->priority].push_back(job);
+                any = true;
+            });
+            if (any) {
+                lock.unlock();
+                submit_and_wake(due);
+                lock.lock();
+                continue;
+            }
+            m_timer_wake_tick = m_timers.next_due_hint();
+            if (m_timer_wake_tick == ~0ull) {
+                m_timer_wake.wait(lock);
+            } else {
+                m_timer_wake.wait_until(
+                    lock, m_timer_epoch +
+                              (int64_t)m_timer_wake_tick * m_config.timer_tick);
+            }
+        }
+    }
+
+    // Workers that take jobs of the given priority
+    ParkingLot& parking_lot(Priority priority) {
+        if (priority == PRIORITY_BACKGROUND && m_n_background_threads > 0) {
+            return m_background_workers;
+        }
+        return m_general_workers;
+    }
+
+    // Check if any queue holds a job in lanes, without taking anything
+    bool has_queued_jobs(uint32_t lanes) {
+        for (uint32_t lane = 0; lane < PRIORITY_COUNT; ++lane) {
+            if ((lanes & (1u << lane)) == 0) {
+                continue;
+            }
+            for (uint32_t i = 0; i < m_n_queues; ++i) {
+                if (!m_job_queue_per_thread[i].lanes[lane].empty() ||
+                    !m_job_queue_per_thread[i].affine[lane].empty()) {
+                    return true;
+                }
+            }
+            if (!m_injection_queue[lane].empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Put the calling worker to sleep until new jobs are queued in its lanes
+    void park_worker(ParkingLot& lot, uint32_t lanes) {
+        const uint32_t epoch = lot.wake_epoch.load();
+        lot.sleeping.fetch_add(1);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        if (!has_queued_jobs(lanes) && !has_pinned_job() &&
+            !has_ready_parked_job() && !retiring() && m_alive.load()) {
+            ARC_JOB_PROFILE(PROFILE_SLEEP, nullptr, 0);
+            stats_enter(PERIOD_PARKED);
+            futex_wait(lot.wake_epoch, epoch);
+            stats_enter(PERIOD_IDLE);
+            ARC_JOB_PROFILE(PROFILE_WAKE, nullptr, 0);
+        }
+        lot.sleeping.fetch_sub(1);
+    }
+
+    // Find a job of one priority
+    //	Own queue is popped LIFO first, then foreign submissions, and finally
+    // the oldest jobs are stolen from the other queues starting at a random
+    // victim
+    bool find_job_in_lane(Job*& job, Priority lane) {
+        const uint32_t self = tls_job_system == this ? tls_queue_index : ~0u;
+        const uint32_t n_queues = m_n_queues;
+        if (self < n_queues &&
+            (m_job_queue_per_thread[self].lanes[lane].pop(job) ||
+             m_job_queue_per_thread[self].pinned[lane].pop_front(job) ||
+             m_job_queue_per_thread[self].affine[lane].pop_front(job))) {
+            return true;
+        }
+        if (m_injection_queue[lane].pop_front(job)) {
+            return true;
+        }
+        if (n_queues == 0) {
+            return false;
+        }
+        // Victims that share our L3 are tried first, their jobs are the most
+        // likely to work on data that is already in our cache
+        const uint32_t home =
+            self < n_queues ? m_job_queue_per_thread[self].l3 : unknown_l3;
+        const uint32_t start = random_victim(n_queues);
+        for (uint32_t pass = 0; pass < 2; ++pass) {
+            for (uint32_t i = 0; i < n_queues; ++i) {
+                const uint32_t victim = (start + i) % n_queues;
+                WorkerQueues& queues = m_job_queue_per_thread[victim];
+                if (victim == self || (queues.l3 == home) != (pass == 0)) {
+                    continue;
+                }
+                // A failed steal only means another thread won the race, keep
+                // trying as long as the victim has work
+                WorkStealingQueue<Job*>& queue = queues.lanes[lane];
+                while (!queue.empty()) {
+                    if (queue.steal(job)) {
+                        ARC_JOB_PROFILE(PROFILE_STEAL, nullptr, victim);
+                        stats_count(&WorkerStats::jobs_stolen);
+                        return true;
+                    }
+                }
+            }
+        }
+        // Affine groups are only taken once there is nothing else, from the
+        // end their owner reaches last
+        for (uint32_t i = 0; i < n_queues; ++i) {
+            const uint32_t victim = (start + i) % n_queues;
+            if (victim != self &&
+                m_job_queue_per_thread[victim].affine[lane].pop_back(job)) {
+                ARC_JOB_PROFILE(PROFILE_STEAL, nullptr, victim);
+                stats_count(&WorkerStats::jobs_stolen);
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Find a job of execute_on() for the calling thread in lanes, by default
+    // in any lane, the lanes it does not take other jobs from included
+    bool find_pinned_job(Job*& job, uint32_t lanes = all_lanes) {
+        const uint32_t self = tls_job_system == this ? tls_queue_index : ~0u;
+        if (self >= m_n_queues) {
+            return false;
+        }
+        for (uint32_t lane = 0; lane < PRIORITY_COUNT; ++lane) {
+            if ((lanes & (1u << lane)) != 0 &&
+                m_job_queue_per_thread[self].pinned[lane].pop_front(job)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Jobs of execute_on() wait for the calling worker
+    bool has_pinned_job() const {
+        for (const JobQueue& pinned :
+             m_job_queue_per_thread[tls_queue_index].pinned) {
+            if (!pinned.empty()) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Find a job to run from lanes, the most urgent priority is searched first
+    bool find_job(Job*& job, uint32_t lanes = all_lanes) {
+        for (uint32_t lane = 0; lane < PRIORITY_COUNT; ++lane) {
+            if ((lanes & (1u << lane)) != 0 &&
+                find_job_in_lane(job, (Priority)lane)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    JobSystemConfig m_config;
+    uint32_t m_n_cores = 0;
+    std::atomic<uint32_t> m_n_threads{0}; // every worker, background ones included
+    std::atomic<uint32_t> m_n_general{0}; // general workers running
+    uint32_t m_n_max_general = 0;         // general worker slots
+    uint32_t m_n_background_threads = 0; // workers that only take background jobs
+    uint32_t m_n_slots = 0;              // general slots, then background ones
+    uint32_t m_n_queues = 0;
+    std::unique_ptr<WorkerQueues[]> m_job_queue_per_thread;
+    JobQueue m_injection_queue[PRIORITY_COUNT];
+    std::vector<int32_t> m_worker_cpus; // -1 for workers that are not pinned
+    int32_t m_main_cpu = -1;
+#ifdef PLATFORM_LINUX
+    cpu_set_t m_main_affinity; // restored on shutdown
+#endif // PLATFORM_LINUX
+    JobSystem** m_owner = nullptr; // tls_job_system of the initializing thread
+    WorkerStats** m_owner_stats = nullptr; // and its tls_worker_stats
+    std::atomic_bool m_alive{true};
+    ParkingLot m_general_workers;
+    ParkingLot m_background_workers;
+    std::vector<std::unique_ptr<WorkerThread>> m_threads; // null if retired
+    std::unique_ptr<std::atomic<bool>[]> m_retire; // per slot
+    std::mutex m_resize_locker; // serializes set_thread_count() and shutdown()
+    std::thread m_scaler;
+    std::mutex m_scaler_locker;
+    std::condition_variable m_scaler_wake;
+    bool m_scaler_stop = false;
+    // Jobs of execute_at() in ticks of timer_tick since m_timer_epoch, and of
+    // execute_after_frames() in calls of advance_frame()
+    std::mutex m_timer_locker;
+    TimerWheel<Job*> m_timers;
+    TimerWheel<Job*> m_frame_timers;
+    std::chrono::steady_clock::time_point m_timer_epoch =
+        std::chrono::steady_clock::now();
+    std::thread m_timer_thread;
+    std::condition_variable m_timer_wake;
+    uint64_t m_timer_wake_tick = 0; // tick the timer thread sleeps until
+    bool m_timer_stop = false;
+};
+
+/* @brief The JobSystem behind the free functions below
+ *
+ * Shut down when the program exits, if that was not done before.
+ */
+inline JobSystem& default_job_system() {
+    static JobSystem system;
+    return system;
+}
+
+inline bool ready() { return default_job_system().ready(); }
+
+// Start the worker threads of default_job_system(), see JobSystemConfig
+//	maxThreadCount	: upper bound of general workers, at most one per core
+// besides the calling thread
+//	backgroundThreadCount	: extra workers that only take PRIORITY_BACKGROUND
+// jobs
+//	placement	: how workers are pinned to CPUs, by default they are not
+inline void initialize(uint32_t maxThreadCount = 4,
+                       uint32_t backgroundThreadCount = 0,
+                       ThreadPlacement placement = {}) {
+    JobSystemConfig config;
+    config.thread_count = maxThreadCount;
+    config.background_thread_count = backgroundThreadCount;
+    config.placement = std::move(placement);
+    default_job_system().initialize(config);
+}
+
+inline void shutdown() { default_job_system().shutdown(); }
+
+inline uint32_t get_thread_count() {
+    return default_job_system().get_thread_count();
+}
+
+inline JobSystemStats stats() { return default_job_system().stats(); }
+
+inline uint32_t get_worker_id() { return default_job_system().get_worker_id(); }
+
+inline uint32_t get_background_thread_count() {
+    return default_job_system().get_background_thread_count();
+}
+
+// CPU a worker is pinned to, or -1 if it may run anywhere
+inline int32_t get_worker_cpu(uint32_t threadID) {
+    return default_job_system().get_worker_cpu(threadID);
+}
+
+// See JobSystem::execute()
+template <typename F>
+void execute(Context& ctx, F&& task) {
+    default_job_system().execute(ctx, std::forward<F>(task));
+}
+
+template <typename F>
+void execute(Context& ctx, std::initializer_list<Context*> dependencies,
+             F&& task) {
+    default_job_system().execute(ctx, dependencies, std::forward<F>(task));
+}
+
+inline void execute(Context& ctx, const std::function<void(JobArgs)>& task) {
+    default_job_system().execute(ctx, task);
+}
+
+// See JobSystem::execute_on()
+template <typename F>
+void execute_on(Context& ctx, uint32_t threadID, F&& task) {
+    default_job_system().execute_on(ctx, threadID, std::forward<F>(task));
+}
+
+// See JobSystem::dispatch()
+template <typename F>
+void dispatch(Context& ctx, uint32_t jobCount, uint32_t groupSize, F&& task,
+              size_t sharedmemory_size,
+              SharedMemoryInit sharedmemory_init = SHAREDMEMORY_UNINITIALIZED) {
+    default_job_system().dispatch(ctx, jobCount, groupSize,
+                                  std::forward<F>(task), sharedmemory_size,
+                                  sharedmemory_init);
+}
+
+template <typename F>
+void dispatch(Context& ctx, std::initializer_list<Context*> dependencies,
+              uint32_t jobCount, uint32_t groupSize, F&& task,
+              size_t sharedmemory_size,
+              SharedMemoryInit sharedmemory_init = SHAREDMEMORY_UNINITIALIZED) {
+    default_job_system().dispatch(ctx, dependencies, jobCount, groupSize,
+                                  std::forward<F>(task), sharedmemory_size,
+                                  sharedmemory_init);
+}
+
+inline void dispatch(Context& ctx, uint32_t jobCount, uint32_t groupSize,
+                     const std::function<void(JobArgs)>& task,
+                     size_t sharedmemory_size,
+                     SharedMemoryInit sharedmemory_init =
+                         SHAREDMEMORY_UNINITIALIZED) {
+    default_job_system().dispatch(ctx, jobCount, groupSize, task,
+                                  sharedmemory_size, sharedmemory_init);
+}
+
+// See JobSystem::dispatch_affine()
+template <typename F>
+void dispatch_affine(Context& ctx, uint32_t jobCount, uint32_t groupSize,
+                     F&& task, size_t sharedmemory_size,
+                     SharedMemoryInit sharedmemory_init =
+                         SHAREDMEMORY_UNINITIALIZED) {
+    default_job_system().dispatch_affine(ctx, jobCount, groupSize,
+                                         std::forward<F>(task),
+                                         sharedmemory_size, sharedmemory_init);
+}
+
+// See JobSystem::wait_for(), helps with jobs of default_job_system()
+inline void wait_for(const Context& ctx) { default_job_system().wait_for(ctx); }
+
+// See JobSystem::execute_at()
+template <typename F>
+TimerHandle execute_at(Context& ctx, std::chrono::steady_clock::time_point time,
+                       F&& task) {
+    return default_job_system().execute_at(ctx, time, std::forward<F>(task));
+}
+
+template <typename F>
+TimerHandle execute_after(Context& ctx, std::chrono::nanoseconds delay,
+                          F&& task) {
+    return default_job_system().execute_after(ctx, delay,
+                                              std::forward<F>(task));
 }
 
+template <typename F>
+TimerHandle execute_after_frames(Context& ctx, uint32_t frames, F&& task) {
+    return default_job_system().execute_after_frames(ctx, frames,
+                                                     std::forward<F>(task));
+}
+
+inline bool cancel_timer(const TimerHandle& timer) {
+    return default_job_system().cancel_timer(timer);
+}
+
+inline uint32_t advance_frame() { return default_job_system().advance_frame(); }
+
+/* @brief Collects jobs and hands them to a JobSystem all at once.
+ *
+ * Submitting many small jobs one by one takes a queue lock per job from
+ * threads outside of the system and may wake a worker per job. A batch keeps
+ * the jobs to itself until submit(), which queues each priority in one go and
+ * wakes only as many workers as there are jobs, at most once per kind of
+ * worker:
+ *
+ *     JobBatch batch;
+ *     for (Entity& entity : entities) {
+ *         batch.execute(ctx, [&entity](JobArgs) { entity.update(); });
+ *     }
+ *     batch.dispatch(ctx, particles.size(), 256, update_particle, 0);
+ *     batch.submit();
+ *     wait_for(ctx);
+ *
+ * Contexts are busy from the moment a job is added, so a batch has to be
+ * submitted before waiting on them. A batch submits whatever it still holds
+ * when it is destroyed, and may be refilled after submit().
+ */
+class JobBatch {
+  public:
+    explicit JobBatch(JobSystem& _system = default_job_system())
+        : m_system(&_system) {}
+    ~JobBatch() { submit(); }
+
+    JobBatch(const JobBatch&) = delete;
+    JobBatch& operator=(const JobBatch&) = delete;
+
+    // Add a job, see JobSystem::execute()
+    template <typename F>
+    void execute(Context& ctx, F&& task) {
+        m_jobs[ctx.priority].push_back(make_job(ctx, std::forward<F>(task)));
+    }
+
+    // Add the groups of a dispatch, see JobSystem::dispatch()
+    template <typename F>
+    void dispatch(Context& ctx, uint32_t jobCount, uint32_t groupSize, F&& task,
+                  size_t sharedmemory_size,
+                  SharedMemoryInit sharedmemory_init = SHAREDMEMORY_UNINITIALIZED) {
+        std::vector<Job*>& jobs = m_jobs[ctx.priority];
+        m_system->make_groups(ctx, jobCount, groupSize, task, sharedmemory_size,
+                              sharedmemory_init,
+                              [&jobs](Job* job) { jobs.push_back(job); });
+    }
+
+    // Jobs added since the last submit()
+    size_t size() const {
+        size_t count = 0;
+        for (const std::vector<Job*>& jobs : m_jobs) {
+            count += jobs.size();
+        }
+        return count;
+    }
+
+    /* @brief Queue every job that was added and wake workers for them
+     */
+    void submit() { m_system->submit_and_wake(m_jobs); }
+
+  private:
+    JobSystem* m_system;
+    std::vector<Job*> m_jobs[PRIORITY_COUNT];
+};
+
 } /*ns*/
 } /*ns*/
 } /*ns*/
@@ -0,0 +1,379 @@
+#pragma once
+
+#include <cstdint>
+#include <fstream>
+#include <ostream>
+#include <string>
+
+// Record a timeline of the job system threads, see profiler_begin()
+//	Every hook compiles to nothing unless this is 1
+#ifndef ARC_JOB_PROFILER
+#define ARC_JOB_PROFILER 0
+#endif
+
+#if ARC_JOB_PROFILER
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <mutex>
+#include <vector>
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+#endif // ARC_JOB_PROFILER
+
+namespace arc {
+namespace core {
+namespace JobManager {
+
+enum ProfileEventType : uint8_t {
+    PROFILE_JOB_BEGIN = 0, // a job group starts, labelled with Context::name
+    PROFILE_JOB_END,
+    PROFILE_STEAL,         // a job was stolen, arg is the victim queue
+    PROFILE_SLEEP,         // the thread parks on a futex
+    PROFILE_WAKE,
+    PROFILE_WAIT_BEGIN,    // wait_for() is entered, labelled with Context::name
+    PROFILE_WAIT_END,
+    PROFILE_SCOPE_BEGIN,   // user span, see ARC_JOB_PROFILE_SCOPE
+    PROFILE_SCOPE_END,
+};
+
+#if ARC_JOB_PROFILER
+
+struct ProfileEvent {
+    uint64_t ticks;
+    const char* label; // must outlive the export, usually a string literal
+    uint32_t arg;
+    ProfileEventType type;
+};
+
+// Events of one thread, written only by that thread
+//	The buffer is a ring, once it is full the oldest events are overwritten
+struct ProfileBuffer {
+    static constexpr uint32_t capacity = 1u << 16;
+
+    std::unique_ptr<ProfileEvent[]> events{new ProfileEvent[capacity]};
+    std::atomic<uint64_t> written{0};
+    char name[16] = {};
+    uint32_t tid = 0;
+};
+
+struct ProfilerState {
+    std::atomic<bool> recording{false};
+    std::mutex locker;
+    // Kept after their thread exits, so its events can still be exported
+    std::vector<std::unique_ptr<ProfileBuffer>> buffers;
+    uint64_t begin_ticks = 0;
+    uint64_t end_ticks = 0;
+    std::chrono::steady_clock::time_point begin_time;
+    std::chrono::steady_clock::time_point end_time;
+};
+
+inline ProfilerState profiler_state;
+inline thread_local ProfileBuffer* tls_profile_buffer = nullptr;
+inline thread_local char tls_profile_thread_name[16] = {};
+
+// Spans open on a thread, innermost last
+//	Kept whether or not a recording runs, so a fiber that is switched out in
+// the middle of a job can close its spans and open them again once it is
+// resumed, see profile_suspend(). Deeper spans than capacity are only
+// counted
+struct ProfileSpans {
+    static constexpr uint32_t capacity = 16;
+
+    ProfileEvent begins[capacity];
+    uint32_t count = 0;
+};
+
+inline thread_local ProfileSpans tls_profile_spans;
+
+// Every begin is followed by its end in ProfileEventType
+inline bool profile_is_begin(ProfileEventType type) {
+    return type == PROFILE_JOB_BEGIN || type == PROFILE_SLEEP ||
+           type == PROFILE_WAIT_BEGIN || type == PROFILE_SCOPE_BEGIN;
+}
+
+// Timestamp of an event, the TSC where there is one as it is several times
+// cheaper to read than the clock. Ticks are converted to nanoseconds on export
+inline uint64_t profile_ticks() {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    return (uint64_t)std::chrono::steady_clock::now()
+        .time_since_epoch()
+        .count();
+#endif
+}
+
+// Name the calling thread in exported traces, at most 15 characters are kept
+inline void profile_thread_name(const char* name) {
+    std::strncpy(tls_profile_thread_name, name,
+                 sizeof(tls_profile_thread_name) - 1);
+    if (tls_profile_buffer != nullptr) {
+        std::memcpy(tls_profile_buffer->name, tls_profile_thread_name,
+                    sizeof(tls_profile_thread_name));
+    }
+}
+
+inline ProfileBuffer* register_profile_buffer() {
+    std::scoped_lock lock(profiler_state.locker);
+    profiler_state.buffers.emplace_back(new ProfileBuffer);
+    ProfileBuffer* buffer = profiler_state.buffers.back().get();
+    buffer->tid = (uint32_t)profiler_state.buffers.size() - 1;
+    if (tls_profile_thread_name[0] != '\0') {
+        std::memcpy(buffer->name, tls_profile_thread_name,
+                    sizeof(tls_profile_thread_name));
+    } else {
+        std::snprintf(buffer->name, sizeof(buffer->name), "thread %u",
+                      buffer->tid);
+    }
+    tls_profile_buffer = buffer;
+    return buffer;
+}
+
+// Append an event to the buffer of the calling thread while recording
+inline void profile_event(ProfileEventType type, const char* label,
+                          uint32_t arg) {
+    ProfileSpans& spans = tls_profile_spans;
+    if (profile_is_begin(type)) {
+        if (spans.count < ProfileSpans::capacity) {
+            spans.begins[spans.count] = ProfileEvent{0, label, arg, type};
+        }
+        spans.count++;
+    } else if (type != PROFILE_STEAL && spans.count > 0) {
+        spans.count--;
+    }
+    if (!profiler_state.recording.load(std::memory_order_relaxed)) {
+        return;
+    }
+    ProfileBuffer* buffer = tls_profile_buffer;
+    if (buffer == nullptr) {
+        buffer = register_profile_buffer();
+    }
+    const uint64_t n = buffer->written.load(std::memory_order_relaxed);
+    buffer->events[n & (ProfileBuffer::capacity - 1)] =
+        ProfileEvent{profile_ticks(), label, arg, type};
+    buffer->written.store(n + 1, std::memory_order_release);
+}
+
+// Close the spans open on the calling thread and keep them in spans, before
+// a fiber in the middle of a job is switched out. Whatever runs next on the
+// thread starts from no open span
+inline void profile_suspend(ProfileSpans& spans) {
+    spans = tls_profile_spans;
+    for (uint32_t i = spans.count; i-- > 0;) {
+        profile_event(i < ProfileSpans::capacity
+                          ? ProfileEventType(spans.begins[i].type + 1)
+                          : PROFILE_SCOPE_END,
+                      nullptr, 0);
+    }
+}
+
+// Open the spans closed by profile_suspend() again, once the fiber runs
+inline void profile_resume(const ProfileSpans& spans) {
+    for (uint32_t i = 0; i < spans.count; ++i) {
+        if (i < ProfileSpans::capacity) {
+            profile_event(spans.begins[i].type, spans.begins[i].label,
+                          spans.begins[i].arg);
+        } else {
+            profile_event(PROFILE_SCOPE_BEGIN, nullptr, 0);
+        }
+    }
+}
+
+// Records a user span for the lifetime of the object
+struct ProfileScope {
+    explicit ProfileScope(const char* label) {
+        profile_event(PROFILE_SCOPE_BEGIN, label, 0);
+    }
+    ~ProfileScope() { profile_event(PROFILE_SCOPE_END, nullptr, 0); }
+    ProfileScope(const ProfileScope&) = delete;
+    ProfileScope& operator=(const ProfileScope&) = delete;
+};
+
+#define ARC_JOB_PROFILE(type, label, arg)                                      \
+    ::arc::core::JobManager::profile_event(type, label, arg)
+#define ARC_JOB_PROFILE_CONCAT_(a, b) a##b
+#define ARC_JOB_PROFILE_CONCAT(a, b) ARC_JOB_PROFILE_CONCAT_(a, b)
+#define ARC_JOB_PROFILE_SCOPE(label)                                           \
+    ::arc::core::JobManager::ProfileScope ARC_JOB_PROFILE_CONCAT(              \
+        arc_profile_scope_, __LINE__)(label)
+
+/* @brief Start a new recording, events of earlier recordings are dropped
+ *
+ * Threads should not be submitting jobs while a recording is started.
+ */
+inline void profiler_begin() {
+    std::scoped_lock lock(profiler_state.locker);
+    for (auto& buffer : profiler_state.buffers) {
+        buffer->written.store(0, std::memory_order_relaxed);
+    }
+    profiler_state.begin_time = std::chrono::steady_clock::now();
+    profiler_state.begin_ticks = profile_ticks();
+    profiler_state.recording.store(true);
+}
+
+/* @brief Stop recording, the events are kept until the next profiler_begin()
+ */
+inline void profiler_end() {
+    profiler_state.recording.store(false);
+    std::scoped_lock lock(profiler_state.locker);
+    profiler_state.end_ticks = profile_ticks();
+    profiler_state.end_time = std::chrono::steady_clock::now();
+}
+
+inline bool profiler_recording() {
+    return profiler_state.recording.load(std::memory_order_relaxed);
+}
+
+inline void write_json_string(std::ostream& out, const char* text) {
+    out << '"';
+    for (; *text != '\0'; ++text) {
+        if (*text == '"' || *text == '\\') {
+            out << '\\';
+        }
+        if ((unsigned char)*text >= 0x20) {
+            out << *text;
+        }
+    }
+    out << '"';
+}
+
+/* @brief Write the last recording as Chrome trace event JSON
+ *
+ * The output loads in chrome://tracing and ui.perfetto.dev. Job, wait_for,
+ * sleep and user spans become duration events, steals become instant events.
+ * Call after profiler_end().
+ */
+inline void write_chrome_trace(std::ostream& out) {
+    std::scoped_lock lock(profiler_state.locker);
+    const double elapsed_ns = std::chrono::duration<double, std::nano>(
+                                  profiler_state.end_time -
+                                  profiler_state.begin_time)
+                                  .count();
+    const uint64_t elapsed_ticks =
+        profiler_state.end_ticks - profiler_state.begin_ticks;
+    const double ns_per_tick =
+        elapsed_ticks > 0 ? elapsed_ns / (double)elapsed_ticks : 1.0;
+
+    const std::ios_base::fmtflags flags = out.flags();
+    const std::streamsize precision = out.precision(3);
+    out << std::fixed << "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[";
+    bool first = true;
+    auto next = [&]() -> std::ostream& {
+        out << (first ? "\n" : ",\n");
+        first = false;
+        return out;
+    };
+
+    for (auto& buffer : profiler_state.buffers) {
+        const uint64_t written = buffer->written.load(std::memory_order_acquire);
+        if (written == 0) {
+            continue;
+        }
+        next() << "{\"ph\":\"M\",\"pid\":0,\"tid\":" << buffer->tid
+               << ",\"name\":\"thread_name\",\"args\":{\"name\":";
+        write_json_string(out, buffer->name);
+        out << "}}";
+
+        // Ends whose begin was overwritten are skipped, so spans stay nested
+        uint32_t depth = 0;
+        const uint64_t oldest = written > ProfileBuffer::capacity
+                                    ? written - ProfileBuffer::capacity
+                                    : 0;
+        for (uint64_t i = oldest; i < written; ++i) {
+            const ProfileEvent& event =
+                buffer->events[i & (ProfileBuffer::capacity - 1)];
+            const char* phase = nullptr;
+            const char* name = event.label;
+            switch (event.type) {
+            case PROFILE_JOB_BEGIN:
+                phase = "B";
+                name = name != nullptr ? name : "job";
+                break;
+            case PROFILE_WAIT_BEGIN:
+                phase = "B";
+                name = "wait_for";
+                break;
+            case PROFILE_SLEEP:
+                phase = "B";
+                name = "sleep";
+                break;
+            case PROFILE_SCOPE_BEGIN:
+                phase = "B";
+                name = name != nullptr ? name : "scope";
+                break;
+            case PROFILE_STEAL:
+                phase = "i";
+                name = "steal";
+                break;
+            default:
+                phase = "E";
+                break;
+            }
+            if (phase[0] == 'B') {
+                depth++;
+            } else if (phase[0] == 'E') {
+                if (depth == 0) {
+                    continue;
+                }
+                depth--;
+            }
+
+            const double ts =
+                (double)(int64_t)(event.ticks - profiler_state.begin_ticks) *
+                ns_per_tick / 1000.0;
+            next() << "{\"ph\":\"" << phase << "\",\"pid\":0,\"tid\":"
+                   << buffer->tid << ",\"ts\":" << ts;
+            if (phase[0] != 'E') {
+                out << ",\"name\":";
+                write_json_string(out, name);
+            }
+            if (event.type == PROFILE_STEAL) {
+                out << ",\"s\":\"t\",\"args\":{\"victim\":" << event.arg << "}";
+            } else if (event.type == PROFILE_WAIT_BEGIN && event.label) {
+                out << ",\"args\":{\"context\":";
+                write_json_string(out, event.label);
+                out << "}";
+            }
+            out << "}";
+        }
+    }
+    out << "\n]}\n";
+    out.flags(flags);
+    out.precision(precision);
+}
+
+#else // ARC_JOB_PROFILER
+
+#define ARC_JOB_PROFILE(type, label, arg) ((void)0)
+#define ARC_JOB_PROFILE_SCOPE(label) ((void)0)
+
+inline void profile_thread_name(const char*) {}
+inline void profiler_begin() {}
+inline void profiler_end() {}
+inline bool profiler_recording() { return false; }
+inline void write_chrome_trace(std::ostream& out) {
+    out << "{\"traceEvents\":[]}\n";
+}
+
+#endif // ARC_JOB_PROFILER
+
+/* @brief Write the last recording to a Chrome trace JSON file
+ *
+ * @return false if the file could not be written
+ */
+inline bool save_chrome_trace(const std::string& path) {
+    std::ofstream file(path);
+    if (!file) {
+        return false;
+    }
+    write_chrome_trace(file);
+    return (bool)file;
+}
+
+} /*ns*/
+} /*ns*/
+} /*ns*/
@@ -0,0 +1,155 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+
+#include "JobManager.hpp"
+
+namespace arc {
+namespace core {
+
+/* @brief Work posted from any thread to run on the main thread.
+ *
+ * Jobs that need the main thread, such as uploading to the GPU or touching
+ * the window, post their last step here and the main loop runs it with
+ * drain() once per frame, see FramePipeline::set_main_thread_queue().
+ * Workers prepare the data in parallel and never have to wait for the main
+ * thread:
+ *
+ *     Context uploaded;
+ *     execute(loading, [&](JobArgs) {
+ *         decode(image);
+ *         main_queue.post(uploaded, [&](JobArgs) { upload(image); });
+ *     });
+ *
+ * A Context given to post() stays busy until the main thread ran the job, so
+ * it works with is_busy(), execute() dependencies and co_await like any other
+ * Context. The main thread itself must not wait_for() such a Context, as
+ * nobody else drains the queue.
+ *
+ * Posting is lock-free and the jobs come from the JobManager pools, so posting
+ * does not allocate once the pool of the posting thread is warm.
+ */
+class MainThreadQueue {
+public:
+    using Callback = void (*)(void*);
+
+    MainThreadQueue() = default;
+    MainThreadQueue(const MainThreadQueue&) = delete;
+    MainThreadQueue& operator=(const MainThreadQueue&) = delete;
+
+    // Jobs that never got to run are dropped, like on JobSystem::shutdown()
+    ~MainThreadQueue() {
+        take_posted();
+        while (m_pending != nullptr) {
+            JobManager::Job* job = m_pending;
+            m_pending = job->next;
+            JobManager::release_job(job);
+        }
+    }
+
+    /* @brief Queue task(JobArgs) to run on the main thread, ctx is busy until
+     * it did
+     */
+    template <typename F>
+    void post(JobManager::Context& ctx, F&& task) {
+        push(JobManager::make_job(ctx, std::forward<F>(task)));
+    }
+
+    /* @brief Queue fn(arg) to run on the main thread
+     */
+    void post(Callback fn, void* arg) {
+        post(m_untracked, [fn, arg](JobManager::JobArgs) { fn(arg); });
+    }
+
+    /* @brief Run every job posted before the call, on the calling thread
+     *
+     * Jobs posted while draining run on the next drain().
+     * @return number of jobs that were run
+     */
+    size_t drain() {
+        take_posted();
+        size_t count = 0;
+        while (m_pending != nullptr) {
+            run_next();
+            count++;
+        }
+        return count;
+    }
+
+    /* @brief Run posted jobs in order until budget is used up
+     *
+     * At least one job runs if any was posted, so the queue always makes
+     * progress. Jobs left over run first on the next drain().
+     * @return number of jobs that were run
+     */
+    size_t drain(std::chrono::nanoseconds budget) {
+        const auto deadline = std::chrono::steady_clock::now() + budget;
+        take_posted();
+        size_t count = 0;
+        while (m_pending != nullptr) {
+            run_next();
+            count++;
+            if (std::chrono::steady_clock::now() >= deadline)
+                break;
+        }
+        return count;
+    }
+
+    // Nothing is waiting to run, only exact on the draining thread
+    bool empty() const {
+        return m_pending == nullptr &&
+               m_posted.load(std::memory_order_acquire) == nullptr;
+    }
+
+private:
+    // Producers push onto a lock-free stack
+    void push(JobManager::Job* job) {
+        JobManager::Job* head = m_posted.load(std::memory_order_relaxed);
+        do {
+            job->next = head;
+        } while (!m_posted.compare_exchange_weak(head, job,
+                                                 std::memory_order_release,
+                                                 std::memory_order_relaxed));
+    }
+
+    // Take the whole stack in one swap and append it to the pending list in
+    // the order it was posted
+    void take_posted() {
+        JobManager::Job* job =
+            m_posted.exchange(nullptr, std::memory_order_acquire);
+        if (job == nullptr)
+            return;
+        JobManager::Job* first = nullptr;
+        JobManager::Job* last = job;
+        while (job != nullptr) {
+            JobManager::Job* next = job->next;
+            job->next = first;
+            first = job;
+            job = next;
+        }
+        if (m_pending_tail != nullptr)
+            m_pending_tail->next = first;
+        else
+            m_pending = first;
+        m_pending_tail = last;
+    }
+
+    void run_next() {
+        JobManager::Job* job = m_pending;
+        m_pending = job->next;
+        if (m_pending == nullptr)
+            m_pending_tail = nullptr;
+        JobManager::run_job(job);
+    }
+
+    std::atomic<JobManager::Job*> m_posted{nullptr}; // newest first
+    // Taken but not run yet, oldest first, only touched by the draining thread
+    JobManager::Job* m_pending = nullptr;
+    JobManager::Job* m_pending_tail = nullptr;
+    JobManager::Context m_untracked{}; // Context of plain callbacks
+};
+
+} /*ns*/
+} /*ns*/
@@ -0,0 +1,382 @@
+#pragma once
+
+#include <algorithm>
+#include <functional>
+#include <iterator>
+#include <new>
+#include <numeric>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "HeapArray.hpp"
+#include "JobManager.hpp"
+
+/* Parallel versions of the common STL loops, running on the JobManager pool.
+ *
+ * Every algorithm splits its range into chunks that are dispatched as one job
+ * each and then calls wait_for(), so the calling thread works on the chunks
+ * instead of blocking, and the algorithms can be used from inside jobs.
+ * Ranges are given as random access iterators or as a HeapArray.
+ *
+ *     parallel_for(positions.begin(), positions.end(),
+ *                  [&](vec3& p) { p += velocity * dt; });
+ *     float total = parallel_reduce(mass.data(), mass.data() + n, 0.0f,
+ *                                   std::plus<>{});
+ *     parallel_sort(keys);
+ *
+ * grain is the number of elements per job, 0 picks one that gives every
+ * thread a few chunks to balance over but never less than min_auto_grain
+ * elements. Pass a small grain when every element is expensive.
+ */
+
+namespace arc {
+namespace core {
+namespace JobManager {
+
+namespace detail {
+
+// Chunks per thread when the grain is picked automatically, a few per thread
+// lets fast threads take over from slow ones
+constexpr size_t chunks_per_thread = 4;
+// Smallest automatic chunk, below this the queue traffic costs more than the
+// loop itself
+constexpr size_t min_auto_grain = 512;
+// Ranges shorter than this are sorted on the calling thread
+constexpr size_t min_parallel_sort = 8192;
+
+inline size_t chunk_count(size_t count, size_t grain) {
+    if (count == 0) {
+        return 0;
+    }
+    if (grain == 0) {
+        const size_t threads = get_thread_count() + 1;
+        return std::max<size_t>(
+            1, std::min(threads * chunks_per_thread, count / min_auto_grain));
+    }
+    return (count + grain - 1) / grain;
+}
+
+// First element of chunk of count elements split into chunks, chunk sizes
+// differ by at most one
+inline size_t chunk_begin(size_t chunk, size_t count, size_t chunks) {
+    return chunk * count / chunks;
+}
+
+// Run body(job) for every job in [0, jobs) and wait for all of them
+//	The kernel only holds a pointer to body, so any body fits in a job
+template <typename F>
+void run_jobs(size_t jobs, F& body) {
+    if (jobs == 1) {
+        body(0);
+        return;
+    }
+    Context ctx;
+    F* fn = &body;
+    dispatch(ctx, (uint32_t)jobs, 1,
+             [fn](JobArgs args) { (*fn)(args.job_index); }, 0);
+    wait_for(ctx);
+}
+
+// Run body(begin, end, chunk) over chunks of [0, count)
+template <typename F>
+void run_chunks(size_t count, size_t chunks, F&& body) {
+    auto job = [&](size_t chunk) {
+        body(chunk_begin(chunk, count, chunks),
+             chunk_begin(chunk + 1, count, chunks), chunk);
+    };
+    if (chunks > 0) {
+        run_jobs(chunks, job);
+    }
+}
+
+// Uninitialized array on the scratch arena of the calling thread, every
+// element must be constructed before it goes out of scope
+//	The caller waits for the jobs that fill it, so anything a helped job
+// pushes on the same arena is popped first
+template <typename T>
+class ScratchArray {
+  public:
+    static_assert(alignof(T) <= ScratchArena::alignment);
+
+    explicit ScratchArray(size_t _count)
+        : m_count(_count), m_data(static_cast<T*>(
+                               local_scratch_arena().push(sizeof(T) * _count))) {}
+    ScratchArray(const ScratchArray&) = delete;
+    ScratchArray& operator=(const ScratchArray&) = delete;
+
+    ~ScratchArray() {
+        for (size_t i = 0; i < m_count; ++i) {
+            m_data[i].~T();
+        }
+        local_scratch_arena().pop();
+    }
+
+    template <typename... Args>
+    void construct(size_t i, Args&&... args) {
+        new (m_data + i) T(std::forward<Args>(args)...);
+    }
+
+    T& operator[](size_t i) { return m_data[i]; }
+
+  private:
+    size_t m_count;
+    T* m_data;
+};
+
+template <typename It>
+constexpr bool is_random_access_v = std::is_base_of_v<
+    std::random_access_iterator_tag,
+    typename std::iterator_traits<It>::iterator_category>;
+
+// Number of elements taken from a when the first k elements of the merge of
+// sorted ranges a and b are written, ties are taken from a first
+template <typename It, typename Compare>
+size_t merge_split(size_t k, It a, size_t a_count, It b, size_t b_count,
+                   Compare& comp) {
+    size_t lo = k > b_count ? k - b_count : 0;
+    size_t hi = std::min(k, a_count);
+    while (lo < hi) {
+        const size_t i = lo + (hi - lo) / 2;
+        const size_t j = k - i;
+        if (j > 0 && !comp(b[j - 1], a[i])) {
+            lo = i + 1; // a[i] comes before b[j - 1], so more of a is taken
+        } else {
+            hi = i;
+        }
+    }
+    return lo;
+}
+
+// Merge every pair of neighbouring sorted runs of width elements from src
+// into dst, each merge is split into segments that are merged in parallel
+template <typename Src, typename Dst, typename Compare>
+void merge_pass(Src src, Dst dst, size_t count, size_t width, Compare& comp) {
+    const size_t pairs = (count + 2 * width - 1) / (2 * width);
+    const size_t threads = get_thread_count() + 1;
+    const size_t segments = std::max<size_t>(
+        1, std::min(threads * chunks_per_thread / pairs,
+                    2 * width / min_auto_grain));
+    const size_t per_segment = (2 * width + segments - 1) / segments;
+
+    auto merge_segment = [&](size_t index) {
+        const size_t lo = index / segments * 2 * width;
+        const size_t mid = std::min(lo + width, count);
+        const size_t hi = std::min(lo + 2 * width, count);
+        const size_t k0 = std::min(index % segments * per_segment, hi - lo);
+        const size_t k1 = std::min(k0 + per_segment, hi - lo);
+        if (k0 == k1) {
+            return;
+        }
+        const size_t i0 =
+            merge_split(k0, src + lo, mid - lo, src + mid, hi - mid, comp);
+        const size_t i1 =
+            merge_split(k1, src + lo, mid - lo, src + mid, hi - mid, comp);
+        std::merge(std::make_move_iterator(src + lo + i0),
+                   std::make_move_iterator(src + lo + i1),
+                   std::make_move_iterator(src + mid + (k0 - i0)),
+                   std::make_move_iterator(src + mid + (k1 - i1)),
+                   dst + lo + k0, comp);
+    };
+    run_jobs(pairs * segments, merge_segment);
+}
+
+} /*ns*/
+
+/* @brief Call fn(element) for every element in [first, last)
+ */
+template <typename It, typename F>
+void parallel_for(It first, It last, F&& fn, size_t grain = 0) {
+    static_assert(detail::is_random_access_v<It>,
+                  "parallel_for needs random access iterators");
+    const size_t count = last - first;
+    detail::run_chunks(count, detail::chunk_count(count, grain),
+                       [&](size_t begin, size_t end, size_t) {
+                           for (It it = first + begin, stop = first + end;
+                                it != stop; ++it) {
+                               fn(*it);
+                           }
+                       });
+}
+
+/* @brief Call fn(index) for every index in [0, count)
+ */
+template <typename F>
+void parallel_for(size_t count, F&& fn, size_t grain = 0) {
+    detail::run_chunks(count, detail::chunk_count(count, grain),
+                       [&](size_t begin, size_t end, size_t) {
+                           for (size_t i = begin; i < end; ++i) {
+                               fn(i);
+                           }
+                       });
+}
+
+template <typename T, typename F>
+void parallel_for(HeapArray<T>& array, F&& fn, size_t grain = 0) {
+    parallel_for(array.data(), array.data() + array.size(),
+                 std::forward<F>(fn), grain);
+}
+
+/* @brief Fold [first, last) into init with op
+ *
+ * op must be associative, elements are combined in order so it does not need
+ * to be commutative
+ */
+template <typename It, typename T, typename Op = std::plus<>>
+T parallel_reduce(It first, It last, T init, Op op = {}, size_t grain = 0) {
+    static_assert(detail::is_random_access_v<It>,
+                  "parallel_reduce needs random access iterators");
+    const size_t count = last - first;
+    const size_t chunks = detail::chunk_count(count, grain);
+    if (chunks == 0) {
+        return init;
+    }
+
+    detail::ScratchArray<T> partials(chunks);
+    detail::run_chunks(count, chunks,
+                       [&](size_t begin, size_t end, size_t chunk) {
+                           It it = first + begin;
+                           T partial = *it;
+                           for (It stop = first + end; ++it != stop;) {
+                               partial = op(std::move(partial), *it);
+                           }
+                           partials.construct(chunk, std::move(partial));
+                       });
+    for (size_t chunk = 0; chunk < chunks; ++chunk) {
+        init = op(std::move(init), std::move(partials[chunk]));
+    }
+    return init;
+}
+
+template <typename T, typename U, typename Op = std::plus<>>
+U parallel_reduce(const HeapArray<T>& array, U init, Op op = {},
+                  size_t grain = 0) {
+    return parallel_reduce(array.data(), array.data() + array.size(),
+                           std::move(init), std::move(op), grain);
+}
+
+/* @brief Inclusive scan of [first, last) with op, written to out
+ *
+ * out may be first for an in-place scan. op must be associative. The input is
+ * read twice, once to reduce every chunk and once to write the scan
+ */
+template <typename It, typename Out, typename Op = std::plus<>>
+Out parallel_scan(It first, It last, Out out, Op op = {}, size_t grain = 0) {
+    static_assert(detail::is_random_access_v<It> &&
+                      detail::is_random_access_v<Out>,
+                  "parallel_scan needs random access iterators");
+    using T = typename std::iterator_traits<It>::value_type;
+    const size_t count = last - first;
+    const size_t chunks = detail::chunk_count(count, grain);
+    if (chunks == 0) {
+        return out;
+    }
+    if (chunks == 1) {
+        return std::inclusive_scan(first, last, out, op);
+    }
+
+    // Reduce every chunk, then turn the sums into the prefix of each chunk
+    detail::ScratchArray<T> prefix(chunks);
+    detail::run_chunks(count, chunks,
+                       [&](size_t begin, size_t end, size_t chunk) {
+                           It it = first + begin;
+                           T partial = *it;
+                           for (It stop = first + end; ++it != stop;) {
+                               partial = op(std::move(partial), *it);
+                           }
+                           prefix.construct(chunk, std::move(partial));
+                       });
+    T running = prefix[0];
+    for (size_t chunk = 1; chunk < chunks; ++chunk) {
+        T sum = std::move(prefix[chunk]);
+        prefix[chunk] = running;
+        running = op(std::move(running), std::move(sum));
+    }
+
+    detail::run_chunks(count, chunks,
+                       [&](size_t begin, size_t end, size_t chunk) {
+                           It it = first + begin;
+                           Out o = out + begin;
+                           T acc = chunk == 0 ? T(*it) : op(prefix[chunk], *it);
+                           *o = acc;
+                           for (It stop = first + end; ++it != stop;) {
+                               acc = op(std::move(acc), *it);
+                               *++o = acc;
+                           }
+                       });
+    return out + count;
+}
+
+template <typename T, typename Op = std::plus<>>
+void parallel_scan(HeapArray<T>& array, Op op = {}, size_t grain = 0) {
+    parallel_scan(array.data(), array.data() + array.size(), array.data(),
+                  std::move(op), grain);
+}
+
+/* @brief Sort [first, last) with comp
+ *
+ * Chunks are sorted with std::sort in parallel and then merged pairwise, every
+ * merge is split along the merge path so all threads take part in the last
+ * ones too. The sort is not stable, and needs a temporary buffer of the same
+ * size as the range, so value_type must be default constructible
+ */
+template <typename It, typename Compare = std::less<>>
+void parallel_sort(It first, It last, Compare comp = {}) {
+    static_assert(detail::is_random_access_v<It>,
+                  "parallel_sort needs random access iterators");
+    using T = typename std::iterator_traits<It>::value_type;
+    const size_t count = last - first;
+    const size_t threads = get_thread_count() + 1;
+    if (count < detail::min_parallel_sort || threads == 1) {
+        std::sort(first, last, comp);
+        return;
+    }
+
+    const size_t runs = std::min(2 * threads, count / detail::min_auto_grain);
+    const size_t width = (count + runs - 1) / runs;
+    auto sort_run = [&](size_t run) {
+        const size_t begin = std::min(run * width, count);
+        const size_t end = std::min(begin + width, count);
+        std::sort(first + begin, first + end, comp);
+    };
+    detail::run_jobs(runs, sort_run);
+
+    std::vector<T> buffer(count);
+    bool in_buffer = false;
+    for (size_t w = width; w < count; w *= 2) {
+        if (in_buffer) {
+            detail::merge_pass(buffer.begin(), first, count, w, comp);
+        } else {
+            detail::merge_pass(first, buffer.begin(), count, w, comp);
+        }
+        in_buffer = !in_buffer;
+    }
+    if (in_buffer) {
+        detail::run_chunks(count, detail::chunk_count(count, 0),
+                           [&](size_t begin, size_t end, size_t) {
+                               std::move(buffer.begin() + begin,
+                                         buffer.begin() + end, first + begin);
+                           });
+    }
+}
+
+template <typename T, typename Compare = std::less<>>
+void parallel_sort(HeapArray<T>& array, Compare comp = {}) {
+    parallel_sort(array.data(), array.data() + array.size(), std::move(comp));
+}
+
+/* @brief Run every function in parallel and return when all have finished
+ *
+ * The first function runs on the calling thread, the rest are queued as jobs
+ */
+template <typename F, typename... Fs>
+void parallel_invoke(F&& fn, Fs&&... fns) {
+    Context ctx;
+    (execute(ctx, [&fns](JobArgs) { fns(); }), ...);
+    fn();
+    wait_for(ctx);
+}
+
+} /*ns*/
+} /*ns*/
+} /*ns*/
@@ -1,13 +1,21 @@
 #pragma once
 
+#include <atomic>
+#include <cstddef>
 #include <memory>
 #include <mutex>
 
 namespace arc {
 namespace core {
 
+// Policies of RingBuffer
+//  RingBufferLocked: any number of threads on either end, behind a mutex
+//  RingBufferSPSC: one producer thread and one consumer thread, lock free
+struct RingBufferLocked {};
+struct RingBufferSPSC {};
+
 // Fixed size very simple thread safe ring buffer
-template <typename T, size_t capacity>
+template <typename T, size_t capacity, typename Policy = RingBufferLocked>
 class RingBuffer
 {
 public:
@@ -53,5 +61,72 @@ private:
     std::mutex lock;
 };
 
+// Lock free ring buffer for exactly one producer and one consumer thread,
+// such as audio, log or input streams
+//  Only the producer may call push_back() and only the consumer pop_front().
+//  Holds capacity items, which must be a power of two.
+//  head and tail count up forever and are masked into the array. Each side
+//  keeps a copy of the index of the other side and only reloads it when the
+//  copy says the buffer is full or empty, so the cache line of the other
+//  side is only touched once per lap rather than on every call.
+template <typename T, size_t capacity>
+class RingBuffer<T, capacity, RingBufferSPSC>
+{
+    static_assert(capacity > 0 && (capacity & (capacity - 1)) == 0,
+                  "capacity of a RingBufferSPSC must be a power of two");
+
+public:
+    // Push an item to the end if there is free space, producer only
+    //  Returns true if succesful
+    //  Returns false if there is not enough space
+    inline bool push_back(const T& item)
+    {
+        const size_t next = head.load(std::memory_order_relaxed);
+        if (next - tail_cache == capacity)
+        {
+            // Pairs with the release in pop_front(), the slot was read
+            tail_cache = tail.load(std::memory_order_acquire);
+            if (next - tail_cache == capacity)
+            {
+                return false;
+            }
+        }
+        data[next & mask] = item;
+        head.store(next + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Get an item if there are any, consumer only
+    //  Returns true if succesful
+    //  Returns false if there are no items
+    inline bool pop_front(T& item)
+    {
+        const size_t next = tail.load(std::memory_order_relaxed);
+        if (next == head_cache)
+        {
+            // Pairs with the release in push_back(), the slot was written
+            head_cache = head.load(std::memory_order_acquire);
+            if (next == head_cache)
+            {
+                return false;
+            }
+        }
+        item = data[next & mask];
+        tail.store(next + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    static constexpr size_t mask = capacity - 1;
+
+    // Written by the producer, with its copy of tail
+    alignas(64) std::atomic<size_t> head{0};
+    size_t tail_cache = 0;
+    // Written by the consumer, with its copy of head
+    alignas(64) std::atomic<size_t> tail{0};
+    size_t head_cache = 0;
+    alignas(64) T data[capacity];
+};
+
 } /*ns*/
 } /*ns*/
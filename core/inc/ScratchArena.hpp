@@ -0,0 +1,158 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <new>
+#include <vector>
+
+// Canary bytes written after every scratch allocation and checked when it is
+// popped, on by default in debug builds
+#ifndef ARC_SCRATCH_GUARD
+#ifdef NDEBUG
+#define ARC_SCRATCH_GUARD 0
+#else
+#define ARC_SCRATCH_GUARD 1
+#endif
+#endif
+
+namespace arc {
+namespace core {
+
+/* @brief ScratchArena is an aligned linear allocator used as a stack.
+ *
+ * Every push() returns memory aligned to ScratchArena::alignment, and must be
+ * matched by a pop() in reverse order. Memory is carved out of blocks that are
+ * kept between uses, so once the arena has grown to its peak usage pushing and
+ * popping does not touch the heap. Earlier allocations never move when the
+ * arena grows, which keeps nested pushes safe.
+ */
+class ScratchArena {
+  public:
+    static constexpr size_t alignment = 64;
+    static constexpr uint8_t guard_pattern = 0xFD;
+
+    explicit ScratchArena(size_t _initial_capacity = 64 * 1024)
+        : m_initial_capacity(_initial_capacity > alignment ? _initial_capacity
+                                                           : alignment) {}
+
+    ScratchArena(const ScratchArena&) = delete;
+    ScratchArena& operator=(const ScratchArena&) = delete;
+
+    ~ScratchArena() {
+        for (Block& block : m_blocks)
+            ::operator delete(block.data, std::align_val_t(alignment));
+    }
+
+    /* @brief Allocate size bytes on top of the arena
+     *
+     * @param _size: bytes guaranteed to be usable
+     * @param _zeroed: clear the memory before returning it
+     *
+     * @return pointer aligned to ScratchArena::alignment
+     */
+    void* push(size_t _size, bool _zeroed = false) {
+        const size_t need = header_size + round_up(_size + guard_size);
+        if (m_blocks.empty() ||
+            m_offset + need > m_blocks[m_block].capacity)
+            next_block(need);
+
+        uint8_t* base = m_blocks[m_block].data + m_offset;
+        Header* header = reinterpret_cast<Header*>(base);
+        header->previous = m_top;
+        header->block = m_block;
+        header->offset = m_offset;
+        header->size = _size;
+        m_top = header;
+        m_offset += need;
+
+        uint8_t* memory = base + header_size;
+        if (_zeroed)
+            std::memset(memory, 0, _size);
+        if (guard_size > 0)
+            std::memset(memory + _size, guard_pattern, guard_size);
+        return memory;
+    }
+
+    /* @brief Release the most recent push()
+     *
+     * @return false if the guard after the allocation was overwritten
+     */
+    bool pop() {
+        Header* header = m_top;
+        bool intact = true;
+        if (guard_size > 0) {
+            const uint8_t* guard =
+                reinterpret_cast<uint8_t*>(header) + header_size + header->size;
+            for (size_t i = 0; i < guard_size; i++)
+                intact &= guard[i] == guard_pattern;
+        }
+        m_top = header->previous;
+        m_block = header->block;
+        m_offset = header->offset;
+        return intact;
+    }
+
+    /* @brief Bytes reserved by the arena across all blocks
+     */
+    size_t capacity() const {
+        size_t total = 0;
+        for (const Block& block : m_blocks)
+            total += block.capacity;
+        return total;
+    }
+
+  private:
+    struct Header {
+        Header* previous;
+        uint32_t block;
+        size_t offset;
+        size_t size;
+    };
+    static_assert(sizeof(Header) <= alignment);
+
+    struct Block {
+        uint8_t* data;
+        size_t capacity;
+    };
+
+    static constexpr size_t header_size = alignment;
+    static constexpr size_t guard_size = ARC_SCRATCH_GUARD ? alignment : 0;
+
+    static constexpr size_t round_up(size_t _size) {
+        return (_size + alignment - 1) & ~(alignment - 1);
+    }
+
+    // Move to the block after the current one, blocks past the top are unused
+    // so one that is too small can be replaced
+    void next_block(size_t _need) {
+        uint32_t next = m_blocks.empty() ? 0 : m_block + 1;
+        size_t capacity = m_blocks.empty() ? m_initial_capacity
+                                           : m_blocks.back().capacity * 2;
+        while (capacity < _need)
+            capacity *= 2;
+
+        if (next < m_blocks.size() && m_blocks[next].capacity < _need) {
+            ::operator delete(m_blocks[next].data, std::align_val_t(alignment));
+            m_blocks[next] = allocate_block(capacity);
+        } else if (next == m_blocks.size()) {
+            m_blocks.push_back(allocate_block(capacity));
+        }
+        m_block = next;
+        m_offset = 0;
+    }
+
+    static Block allocate_block(size_t _capacity) {
+        return Block{static_cast<uint8_t*>(::operator new(
+                         _capacity, std::align_val_t(alignment))),
+                     _capacity};
+    }
+
+    size_t m_initial_capacity;
+    std::vector<Block> m_blocks;
+    uint32_t m_block = 0;
+    size_t m_offset = 0;
+    Header* m_top = nullptr;
+};
+
+} /*ns*/
+} /*ns*/
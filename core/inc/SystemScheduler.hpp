@@ -0,0 +1,247 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "JobManager.hpp"
+#include "TaskGraph.hpp"
+
+namespace arc {
+namespace core {
+
+// Identifies a component type in a ComponentAccess, one address per type
+using ComponentId = const void*;
+
+template <typename T>
+ComponentId component_id() {
+    static const char tag = 0;
+    return &tag;
+}
+
+/* @brief Component types a system reads and writes
+ *
+ *     ComponentAccess().read<Velocity>().write<Position>()
+ *
+ * Two systems conflict when one of them writes a type the other reads or
+ * writes. A system that did not declare anything is exclusive and conflicts
+ * with every other one.
+ */
+struct ComponentAccess {
+    std::vector<ComponentId> reads;
+    std::vector<ComponentId> writes;
+
+    template <typename... T>
+    ComponentAccess& read() {
+        (reads.push_back(component_id<T>()), ...);
+        return *this;
+    }
+
+    template <typename... T>
+    ComponentAccess& write() {
+        (writes.push_back(component_id<T>()), ...);
+        return *this;
+    }
+
+    bool exclusive() const { return reads.empty() && writes.empty(); }
+
+    bool touches(ComponentId id) const {
+        return contains(reads, id) || contains(writes, id);
+    }
+
+    // Running both at the same time could race
+    bool conflicts(const ComponentAccess& other) const {
+        if (exclusive() || other.exclusive()) {
+            return true;
+        }
+        for (ComponentId id : writes) {
+            if (other.touches(id)) {
+                return true;
+            }
+        }
+        for (ComponentId id : other.writes) {
+            if (contains(reads, id)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+  private:
+    static bool contains(const std::vector<ComponentId>& ids, ComponentId id) {
+        for (ComponentId other : ids) {
+            if (other == id) {
+                return true;
+            }
+        }
+        return false;
+    }
+};
+
+// Wall time one system took, see SystemScheduler::timings()
+struct SystemTiming {
+    std::string name;
+    double last_ms = 0.0;    // of the latest run
+    double average_ms = 0.0; // since the last reset_timings()
+    uint64_t runs = 0;
+};
+
+/* @brief Runs ECS systems on the job pool, systems that do not conflict at
+ * the same time.
+ *
+ * Every system declares the components it reads and writes. From that the
+ * scheduler builds a graph in which a system waits for each earlier system
+ * it conflicts with, so the result is the same as running them one after
+ * another in the order they were added:
+ *
+ *     SystemScheduler<GameScene> systems;
+ *     systems.add("integrate", ComponentAccess().read<Velocity>().write<Position>(),
+ *                 [](GameScene& scene) { ... });
+ *     systems.add("regenerate", ComponentAccess().write<Health>(),
+ *                 [](GameScene& scene) { ... });
+ *     systems.run(scene); // both at once, they touch different components
+ *
+ * A system that loops over many entities can split its loop further with
+ * parallel_for(), the thread running it helps with the chunks. The graph is
+ * built on the first run after a system was added, later runs only queue
+ * jobs. Systems must not be added while a run is in flight.
+ */
+template <typename World>
+class SystemScheduler {
+  public:
+    using System = std::function<void(World&)>;
+
+    explicit SystemScheduler(
+        JobManager::JobSystem& _system = JobManager::default_job_system())
+        : m_system(&_system) {}
+
+    SystemScheduler(const SystemScheduler&) = delete;
+    SystemScheduler& operator=(const SystemScheduler&) = delete;
+
+    // Add a system that runs after every earlier one it conflicts with
+    //	Returns its index
+    size_t add(std::string name, ComponentAccess access, System fn) {
+        m_entries.emplace_back(new Entry);
+        Entry& entry = *m_entries.back();
+        entry.name = std::move(name);
+        entry.access = std::move(access);
+        entry.fn = std::move(fn);
+        m_graph.reset();
+        return m_entries.size() - 1;
+    }
+
+    /* @brief Start every system on world, ctx is busy until all finished
+     */
+    void run(World& world, JobManager::Context& ctx) {
+        if (m_graph == nullptr) {
+            build();
+        }
+        m_world = &world;
+        m_graph->run(*m_system, ctx);
+    }
+
+    // Run every system on world and wait for them, helping meanwhile
+    void run(World& world) {
+        JobManager::Context ctx;
+        run(world, ctx);
+        m_system->wait_for(ctx);
+    }
+
+    size_t size() const { return m_entries.size(); }
+
+    // Earlier systems the system at index waits for, without the ones it
+    // already waits for through others. Valid once it ran
+    const std::vector<size_t>& dependencies(size_t index) const {
+        return m_entries[index]->dependencies;
+    }
+
+    // Read once a run drained
+    std::vector<SystemTiming> timings() const {
+        std::vector<SystemTiming> out;
+        out.reserve(m_entries.size());
+        for (const auto& entry : m_entries) {
+            SystemTiming timing;
+            timing.name = entry->name;
+            timing.last_ms = entry->last_ns * 1e-6;
+            timing.runs = entry->runs;
+            timing.average_ms =
+                entry->runs > 0 ? entry->total_ns * 1e-6 / entry->runs : 0.0;
+            out.push_back(timing);
+        }
+        return out;
+    }
+
+    void reset_timings() {
+        for (auto& entry : m_entries) {
+            entry->last_ns = 0.0;
+            entry->total_ns = 0.0;
+            entry->runs = 0;
+        }
+    }
+
+  private:
+    struct Entry {
+        std::string name;
+        ComponentAccess access;
+        System fn;
+        std::vector<size_t> dependencies;
+        // Only written by the job running the system
+        double last_ns = 0.0;
+        double total_ns = 0.0;
+        uint64_t runs = 0;
+    };
+
+    // A system waits for the latest earlier system it conflicts with, and
+    // for older ones only if they are not already behind that one
+    void build() {
+        const size_t count = m_entries.size();
+        // ancestors[i][j]: system i runs after system j
+        std::vector<std::vector<bool>> ancestors(count,
+                                                 std::vector<bool>(count));
+        m_graph.reset(new JobManager::TaskGraph);
+        std::vector<JobManager::TaskGraph::Node*> nodes;
+        for (size_t i = 0; i < count; ++i) {
+            Entry* entry = m_entries[i].get();
+            entry->dependencies.clear();
+            for (size_t j = i; j-- > 0;) {
+                if (ancestors[i][j] ||
+                    !entry->access.conflicts(m_entries[j]->access)) {
+                    continue;
+                }
+                entry->dependencies.push_back(j);
+                ancestors[i][j] = true;
+                for (size_t k = 0; k < j; ++k) {
+                    if (ancestors[j][k]) {
+                        ancestors[i][k] = true;
+                    }
+                }
+            }
+            nodes.push_back(&m_graph->add(
+                [this, entry](JobManager::JobArgs) { run_entry(*entry); }));
+            for (size_t j : entry->dependencies) {
+                nodes[j]->precede(*nodes[i]);
+            }
+        }
+    }
+
+    void run_entry(Entry& entry) {
+        const auto start = std::chrono::steady_clock::now();
+        entry.fn(*m_world);
+        const std::chrono::duration<double, std::nano> elapsed =
+            std::chrono::steady_clock::now() - start;
+        entry.last_ns = elapsed.count();
+        entry.total_ns += elapsed.count();
+        entry.runs++;
+    }
+
+    JobManager::JobSystem* m_system;
+    std::vector<std::unique_ptr<Entry>> m_entries; // stable for the graph
+    std::unique_ptr<JobManager::TaskGraph> m_graph; // null until built
+    World* m_world = nullptr;
+};
+
+} /*ns*/
+} /*ns*/
@@ -0,0 +1,200 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+
+#include "JobManager.hpp"
+
+namespace arc {
+namespace core {
+namespace JobManager {
+
+/* @brief TaskGraph is a reusable set of jobs and dispatches with dependencies.
+ *
+ * The graph is built once and can then be run every frame. A run only resets
+ * counters and queues jobs from the job pools, nothing is rebuilt or copied.
+ * A node is queued by whichever thread finishes its last predecessor, so the
+ * caller never blocks between stages.
+ *
+ *     TaskGraph graph;
+ *     auto& physics = graph.add_dispatch(count, 64, physics_kernel);
+ *     auto& animate = graph.add_dispatch(count, 64, animation_kernel);
+ *     auto& render = graph.add(build_draw_lists);
+ *     physics.precede(render);
+ *     animate.precede(render);
+ *
+ *     Context frame;
+ *     graph.run(frame);
+ *     ...
+ *     wait_for(frame);
+ *
+ * Kernels are shared by every group and every run, so they must be safe to
+ * call concurrently. A graph must not be run again, or destroyed, before the
+ * Context of the previous run has drained.
+ */
+class TaskGraph {
+  public:
+    class Node : private ContextWaiter {
+        friend class TaskGraph;
+
+      public:
+        // This node has to finish before other is started
+        Node& precede(Node& other) {
+            successors.push_back(&other);
+            other.predecessor_count++;
+            return *this;
+        }
+
+        // Other has to finish before this node is started
+        Node& succeed(Node& other) {
+            other.precede(*this);
+            return *this;
+        }
+
+        // ctx has to drain before this node is started, checked on every run
+        Node& after(Context& ctx) {
+            external.push_back(&ctx);
+            return *this;
+        }
+
+      private:
+        InlineFunction<void(const Job&), ARC_JOB_FUNCTION_SIZE> group_task;
+        uint32_t job_count = 1;
+        uint32_t group_size = 1;
+        uint32_t sharedmemory_size = 0;
+        SharedMemoryInit sharedmemory_init = SHAREDMEMORY_UNINITIALIZED;
+
+        std::vector<Node*> successors;
+        std::vector<Context*> external;
+        uint32_t predecessor_count = 0;
+
+        std::atomic<uint32_t> pending{0};
+        uint32_t external_next = 0;
+        Context groups; // groups of this node in flight
+        TaskGraph* graph = nullptr;
+    };
+
+    TaskGraph() = default;
+    TaskGraph(const TaskGraph&) = delete;
+    TaskGraph& operator=(const TaskGraph&) = delete;
+
+    // Add a single job, see execute()
+    template <typename F>
+    Node& add(F&& task) {
+        return add_dispatch(1, 1, std::forward<F>(task));
+    }
+
+    // Add a dispatch of jobCount jobs in groups of groupSize, see dispatch()
+    template <typename F>
+    Node& add_dispatch(
+        uint32_t jobCount, uint32_t groupSize, F&& task,
+        size_t sharedmemory_size = 0,
+        SharedMemoryInit sharedmemory_init = SHAREDMEMORY_UNINITIALIZED) {
+        m_nodes.emplace_back(new Node);
+        Node& node = *m_nodes.back();
+        node.graph = this;
+        node.job_count = jobCount;
+        node.group_size = std::max(1u, groupSize);
+        node.sharedmemory_size = (uint32_t)sharedmemory_size;
+        node.sharedmemory_init = sharedmemory_init;
+        node.group_task.emplace(
+            [task = std::forward<F>(task)](const Job& job) mutable {
+                run_group(task, job);
+            });
+        return node;
+    }
+
+    // Start every node, ctx stays busy until all of them have finished
+    //	Jobs of the graph are queued at the priority of ctx
+    void run(Context& ctx) { run(default_job_system(), ctx); }
+
+    // Start every node on the workers of system
+    void run(JobSystem& system, Context& ctx) {
+        m_system = &system;
+        m_context = &ctx;
+        ctx.counter.fetch_add((uint32_t)m_nodes.size());
+
+        // All counters are reset before anything is started, as a node may
+        // finish and release its successors before this loop is done
+        for (auto& node : m_nodes) {
+            node->pending.store(node->predecessor_count + 1);
+            node->external_next = 0;
+            node->groups.priority = ctx.priority;
+        }
+        for (auto& node : m_nodes) {
+            resolve_external(*node);
+        }
+    }
+
+    size_t size() const { return m_nodes.size(); }
+
+  private:
+    // Wait for each external Context in turn, then drop the extra pending
+    // count that run() added for them
+    static void resolve_external(Node& node) {
+        while (node.external_next < node.external.size()) {
+            Context* ctx = node.external[node.external_next++];
+            node.notify = [](ContextWaiter* waiter) {
+                resolve_external(static_cast<Node&>(*waiter));
+            };
+            if (add_waiter(*ctx, &node)) {
+                return;
+            }
+        }
+        release(node);
+    }
+
+    static void release(Node& node) {
+        if (node.pending.fetch_sub(1) == 1) {
+            launch(node);
+        }
+    }
+
+    static void launch(Node& node) {
+        const uint32_t groupCount =
+            dispatch_group_count(node.job_count, node.group_size);
+        if (groupCount == 0) {
+            finish(node);
+            return;
+        }
+
+        node.groups.counter.fetch_add(groupCount);
+        node.notify = [](ContextWaiter* waiter) {
+            finish(static_cast<Node&>(*waiter));
+        };
+        add_waiter(node.groups, &node);
+
+        for (uint32_t groupID = 0; groupID < groupCount; ++groupID) {
+            Job* job = allocate_job();
+            job->context = &node.groups;
+            job->task.emplace(
+                [owner = &node](const Job& job) { owner->group_task(job); });
+            job->sharedmemory_size = node.sharedmemory_size;
+            job->sharedmemory_init = node.sharedmemory_init;
+            job->grain = nullptr;
+            job->group_ID = groupID;
+            job->group_job_offset = groupID * node.group_size;
+            job->group_job_end = std::min(
+                job->group_job_offset + node.group_size, node.job_count);
+            job->dependency_count = 0;
+
+            node.graph->m_system->submit(job);
+        }
+        node.graph->m_system->wake_workers(groupCount, node.groups.priority);
+    }
+
+    static void finish(Node& node) {
+        for (Node* successor : node.successors) {
+            release(*successor);
+        }
+        complete(*node.graph->m_context);
+    }
+
+    std::vector<std::unique_ptr<Node>> m_nodes;
+    JobSystem* m_system = nullptr;
+    Context* m_context = nullptr;
+};
+
+} /*ns*/
+} /*ns*/
+} /*ns*/
@@ -0,0 +1,290 @@
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <vector>
+
+namespace arc {
+namespace core {
+
+/* @brief Hierarchical timer wheel, holds payloads until a tick is reached.
+ *
+ * Timers are kept in slots of five wheels: 256 slots of one tick, then four
+ * wheels of 64 slots, each slot spanning a whole turn of the wheel below.
+ * Inserting and cancelling link or unlink a node, and a tick only looks at
+ * one slot, so both cost the same with a million timers pending as with one.
+ * A timer in an outer wheel is moved one wheel inwards each time the wheel
+ * below completes a turn, at most four moves over its lifetime.
+ *
+ * Ticks are absolute and abstract, such as milliseconds or frames. Deadlines
+ * further out than 2^32 ticks are parked in the outermost wheel until they
+ * come into range. Not thread safe, callers lock around it.
+ */
+template <typename T>
+class TimerWheel {
+    struct Node {
+        Node* prev;
+        Node* next;
+        uint64_t expires = 0;
+        uint32_t generation = 0;
+        bool linked = false;
+        T payload{};
+    };
+
+  public:
+    // Refers to one insert, stays safe to cancel after the timer fired
+    struct Handle {
+        Node* node = nullptr;
+        uint32_t generation = 0;
+    };
+
+    static constexpr uint32_t inner_bits = 8;
+    static constexpr uint32_t outer_bits = 6;
+    static constexpr uint32_t outer_count = 4;
+
+    explicit TimerWheel(uint64_t _now = 0) : m_now(_now) {
+        for (Node& slot : m_slots) {
+            slot.prev = slot.next = &slot;
+        }
+    }
+
+    TimerWheel(const TimerWheel&) = delete;
+    TimerWheel& operator=(const TimerWheel&) = delete;
+
+    /* @brief Hold payload until tick expires is processed by advance()
+     *
+     * Ticks that have passed already are due on the next advance().
+     */
+    Handle insert(uint64_t _expires, T _payload) {
+        Node* node = allocate();
+        node->expires = _expires < m_now ? m_now : _expires;
+        node->payload = std::move(_payload);
+        link(node);
+        m_size++;
+        return Handle{node, node->generation};
+    }
+
+    /* @brief Remove a pending timer
+     *
+     * @return true and its payload in _payload, or false if the timer fired or
+     * was cancelled already
+     */
+    bool cancel(Handle _handle, T* _payload = nullptr) {
+        Node* node = _handle.node;
+        if (node == nullptr || node->generation != _handle.generation ||
+            !node->linked) {
+            return false;
+        }
+        unlink(node);
+        if (_payload != nullptr) {
+            *_payload = std::move(node->payload);
+        }
+        release(node);
+        m_size--;
+        return true;
+    }
+
+    /* @brief Process every tick before _to, calling on_due(T&&) for each timer
+     * that expires on them, in tick order
+     *
+     * Runs of empty ticks are skipped a whole slot word at a time.
+     */
+    template <typename F>
+    void advance(uint64_t _to, F&& _on_due) {
+        while (m_now < _to) {
+            if (m_size == 0) {
+                m_now = _to;
+                return;
+            }
+            const uint32_t index = (uint32_t)(m_now & inner_mask);
+            if (index == 0) {
+                cascade();
+            }
+            // Nothing in this slot, jump to the next one that holds timers,
+            // or to the end of the turn where the outer wheels cascade
+            if (!test_bit(index)) {
+                const uint32_t next = next_bit(index);
+                m_now = std::min<uint64_t>(_to, m_now + (next - index));
+                continue;
+            }
+            Node& slot = m_slots[index];
+            while (slot.next != &slot) {
+                Node* node = slot.next;
+                unlink(node);
+                T payload = std::move(node->payload);
+                release(node);
+                m_size--;
+                _on_due(std::move(payload));
+            }
+            m_now++;
+        }
+    }
+
+    /* @brief Remove every timer, calling fn(T&&) for each
+     */
+    template <typename F>
+    void clear(F&& _fn) {
+        for (Node& slot : m_slots) {
+            while (slot.next != &slot) {
+                Node* node = slot.next;
+                unlink(node);
+                T payload = std::move(node->payload);
+                release(node);
+                _fn(std::move(payload));
+            }
+        }
+        m_size = 0;
+    }
+
+    /* @brief A tick no later than the next one with a timer due, for sleeping
+     * until then
+     *
+     * Exact within the current turn of the inner wheel, otherwise the end of
+     * the turn, when the outer wheels cascade.
+     */
+    uint64_t next_due_hint() const {
+        if (m_size == 0) {
+            return ~0ull;
+        }
+        const uint32_t index = (uint32_t)(m_now & inner_mask);
+        if (index == 0 || test_bit(index)) {
+            return m_now;
+        }
+        return m_now + (next_bit(index) - index);
+    }
+
+    // Next tick advance() processes
+    uint64_t now() const { return m_now; }
+    size_t size() const { return m_size; }
+    bool empty() const { return m_size == 0; }
+
+  private:
+    static constexpr uint32_t inner_slots = 1u << inner_bits;
+    static constexpr uint32_t outer_slots = 1u << outer_bits;
+    static constexpr uint64_t inner_mask = inner_slots - 1;
+    static constexpr uint64_t outer_mask = outer_slots - 1;
+    static constexpr uint32_t slot_count =
+        inner_slots + outer_count * outer_slots;
+    static constexpr uint64_t max_delta =
+        (1ull << (inner_bits + outer_count * outer_bits)) - 1;
+    static constexpr uint32_t block_size = 1024;
+
+    // Slot of a node from how far away it expires
+    Node& slot_of(uint64_t _expires) {
+        const uint64_t delta = std::min(_expires - m_now, max_delta);
+        if (delta < inner_slots) {
+            return m_slots[_expires & inner_mask];
+        }
+        const uint64_t expires = m_now + delta;
+        for (uint32_t level = 0; level < outer_count; ++level) {
+            const uint32_t shift = inner_bits + (level + 1) * outer_bits;
+            if (level + 1 == outer_count || delta < (1ull << shift)) {
+                const uint32_t slot = (uint32_t)(
+                    (expires >> (shift - outer_bits)) & outer_mask);
+                return m_slots[inner_slots + level * outer_slots + slot];
+            }
+        }
+        return m_slots[0]; // not reached
+    }
+
+    void link(Node* _node) {
+        Node& slot = slot_of(_node->expires);
+        _node->prev = slot.prev;
+        _node->next = &slot;
+        slot.prev->next = _node;
+        slot.prev = _node;
+        _node->linked = true;
+        const size_t index = &slot - m_slots;
+        if (index < inner_slots) {
+            m_occupied[index / 64] |= 1ull << (index % 64);
+        }
+    }
+
+    void unlink(Node* _node) {
+        _node->prev->next = _node->next;
+        _node->next->prev = _node->prev;
+        _node->linked = false;
+        // The inner slot of a node is its expiry, so its bit can be cleared
+        // once the slot ran empty
+        if (_node->expires - m_now < inner_slots) {
+            const uint32_t index = (uint32_t)(_node->expires & inner_mask);
+            Node& slot = m_slots[index];
+            if (slot.next == &slot) {
+                m_occupied[index / 64] &= ~(1ull << (index % 64));
+            }
+        }
+    }
+
+    // Move the timers of the outer slots that the inner wheel reached at the
+    // start of a turn one wheel inwards
+    void cascade() {
+        for (uint32_t level = 0; level < outer_count; ++level) {
+            const uint32_t shift = inner_bits + level * outer_bits;
+            const uint32_t index = (uint32_t)((m_now >> shift) & outer_mask);
+            Node& slot = m_slots[inner_slots + level * outer_slots + index];
+            Node* node = slot.next;
+            slot.prev = slot.next = &slot;
+            while (node != &slot) {
+                Node* next = node->next;
+                link(node);
+                node = next;
+            }
+            if (index != 0) {
+                break; // the wheels further out only turn when this one wraps
+            }
+        }
+    }
+
+    bool test_bit(uint32_t _index) const {
+        return (m_occupied[_index / 64] >> (_index % 64)) & 1;
+    }
+
+    // First occupied inner slot after _index, or inner_slots if there is none
+    // before the end of the turn
+    uint32_t next_bit(uint32_t _index) const {
+        uint32_t word = (_index + 1) / 64;
+        if (_index + 1 >= inner_slots) {
+            return inner_slots;
+        }
+        uint64_t bits = m_occupied[word] & (~0ull << ((_index + 1) % 64));
+        while (bits == 0) {
+            if (++word == inner_slots / 64) {
+                return inner_slots;
+            }
+            bits = m_occupied[word];
+        }
+        return word * 64 + (uint32_t)__builtin_ctzll(bits);
+    }
+
+    Node* allocate() {
+        if (m_free == nullptr) {
+            m_blocks.emplace_back(new Node[block_size]);
+            Node* block = m_blocks.back().get();
+            for (uint32_t i = 0; i < block_size; ++i) {
+                block[i].next = i + 1 < block_size ? &block[i + 1] : nullptr;
+            }
+            m_free = block;
+        }
+        Node* node = m_free;
+        m_free = node->next;
+        return node;
+    }
+
+    void release(Node* _node) {
+        _node->generation++;
+        _node->payload = T{};
+        _node->next = m_free;
+        m_free = _node;
+    }
+
+    uint64_t m_now;
+    size_t m_size = 0;
+    Node m_slots[slot_count];
+    uint64_t m_occupied[inner_slots / 64] = {}; // inner slots holding timers
+    Node* m_free = nullptr;
+    std::vector<std::unique_ptr<Node[]>> m_blocks;
+};
+
+} /*ns*/
+} /*ns*/
@@ -0,0 +1,146 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <type_traits>
+#include <vector>
+
+namespace arc {
+namespace core {
+
+// Lock-free single owner, multiple thief work-stealing deque (Chase-Lev).
+//  The owning thread pushes and pops at the bottom (LIFO), any other thread
+//  may steal from the top (FIFO).
+//  Memory orderings follow:
+//  "Correct and Efficient Work-Stealing for Weak Memory Models"
+//  https://fzn.fr/readings/ppopp13.pdf
+//
+//  Items are copied in and out of the ring with relaxed atomics, so T must be
+//  small and trivially copyable, usually a pointer.
+template <typename T>
+class WorkStealingQueue
+{
+    static_assert(std::is_trivially_copyable_v<T>,
+                  "WorkStealingQueue items must be trivially copyable");
+
+public:
+    explicit WorkStealingQueue(int64_t capacity = 1024)
+    {
+        int64_t cap = 1;
+        while (cap < capacity)
+            cap <<= 1;
+        m_buffers.emplace_back(new Buffer(cap));
+        m_buffer.store(m_buffers.back().get(), std::memory_order_relaxed);
+    }
+
+    WorkStealingQueue(const WorkStealingQueue&) = delete;
+    WorkStealingQueue& operator=(const WorkStealingQueue&) = delete;
+
+    // Push an item to the bottom, only the owner may call this
+    //  The ring grows when full, so a push always succeeds
+    inline void push(T item)
+    {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        int64_t t = m_top.load(std::memory_order_acquire);
+        Buffer* buf = m_buffer.load(std::memory_order_relaxed);
+        if (b - t > buf->capacity - 1)
+            buf = grow(buf, b, t);
+        buf->put(b, item);
+        std::atomic_thread_fence(std::memory_order_release);
+        m_bottom.store(b + 1, std::memory_order_relaxed);
+    }
+
+    // Pop the most recently pushed item, only the owner may call this
+    //  Returns true if succesful
+    //  Returns false if the queue is empty, or a thief won the last item
+    inline bool pop(T& item)
+    {
+        int64_t b = m_bottom.load(std::memory_order_relaxed) - 1;
+        Buffer* buf = m_buffer.load(std::memory_order_relaxed);
+        m_bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+
+        if (t > b) {
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return false;
+        }
+        item = buf->get(b);
+        if (t == b) {
+            // Last item, race against thieves for it
+            bool won = m_top.compare_exchange_strong(
+                t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+            m_bottom.store(b + 1, std::memory_order_relaxed);
+            return won;
+        }
+        return true;
+    }
+
+    // Steal the oldest item, any thread may call this
+    //  Returns true if succesful
+    //  Returns false if the queue is empty or another thread got there first
+    inline bool steal(T& item)
+    {
+        int64_t t = m_top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        int64_t b = m_bottom.load(std::memory_order_acquire);
+        if (t >= b)
+            return false;
+
+        Buffer* buf = m_buffer.load(std::memory_order_acquire);
+        item = buf->get(t);
+        return m_top.compare_exchange_strong(
+            t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    // Approximate amount of queued items, exact only for the owner
+    inline size_t size() const
+    {
+        int64_t b = m_bottom.load(std::memory_order_relaxed);
+        int64_t t = m_top.load(std::memory_order_relaxed);
+        return b > t ? (size_t)(b - t) : 0;
+    }
+
+    inline bool empty() const { return size() == 0; }
+
+private:
+    struct Buffer {
+        int64_t capacity;
+        int64_t mask;
+        std::unique_ptr<std::atomic<T>[]> slots;
+
+        explicit Buffer(int64_t _capacity)
+            : capacity(_capacity), mask(_capacity - 1),
+              slots(new std::atomic<T>[_capacity]) {}
+
+        inline void put(int64_t i, T item)
+        {
+            slots[i & mask].store(item, std::memory_order_relaxed);
+        }
+        inline T get(int64_t i) const
+        {
+            return slots[i & mask].load(std::memory_order_relaxed);
+        }
+    };
+
+    // Old buffers are kept alive until destruction, as a thief may still be
+    // reading from them
+    Buffer* grow(Buffer* old, int64_t b, int64_t t)
+    {
+        m_buffers.emplace_back(new Buffer(old->capacity * 2));
+        Buffer* buf = m_buffers.back().get();
+        for (int64_t i = t; i < b; ++i)
+            buf->put(i, old->get(i));
+        m_buffer.store(buf, std::memory_order_release);
+        return buf;
+    }
+
+    alignas(64) std::atomic<int64_t> m_top{0};
+    alignas(64) std::atomic<int64_t> m_bottom{0};
+    alignas(64) std::atomic<Buffer*> m_buffer{nullptr};
+    std::vector<std::unique_ptr<Buffer>> m_buffers;
+};
+
+} /*ns*/
+} /*ns*/
@@ -63,4 +63,20 @@ std::string App::scene_name(SceneKey _scene) {
     return m_scene_manager.name(_scene);
 }
 
+core::MainThreadQueue& App::main_thread_queue(void) {
+    return m_main_thread_queue;
+}
+
+void App::main_thread_budget_set(std::chrono::microseconds _budget) {
+    m_main_thread_budget = _budget;
+}
+
+/*Runs jobs posted to the main thread until the budget is used up, the rest
+ * waits for the next call. App has no frame loop of its own yet, whoever runs
+ * the frames on the main thread must call this once per frame, or hand the
+ * queue to FramePipeline::set_main_thread_queue()*/
+size_t App::drain_main_thread(void) {
+    return m_main_thread_queue.drain(m_main_thread_budget);
+}
+
 }; /*namespace arc*/
@@ -0,0 +1,254 @@
+#include <atomic>
+#include <iostream>
+#include <stdexcept>
+#include <thread>
+
+#include "../testlib.h"
+
+//#include <ArcCore/JobCoroutine.hpp>
+#include "../../../core/inc/JobCoroutine.hpp"
+
+namespace jm = arc::core::JobManager;
+
+static_assert(ARC_JOB_COROUTINES, "the test is built as C++20");
+
+static void
+poll_until_idle(const jm::Context& ctx, arc::core::MainThreadQueue* queue = nullptr)
+{
+    while (jm::is_busy(ctx)) {
+        if (queue)
+            queue->drain();
+        std::this_thread::yield();
+    }
+}
+
+jm::Task<void>
+sum_in_jobs(std::atomic<uint32_t>& sum, uint32_t count)
+{
+    jm::Context ctx;
+    jm::dispatch(ctx, count, 8, [&sum](jm::JobArgs args) {
+        sum.fetch_add(args.job_index);
+    }, 0);
+    co_await ctx;
+}
+
+void
+test_await_context(void)
+{
+    std::atomic<uint32_t> sum{0};
+    jm::Context root;
+    jm::launch(root, sum_in_jobs(sum, 100));
+    jm::wait_for(root);
+    TL_TEST(sum.load() == 99 * 100 / 2);
+}
+
+jm::Task<void>
+wait_on_gate(jm::Context& gate, std::atomic<uint32_t>& resumed)
+{
+    co_await gate;
+    resumed++;
+}
+
+void
+test_suspension_frees_workers(void)
+{
+    /*more suspended tasks than workers, a blocking wait would starve the
+      probe job below*/
+    const uint32_t tasks = 4 * (jm::get_thread_count() + 1);
+    jm::Context gate;
+    gate.counter.store(1);
+    std::atomic<uint32_t> resumed{0};
+    jm::Context root;
+    for (uint32_t i = 0; i < tasks; i++)
+        jm::launch(root, wait_on_gate(gate, resumed));
+
+    std::atomic<bool> probed{false};
+    jm::Context probe;
+    jm::execute(probe, [&](jm::JobArgs) { probed = true; });
+    poll_until_idle(probe);
+    TL_TEST(probed.load());
+    TL_TEST(resumed.load() == 0);
+    TL_TEST(jm::is_busy(root));
+
+    jm::complete(gate);
+    poll_until_idle(root);
+    TL_TEST(resumed.load() == tasks);
+}
+
+jm::Task<int>
+child_value(int value)
+{
+    co_return value * 2;
+}
+
+jm::Task<int>
+child_throws(void)
+{
+    throw std::runtime_error("child failed");
+    co_return 0;
+}
+
+jm::Task<void>
+nested_tasks(int& result, bool& caught)
+{
+    int total = 0;
+    for (int i = 0; i < 1000; i++)
+        total += co_await child_value(1);
+    result = total;
+    try {
+        co_await child_throws();
+    } catch (const std::runtime_error&) {
+        caught = true;
+    }
+}
+
+void
+test_nested_tasks(void)
+{
+    int result = 0;
+    bool caught = false;
+    jm::Context root;
+    jm::launch(root, nested_tasks(result, caught));
+    jm::wait_for(root);
+    TL_TEST(result == 2000);
+    TL_TEST(caught);
+}
+
+struct Placement {
+    jm::JobSystem* first = nullptr;
+    jm::JobSystem* after_io = nullptr;
+    jm::JobSystem* after_child = nullptr;
+    std::thread::id on_main;
+    jm::JobSystem* after_main_wait = nullptr;
+    std::thread::id after_main_wait_thread;
+};
+
+jm::Task<void>
+switch_to(jm::JobSystem& system)
+{
+    co_await jm::schedule_on(system);
+}
+
+jm::Task<void>
+hop_between_systems(Placement& placement, jm::JobSystem& io,
+                    arc::core::MainThreadQueue& queue)
+{
+    placement.first = jm::JobSystem::current();
+    co_await jm::schedule_on(io);
+    placement.after_io = jm::JobSystem::current();
+
+    /*a child that switches back leaves the parent on the default system*/
+    co_await switch_to(jm::default_job_system());
+    placement.after_child = jm::JobSystem::current();
+
+    co_await jm::resume_on(queue);
+    placement.on_main = std::this_thread::get_id();
+
+    /*awaiting on the main thread resumes there*/
+    jm::Context ctx;
+    jm::execute(ctx, [](jm::JobArgs) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    });
+    co_await ctx;
+    placement.after_main_wait_thread = std::this_thread::get_id();
+
+    co_await jm::schedule_on(io);
+    placement.after_main_wait = jm::JobSystem::current();
+}
+
+void
+test_schedule_on(void)
+{
+    jm::JobSystemConfig config;
+    config.name = "arc::io::";
+    config.thread_count = 2;
+    config.oversubscribe = true;
+    jm::JobSystem io(config);
+    arc::core::MainThreadQueue queue;
+
+    Placement placement;
+    jm::Context root;
+    jm::launch(root, hop_between_systems(placement, io, queue));
+    poll_until_idle(root, &queue);
+
+    const std::thread::id main = std::this_thread::get_id();
+    TL_TEST(placement.first == &jm::default_job_system());
+    TL_TEST(placement.after_io == &io);
+    TL_TEST(placement.after_child == &jm::default_job_system());
+    TL_TEST(placement.on_main == main);
+    TL_TEST(placement.after_main_wait_thread == main);
+    TL_TEST(placement.after_main_wait == &io);
+    TL_TEST(queue.empty());
+}
+
+void
+test_main_thread_queue(void)
+{
+    arc::core::MainThreadQueue queue;
+    std::atomic<uint32_t> ran{0};
+    auto count = [](void* arg) { static_cast<std::atomic<uint32_t>*>(arg)->fetch_add(1); };
+
+    jm::Context ctx;
+    jm::dispatch(ctx, 100, 1, [&](jm::JobArgs) { queue.post(count, &ran); }, 0);
+    jm::wait_for(ctx);
+    TL_TEST(ran.load() == 0);
+    TL_TEST(queue.drain() == 100);
+    TL_TEST(ran.load() == 100);
+    TL_TEST(queue.drain() == 0);
+}
+
+jm::Task<void>
+stop_when_cancelled(jm::Context& gate, std::atomic<uint32_t>& stage)
+{
+    stage = 1;
+    co_await gate;
+    const bool stop = co_await jm::cancelled();
+    if (stop)
+        co_return;
+    stage = 2;
+}
+
+void
+test_cancelled_launch(void)
+{
+    /*resumes of a task run even once its Context is cancelled, otherwise
+      the task never returns and wait_for hangs on the count launch() holds*/
+    jm::CancelToken token;
+    jm::Context root;
+    root.cancel_token = &token;
+    jm::Context gate;
+    gate.counter.store(1);
+    std::atomic<uint32_t> stage{0};
+    jm::launch(root, stop_when_cancelled(gate, stage));
+    while (stage.load() < 1)
+        std::this_thread::yield();
+    token.cancel();
+    jm::complete(gate);
+    jm::wait_for(root);
+    TL_TEST(stage.load() == 1);
+
+    /*cancelled before it ever started*/
+    jm::Context early;
+    early.cancel_token = &token;
+    jm::launch(early, stop_when_cancelled(gate, stage));
+    jm::wait_for(early);
+    TL_TEST(!jm::is_busy(early));
+}
+
+int
+main(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+    jm::initialize(8);
+
+    TL(test_await_context());
+    TL(test_suspension_frees_workers());
+    TL(test_nested_tasks());
+    TL(test_schedule_on());
+    TL(test_main_thread_queue());
+    TL(test_cancelled_launch());
+
+    jm::shutdown();
+    tl_summary();
+}
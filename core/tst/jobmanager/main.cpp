@@ -0,0 +1,1816 @@
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <random>
+#include <sstream>
+
+#include "../testlib.h"
+
+/*the profiler is tested here, so its hooks are compiled in*/
+#define ARC_JOB_PROFILER 1
+
+//#include <ArcCore/JobManager.hpp>
+#include "../../../core/inc/FramePipeline.hpp"
+#include "../../../core/inc/JobManager.hpp"
+#include "../../../core/inc/MainThreadQueue.hpp"
+#include "../../../core/inc/ParallelAlgorithms.hpp"
+#include "../../../core/inc/SystemScheduler.hpp"
+#include "../../../core/inc/TaskGraph.hpp"
+
+namespace jm = arc::core::JobManager;
+
+/*count every heap allocation made by the test process*/
+static std::atomic<size_t> allocation_count{0};
+
+void* operator new(size_t size) {
+    allocation_count.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size ? size : 1))
+        return p;
+    throw std::bad_alloc();
+}
+void operator delete(void* p) noexcept { std::free(p); }
+void operator delete(void* p, size_t) noexcept { std::free(p); }
+
+void
+test_workstealingqueue_owner(void)
+{
+    arc::core::WorkStealingQueue<int> queue(4);
+    int item = 0;
+
+    TL_TEST(queue.empty());
+    TL_TEST(queue.pop(item) == false);
+    TL_TEST(queue.steal(item) == false);
+
+    /*push past the initial capacity to force growth*/
+    for (int i = 0; i < 10; i++)
+        queue.push(i);
+    TL_TEST(queue.size() == 10);
+
+    /*owner pops LIFO, thieves steal FIFO*/
+    TL_TEST(queue.pop(item) && item == 9);
+    TL_TEST(queue.steal(item) && item == 0);
+    TL_TEST(queue.steal(item) && item == 1);
+    TL_TEST(queue.pop(item) && item == 8);
+    TL_TEST(queue.size() == 6);
+}
+
+void
+test_workstealingqueue_concurrent_steal(void)
+{
+    const int count = 100000;
+    const int thieves = 3;
+    arc::core::WorkStealingQueue<int> queue;
+    std::vector<std::atomic<int>> seen(count);
+    std::atomic<bool> done{false};
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < thieves; t++) {
+        threads.emplace_back([&] {
+            int item;
+            while (!done.load() || !queue.empty()) {
+                if (queue.steal(item))
+                    seen[item].fetch_add(1);
+            }
+        });
+    }
+
+    int item;
+    for (int i = 0; i < count; i++) {
+        queue.push(i);
+        if (i % 3 == 0 && queue.pop(item))
+            seen[item].fetch_add(1);
+    }
+    while (queue.pop(item))
+        seen[item].fetch_add(1);
+    done.store(true);
+    for (auto& thread : threads)
+        thread.join();
+
+    bool exactly_once = true;
+    for (int i = 0; i < count; i++)
+        exactly_once &= seen[i].load() == 1;
+    TL_TEST(exactly_once);
+}
+
+void
+test_inlinefunction(void)
+{
+    int destroyed = 0;
+    struct Tracker {
+        int* destroyed;
+        std::unique_ptr<int> value;
+        Tracker(int* _d, int _v) : destroyed(_d), value(new int(_v)) {}
+        Tracker(Tracker&&) = default;
+        ~Tracker() { if (value) (*destroyed)++; }
+    };
+
+    arc::core::InlineFunction<int(int), 32> fn;
+    TL_TEST(!fn);
+
+    /*move-only captures are supported*/
+    fn.emplace([t = Tracker(&destroyed, 40)](int x) {
+        return *t.value + x;
+    });
+    TL_TEST(fn && fn(2) == 42);
+
+    arc::core::InlineFunction<int(int), 32> moved(std::move(fn));
+    TL_TEST(!fn);
+    TL_TEST(moved(1) == 41);
+    TL_TEST(destroyed == 0);
+
+    moved.reset();
+    TL_TEST(!moved);
+    TL_TEST(destroyed == 1);
+}
+
+void
+test_dispatch_zero_allocations(void)
+{
+    const uint32_t groups = 1024;
+    std::vector<uint32_t> data(groups * 4, 0);
+    auto kernel = [&data](jm::JobArgs args) { data[args.job_index]++; };
+
+    /*first dispatch warms up the job pools and queues*/
+    jm::Context ctx;
+    jm::dispatch(ctx, groups * 4, 4, kernel, 0);
+    jm::wait_for(ctx);
+
+    size_t before = allocation_count.load();
+    jm::dispatch(ctx, groups * 4, 4, kernel, 0);
+    jm::wait_for(ctx);
+    size_t allocations = allocation_count.load() - before;
+
+    std::cout << "allocations during dispatch: " << allocations << std::endl;
+    TL_TEST(allocations == 0);
+    TL_TEST(std::all_of(data.begin(), data.end(),
+                        [](uint32_t v) { return v == 2; }));
+}
+
+void
+test_execute(void)
+{
+    jm::Context ctx;
+    std::atomic<int> sum{0};
+    for (int i = 1; i <= 100; i++)
+        jm::execute(ctx, [&sum, i](jm::JobArgs) { sum.fetch_add(i); });
+    jm::wait_for(ctx);
+    TL_TEST(jm::is_busy(ctx) == false);
+    TL_TEST(sum.load() == 5050);
+}
+
+void
+test_dispatch(void)
+{
+    const uint32_t count = 10000;
+    std::vector<uint32_t> data(count, 0);
+    std::atomic<uint32_t> groups{0};
+    jm::Context ctx;
+    jm::dispatch(ctx, count, 64, [&](jm::JobArgs args) {
+        data[args.job_index] = args.job_index;
+        if (args.is_first_job_in_group)
+            groups.fetch_add(1);
+    }, 0);
+    jm::wait_for(ctx);
+
+    std::vector<uint32_t> expected(count);
+    std::iota(expected.begin(), expected.end(), 0);
+    TL_TEST(data == expected);
+    TL_TEST(groups.load() == jm::dispatch_group_count(count, 64));
+}
+
+void
+test_nested_dispatch(void)
+{
+    const uint32_t outer = 16;
+    const uint32_t inner = 256;
+    std::atomic<uint32_t> total{0};
+    jm::Context ctx;
+    jm::dispatch(ctx, outer, 1, [&](jm::JobArgs) {
+        /*waiting from inside a job helps instead of blocking the worker*/
+        jm::Context child;
+        jm::dispatch(child, inner, 16, [&](jm::JobArgs) {
+            total.fetch_add(1);
+        }, 0);
+        jm::wait_for(child);
+    }, 0);
+    jm::wait_for(ctx);
+    TL_TEST(total.load() == outer * inner);
+}
+
+void
+test_foreign_thread_submit(void)
+{
+    jm::Context ctx;
+    std::atomic<int> ran{0};
+    std::thread foreign([&] {
+        for (int i = 0; i < 100; i++)
+            jm::execute(ctx, [&](jm::JobArgs) { ran.fetch_add(1); });
+    });
+    foreign.join();
+    jm::wait_for(ctx);
+    TL_TEST(ran.load() == 100);
+}
+
+void
+test_execute_dependencies(void)
+{
+    std::atomic<int> stage{0};
+    std::atomic<bool> ordered{true};
+    jm::Context first, second, last;
+
+    jm::dispatch(first, 64, 4, [&](jm::JobArgs) {
+        if (stage.load() != 0)
+            ordered.store(false);
+    }, 0);
+    jm::execute(second, {&first}, [&](jm::JobArgs) {
+        stage.store(1);
+    });
+    jm::dispatch(last, {&first, &second}, 64, 4, [&](jm::JobArgs) {
+        if (stage.load() != 1)
+            ordered.store(false);
+    }, 0);
+
+    /*only the final stage is waited on*/
+    jm::wait_for(last);
+    TL_TEST(jm::is_busy(first) == false);
+    TL_TEST(jm::is_busy(second) == false);
+    TL_TEST(ordered.load());
+
+    /*dependencies that already drained do not hold the job back*/
+    std::atomic<int> ran{0};
+    jm::execute(last, {&first, &second}, [&](jm::JobArgs) { ran++; });
+    jm::wait_for(last);
+    TL_TEST(ran.load() == 1);
+}
+
+void
+test_taskgraph_replay(void)
+{
+    const uint32_t count = 4096;
+    std::vector<uint32_t> a(count), b(count), c(count);
+    std::atomic<uint64_t> sum{0};
+    uint32_t frame = 0;
+
+    /*diamond: produce -> (double, square) -> reduce*/
+    jm::TaskGraph graph;
+    auto& produce = graph.add_dispatch(count, 256, [&](jm::JobArgs args) {
+        a[args.job_index] = args.job_index + frame;
+    });
+    auto& twice = graph.add_dispatch(count, 256, [&](jm::JobArgs args) {
+        b[args.job_index] = a[args.job_index] * 2;
+    });
+    auto& square = graph.add_dispatch(count, 256, [&](jm::JobArgs args) {
+        c[args.job_index] = a[args.job_index] * a[args.job_index];
+    });
+    auto& reduce = graph.add([&](jm::JobArgs) {
+        uint64_t total = 0;
+        for (uint32_t i = 0; i < count; i++)
+            total += b[i] + c[i];
+        sum.store(total);
+    });
+    produce.precede(twice).precede(square);
+    reduce.succeed(twice).succeed(square);
+    TL_TEST(graph.size() == 4);
+
+    bool correct = true;
+    size_t allocations = 0;
+    for (frame = 0; frame < 50; frame++) {
+        size_t before = allocation_count.load();
+        jm::Context ctx;
+        graph.run(ctx);
+        jm::wait_for(ctx);
+        if (frame > 0)
+            allocations += allocation_count.load() - before;
+
+        uint64_t expected = 0;
+        for (uint64_t i = 0; i < count; i++)
+            expected += (i + frame) * 2 + (i + frame) * (i + frame);
+        correct &= sum.load() == expected;
+    }
+    TL_TEST(correct);
+    std::cout << "allocations during replays: " << allocations << std::endl;
+    TL_TEST(allocations == 0);
+}
+
+void
+test_taskgraph_external_context(void)
+{
+    std::atomic<int> loaded{0};
+    std::atomic<bool> ordered{true};
+    jm::Context loading;
+    jm::dispatch(loading, 32, 1, [&](jm::JobArgs) { loaded++; }, 0);
+
+    jm::TaskGraph graph;
+    graph.add([&](jm::JobArgs) {
+        if (loaded.load() != 32)
+            ordered.store(false);
+    }).after(loading);
+
+    jm::Context ctx;
+    graph.run(ctx);
+    jm::wait_for(ctx);
+    TL_TEST(ordered.load());
+}
+
+void
+test_scratcharena(void)
+{
+    arc::core::ScratchArena arena(256);
+
+    uint8_t* a = (uint8_t*)arena.push(100, true);
+    TL_TEST(TL_IS_MEMALIGNED(a, arc::core::ScratchArena::alignment));
+    TL_TEST(std::all_of(a, a + 100, [](uint8_t v) { return v == 0; }));
+    std::memset(a, 0xAB, 100);
+
+    /*nested push larger than the first block must not move a*/
+    uint8_t* b = (uint8_t*)arena.push(4096);
+    TL_TEST(TL_IS_MEMALIGNED(b, arc::core::ScratchArena::alignment));
+    std::memset(b, 0xCD, 4096);
+    TL_TEST(arena.pop());
+    TL_TEST(std::all_of(a, a + 100, [](uint8_t v) { return v == 0xAB; }));
+    TL_TEST(arena.pop());
+
+    /*reuse after warm-up does not grow the arena*/
+    size_t capacity = arena.capacity();
+    arena.push(100);
+    arena.push(4096);
+    arena.pop();
+    arena.pop();
+    TL_TEST(arena.capacity() == capacity);
+
+#if ARC_SCRATCH_GUARD
+    /*writing one byte too far trips the guard*/
+    uint8_t* c = (uint8_t*)arena.push(10);
+    c[10] = 0;
+    TL_TEST(arena.pop() == false);
+#endif
+}
+
+void
+test_dispatch_sharedmemory(void)
+{
+    const uint32_t count = 64 * 100;
+    const uint32_t group = 64;
+    std::vector<uint32_t> sums(count / group, 0);
+    std::atomic<bool> valid{true};
+
+    jm::Context ctx;
+    for (int pass = 0; pass < 2; pass++) {
+        /*each group reduces into zeroed shared memory, like groupshared*/
+        jm::dispatch(ctx, count, group, [&](jm::JobArgs args) {
+            uint32_t* shared = (uint32_t*)args.sharedmemory;
+            if (args.is_first_job_in_group &&
+                (!TL_IS_MEMALIGNED(shared, jm::sharedmemory_alignment) ||
+                 args.sharedmemory_size != group * sizeof(uint32_t) ||
+                 shared[0] != 0 || shared[group - 1] != 0))
+                valid.store(false);
+            shared[args.group_index] = args.job_index;
+            if (args.is_last_job_in_group) {
+                uint32_t total = 0;
+                for (uint32_t i = 0; i < group; i++)
+                    total += shared[i];
+                sums[args.group_ID] = total;
+            }
+        }, group * sizeof(uint32_t), jm::SHAREDMEMORY_ZEROED);
+        jm::wait_for(ctx);
+    }
+
+    bool correct = true;
+    for (uint32_t g = 0; g < count / group; g++) {
+        uint32_t first = g * group;
+        correct &= sums[g] == group * first + group * (group - 1) / 2;
+    }
+    TL_TEST(valid.load());
+    TL_TEST(correct);
+}
+
+void
+test_priority_order(void)
+{
+    const uint32_t workers = jm::get_thread_count();
+    std::atomic<uint32_t> blocked{0};
+    std::atomic<bool> gate{false};
+    jm::Context blockers;
+
+    /*hold every worker so the queues fill up before anything is taken*/
+    for (uint32_t i = 0; i < workers; i++)
+        jm::execute(blockers, [&](jm::JobArgs) {
+            blocked.fetch_add(1);
+            while (!gate.load())
+                std::this_thread::yield();
+        });
+    while (blocked.load() < workers)
+        std::this_thread::yield();
+
+    std::atomic<uint32_t> sequence{0};
+    std::atomic<uint32_t> critical_at{~0u};
+    jm::Context background(jm::PRIORITY_BACKGROUND);
+    jm::Context critical(jm::PRIORITY_CRITICAL);
+    for (int i = 0; i < 100; i++)
+        jm::execute(background, [&](jm::JobArgs) { sequence.fetch_add(1); });
+    jm::execute(critical, [&](jm::JobArgs) {
+        critical_at.store(sequence.fetch_add(1));
+    });
+    gate.store(true);
+
+    /*the critical job was queued last, but is taken before background ones*/
+    while (critical_at.load() == ~0u)
+        std::this_thread::yield();
+    TL_TEST(critical_at.load() < workers);
+    jm::wait_for(background);
+    jm::wait_for(blockers);
+    TL_TEST(sequence.load() == 101);
+}
+
+/*worst wait_for() of a frame Context while long background jobs occupy the
+ * pool, in milliseconds*/
+static double
+frame_latency_under_background(uint32_t background_threads,
+                               bool& background_on_main)
+{
+    const auto background_job = std::chrono::milliseconds(10);
+    const std::thread::id main_thread = std::this_thread::get_id();
+    jm::initialize(8, background_threads);
+    std::atomic<bool> in_frames{true};
+
+    jm::Context background(jm::PRIORITY_BACKGROUND);
+    for (int i = 0; i < 64; i++)
+        jm::execute(background, [&](jm::JobArgs) {
+            if (in_frames.load() && std::this_thread::get_id() == main_thread)
+                background_on_main = true;
+            std::this_thread::sleep_for(background_job);
+        });
+
+    double worst = 0.0;
+    std::atomic<uint32_t> sum{0};
+    for (int frame = 0; frame < 20; frame++) {
+        jm::Context ctx(jm::PRIORITY_CRITICAL);
+        auto start = std::chrono::steady_clock::now();
+        jm::dispatch(ctx, 256, 16, [&](jm::JobArgs args) {
+            sum.fetch_add(args.job_index, std::memory_order_relaxed);
+        }, 0);
+        jm::wait_for(ctx);
+        std::chrono::duration<double, std::milli> took =
+            std::chrono::steady_clock::now() - start;
+        worst = std::max(worst, took.count());
+    }
+
+    in_frames.store(false);
+    jm::wait_for(background);
+    jm::shutdown();
+    return worst;
+}
+
+void
+test_frame_latency_under_background(void)
+{
+    for (uint32_t background_threads : {0u, 2u}) {
+        bool background_on_main = false;
+        double worst = frame_latency_under_background(background_threads,
+                                                      background_on_main);
+        std::cout << "    frame latency with " << background_threads
+                  << " background workers: worst " << worst << " ms\n";
+        /*a frame never waits for a 10 ms background job to finish*/
+        TL_TEST(worst < 10.0);
+        TL_TEST(!background_on_main);
+    }
+    jm::initialize(8);
+}
+
+void
+test_parallel_for_reduce(void)
+{
+    std::vector<uint32_t> data(100000);
+    jm::parallel_for(data.size(), [&](size_t i) { data[i] = (uint32_t)i; });
+    jm::parallel_for(data.begin(), data.end(), [](uint32_t& v) { v *= 2; });
+    TL_TEST(data[0] == 0 && data[99999] == 2 * 99999);
+
+    uint64_t sum = jm::parallel_reduce(data.begin(), data.end(), uint64_t{0});
+    TL_TEST(sum == std::accumulate(data.begin(), data.end(), uint64_t{0}));
+
+    /*the combine order is kept, so a non-commutative op works too*/
+    std::vector<std::string> words(2000);
+    for (size_t i = 0; i < words.size(); i++)
+        words[i] = std::to_string(i % 10);
+    std::string joined = jm::parallel_reduce(words.begin(), words.end(),
+                                             std::string(">"), std::plus<>{}, 7);
+    TL_TEST(joined ==
+            std::accumulate(words.begin(), words.end(), std::string(">")));
+
+    arc::core::HeapArray<float> array(5000);
+    jm::parallel_for(array, [](float& v) { v = 0.5f; });
+    TL_TEST(jm::parallel_reduce(array, 0.0f) == 2500.0f);
+
+    TL_TEST(jm::parallel_reduce(data.begin(), data.begin(), 7u) == 7u);
+}
+
+void
+test_parallel_scan(void)
+{
+    std::vector<uint32_t> data(77777);
+    std::iota(data.begin(), data.end(), 1u);
+    std::vector<uint32_t> expected(data.size());
+    std::inclusive_scan(data.begin(), data.end(), expected.begin());
+
+    std::vector<uint32_t> out(data.size());
+    auto end = jm::parallel_scan(data.begin(), data.end(), out.begin());
+    TL_TEST(end == out.end());
+    TL_TEST(out == expected);
+
+    /*in place, with small chunks so the prefixes chain through many jobs*/
+    jm::parallel_scan(data.begin(), data.end(), data.begin(), std::plus<>{}, 100);
+    TL_TEST(data == expected);
+
+    arc::core::HeapArray<int> array(3000);
+    array.fill(1);
+    jm::parallel_scan(array);
+    TL_TEST(array[0] == 1 && array[2999] == 3000);
+}
+
+void
+test_parallel_sort(void)
+{
+    std::mt19937 rng(1234);
+    for (size_t count : {0ul, 1ul, 5000ul, 100000ul, 333333ul}) {
+        std::vector<uint32_t> data(count);
+        for (auto& v : data)
+            v = rng() % 1000;
+        std::vector<uint32_t> expected = data;
+        std::sort(expected.begin(), expected.end());
+        jm::parallel_sort(data.begin(), data.end());
+        TL_TEST(data == expected);
+    }
+
+    arc::core::HeapArray<int> array(50000);
+    for (size_t i = 0; i < array.size(); i++)
+        array[i] = (int)(rng() % 100000);
+    jm::parallel_sort(array, std::greater<>{});
+    TL_TEST(std::is_sorted(array.data(), array.data() + array.size(),
+                           std::greater<>{}));
+
+    /*sorting from inside a job, the job helps with its own sort*/
+    std::vector<uint32_t> nested(100000);
+    for (auto& v : nested)
+        v = rng();
+    jm::Context ctx;
+    jm::execute(ctx, [&](jm::JobArgs) {
+        jm::parallel_sort(nested.begin(), nested.end());
+    });
+    jm::wait_for(ctx);
+    TL_TEST(std::is_sorted(nested.begin(), nested.end()));
+}
+
+void
+test_parallel_invoke(void)
+{
+    std::atomic<int> ran{0};
+    int a = 0, b = 0, c = 0;
+    jm::parallel_invoke([&] { a = 1; ran++; },
+                        [&] { b = 2; ran++; },
+                        [&] { c = 3; ran++; });
+    TL_TEST(ran.load() == 3);
+    TL_TEST(a + b + c == 6);
+}
+
+/*busy wait, so the cost shows up in the group timings*/
+static void
+spin_for_ns(int64_t ns)
+{
+    auto until = std::chrono::steady_clock::now() + std::chrono::nanoseconds(ns);
+    while (std::chrono::steady_clock::now() < until) {
+    }
+}
+
+void
+test_dispatch_auto_group_size(void)
+{
+    const uint32_t cheap_count = 1u << 20;
+    std::vector<uint8_t> hits(cheap_count, 0);
+    auto cheap = [&](jm::JobArgs args) { hits[args.job_index]++; };
+    auto heavy = [](jm::JobArgs) { spin_for_ns(20000); };
+
+    jm::Context ctx;
+    for (int pass = 0; pass < 4; pass++) {
+        jm::dispatch(ctx, cheap_count, jm::auto_group_size, cheap, 0);
+        jm::dispatch(ctx, 64, jm::auto_group_size, heavy, 0);
+        jm::wait_for(ctx);
+    }
+    TL_TEST(std::all_of(hits.begin(), hits.end(),
+                        [](uint8_t v) { return v == 4; }));
+
+    /*cheap jobs are batched until a group is worth queueing, expensive ones
+     * are only grouped as much as balancing over the threads allows*/
+    const jm::GrainStats& cheap_stats = jm::grain_stats_of(cheap);
+    const jm::GrainStats& heavy_stats = jm::grain_stats_of(heavy);
+    TL_TEST(cheap_stats.dispatches.load() == 4);
+    TL_TEST(heavy_stats.dispatches.load() == 4);
+    TL_TEST(cheap_stats.group_size.load() >= 1024);
+    const uint32_t groups =
+        (jm::get_thread_count() + 1) * jm::auto_groups_per_thread;
+    TL_TEST(heavy_stats.group_size.load() == (64 + groups - 1) / groups);
+    TL_TEST(heavy_stats.ns_per_job.load() >= 20000.0);
+
+    size_t listed = 0;
+    jm::for_each_grain_stats([&](const jm::GrainStats& stats) {
+        listed += &stats == &cheap_stats || &stats == &heavy_stats;
+    });
+    TL_TEST(listed == 2);
+}
+
+static void
+write_sysfs(const std::filesystem::path& path, const std::string& value)
+{
+    std::filesystem::create_directories(path.parent_path());
+    std::ofstream(path) << value << "\n";
+}
+
+/*two NUMA nodes with two L3 domains of two SMT cores each, siblings are
+ * numbered like Linux does, cpu N and N + 8 share a core*/
+static std::filesystem::path
+make_fake_sysfs(void)
+{
+    namespace fs = std::filesystem;
+    fs::path root = fs::temp_directory_path() / "arc-test-sysfs";
+    fs::remove_all(root);
+    write_sysfs(root / "cpu/online", "0-15");
+    write_sysfs(root / "node/online", "0-1");
+    write_sysfs(root / "node/node0/cpulist", "0-3,8-11");
+    write_sysfs(root / "node/node1/cpulist", "4-7,12-15");
+    for (int cpu = 0; cpu < 16; cpu++) {
+        int core = cpu % 8;
+        int ccx = core / 2;
+        fs::path dir = root / ("cpu/cpu" + std::to_string(cpu));
+        write_sysfs(dir / "topology/thread_siblings_list",
+                    std::to_string(core) + "," + std::to_string(core + 8));
+        /*L1d, L1i and L2 are private to the core*/
+        for (int index = 0; index < 3; index++) {
+            fs::path cache = dir / ("cache/index" + std::to_string(index));
+            write_sysfs(cache / "level", index < 2 ? "1" : "2");
+            write_sysfs(cache / "shared_cpu_list",
+                        std::to_string(core) + "," + std::to_string(core + 8));
+        }
+        write_sysfs(dir / "cache/index3/level", "3");
+        write_sysfs(dir / "cache/index3/shared_cpu_list",
+                    std::to_string(ccx * 2) + "-" + std::to_string(ccx * 2 + 1) +
+                        "," + std::to_string(ccx * 2 + 8) + "-" +
+                        std::to_string(ccx * 2 + 9));
+    }
+    return root;
+}
+
+static std::vector<uint32_t>
+first_cpus(const std::vector<arc::core::CpuInfo>& order, size_t count)
+{
+    std::vector<uint32_t> cpus;
+    for (size_t i = 0; i < count && i < order.size(); i++)
+        cpus.push_back(order[i].cpu);
+    return cpus;
+}
+
+void
+test_cpu_topology(void)
+{
+    using arc::core::CpuTopology;
+    TL_TEST(CpuTopology::parse_cpu_list("0-3,8,10-11") ==
+            std::vector<uint32_t>({0, 1, 2, 3, 8, 10, 11}));
+    TL_TEST(CpuTopology::parse_cpu_list("").empty());
+
+    std::filesystem::path root = make_fake_sysfs();
+    CpuTopology topology = CpuTopology::discover(root.string());
+    std::filesystem::remove_all(root);
+
+    TL_TEST(topology.cpus.size() == 16);
+    TL_TEST(topology.n_cores == 8);
+    TL_TEST(topology.n_l3 == 4);
+    TL_TEST(topology.n_numa_nodes == 2);
+    const arc::core::CpuInfo* a = topology.find(3);
+    const arc::core::CpuInfo* b = topology.find(11);
+    TL_TEST(a && b && a->core == b->core && a->smt == 0 && b->smt == 1);
+    TL_TEST(topology.find(2)->l3 == a->l3 && topology.find(4)->l3 != a->l3);
+    TL_TEST(topology.find(12)->numa_node != a->numa_node);
+
+    /*siblings first, then the rest of the L3 domain*/
+    TL_TEST(first_cpus(topology.placement_order(arc::core::PLACEMENT_COMPACT), 4) ==
+            std::vector<uint32_t>({0, 8, 1, 9}));
+    /*every physical core before any SMT sibling*/
+    TL_TEST(first_cpus(topology.placement_order(arc::core::PLACEMENT_PHYSICAL_CORES), 9) ==
+            std::vector<uint32_t>({0, 1, 2, 3, 4, 5, 6, 7, 8}));
+    /*alternate NUMA nodes, then L3 domains within them*/
+    TL_TEST(first_cpus(topology.placement_order(arc::core::PLACEMENT_SCATTER), 8) ==
+            std::vector<uint32_t>({0, 4, 2, 6, 1, 5, 3, 7}));
+    TL_TEST(topology.placement_order(arc::core::PLACEMENT_NONE).empty());
+
+    /*a subset keeps its own dense indices*/
+    CpuTopology fast = topology.subset({0, 8, 1, 9, 64});
+    TL_TEST(fast.cpus.size() == 4);
+    TL_TEST(fast.n_cores == 2 && fast.n_l3 == 1 && fast.n_numa_nodes == 1);
+    TL_TEST(topology.subset({64}).cpus.size() == 16);
+
+    /*the real machine, workers get pinned and still run jobs*/
+    jm::shutdown();
+    jm::initialize(8, 0, {arc::core::PLACEMENT_COMPACT, true, {}});
+    bool pinned = true;
+    for (uint32_t i = 0; i < jm::get_thread_count(); i++)
+        pinned &= jm::get_worker_cpu(i) >= 0;
+    TL_TEST(pinned);
+    std::atomic<uint32_t> ran{0};
+    jm::Context ctx;
+    jm::dispatch(ctx, 1000, 10, [&](jm::JobArgs) { ran++; }, 0);
+    jm::wait_for(ctx);
+    TL_TEST(ran.load() == 1000);
+    jm::shutdown();
+    jm::initialize(8);
+    TL_TEST(jm::get_worker_cpu(0) == -1);
+}
+
+static void
+poll_until_idle(const jm::Context& ctx)
+{
+    while (jm::is_busy(ctx))
+        std::this_thread::yield();
+}
+
+static size_t
+count_of(const std::string& text, const std::string& what)
+{
+    size_t count = 0;
+    for (size_t pos = text.find(what); pos != std::string::npos;
+         pos = text.find(what, pos + 1))
+        count++;
+    return count;
+}
+
+static int
+span_depth_at(const std::string& trace, const std::string& name)
+{
+    /*spans open on its thread when the first span called name begins*/
+    std::map<long, int> depth;
+    for (size_t pos = trace.find("{\"ph\":\""); pos != std::string::npos;
+         pos = trace.find("{\"ph\":\"", pos + 1)) {
+        const std::string event = trace.substr(pos, trace.find('}', pos) - pos);
+        const long tid = std::stol(event.substr(event.find("\"tid\":") + 6));
+        if (event[7] == 'B') {
+            if (event.find("\"name\":\"" + name + "\"") != std::string::npos)
+                return depth[tid];
+            depth[tid]++;
+        } else if (event[7] == 'E') {
+            depth[tid]--;
+        }
+    }
+    return -1;
+}
+
+void
+test_profiler_chrome_trace(void)
+{
+    jm::profiler_begin();
+    TL_TEST(jm::profiler_recording());
+    jm::Context ctx(jm::PRIORITY_NORMAL, "physics");
+    jm::dispatch(ctx, 64, 4, [](jm::JobArgs args) {
+        ARC_JOB_PROFILE_SCOPE("integrate");
+        spin_for_ns(1000 + args.job_index);
+    }, 0);
+    /*keeps ctx busy until the main thread is surely inside wait_for*/
+    jm::execute(ctx, [](jm::JobArgs) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    });
+    jm::wait_for(ctx);
+
+    /*a job parked on a fiber closes its spans until it continues, so a job
+      run meanwhile on the same thread is not nested in it*/
+    {
+        jm::JobSystemConfig config;
+        config.name = "arc::fibprof::";
+        config.thread_count = 1;
+        config.fibers = true;
+        config.fiber_stack_size = 64 * 1024;
+        jm::JobSystem fibers(config);
+        jm::Context gate;
+        gate.counter.store(1);
+        std::atomic<bool> waiting{false};
+        jm::Context parked(jm::PRIORITY_NORMAL, "parked");
+        fibers.execute(parked, [&](jm::JobArgs) {
+            ARC_JOB_PROFILE_SCOPE("holding");
+            waiting = true;
+            fibers.wait_for(gate);
+        });
+        while (!waiting.load())
+            std::this_thread::yield();
+        jm::Context meanwhile(jm::PRIORITY_NORMAL, "meanwhile");
+        fibers.execute(meanwhile, [](jm::JobArgs) {});
+        poll_until_idle(meanwhile);
+        jm::complete(gate);
+        poll_until_idle(parked);
+    }
+    jm::profiler_end();
+
+    /*nothing is recorded outside of a recording*/
+    jm::execute(ctx, [](jm::JobArgs) { ARC_JOB_PROFILE_SCOPE("ignored"); });
+    jm::wait_for(ctx);
+
+    std::ostringstream out;
+    jm::write_chrome_trace(out);
+    const std::string trace = out.str();
+    TL_TEST(trace.rfind("{\"displayTimeUnit\":\"ns\",\"traceEvents\":[", 0) == 0);
+    TL_TEST(count_of(trace, "\"name\":\"physics\"") == 17);
+    TL_TEST(count_of(trace, "\"name\":\"integrate\"") == 64);
+    TL_TEST(count_of(trace, "\"name\":\"wait_for\"") == 1);
+    TL_TEST(count_of(trace, "ignored") == 0);
+    TL_TEST(count_of(trace, "\"ph\":\"B\"") >= count_of(trace, "\"ph\":\"E\""));
+    TL_TEST(count_of(trace, "\"thread_name\"") >= 1);
+    TL_TEST(count_of(trace, "\"name\":\"parked\"") == 2);
+    TL_TEST(count_of(trace, "\"name\":\"holding\"") == 2);
+    TL_TEST(span_depth_at(trace, "parked") == 0);
+    TL_TEST(span_depth_at(trace, "meanwhile") == 0);
+
+    /*a new recording starts empty*/
+    jm::profiler_begin();
+    jm::profiler_end();
+    std::ostringstream empty;
+    jm::write_chrome_trace(empty);
+    TL_TEST(count_of(empty.str(), "physics") == 0);
+}
+
+/*defined in second_tu.cpp*/
+jm::JobSystem* second_tu_default_system(void);
+uint64_t second_tu_sum(uint32_t count);
+
+void
+test_job_systems(void)
+{
+    /*both translation units share the default system*/
+    TL_TEST(second_tu_default_system() == &jm::default_job_system());
+    TL_TEST(second_tu_sum(1000) == 999 * 1000 / 2);
+
+    jm::JobSystemConfig config;
+    config.name = "arc::io::";
+    config.thread_count = 6;
+    config.oversubscribe = true;
+    config.stack_size = 256 * 1024;
+    jm::JobSystem io(config);
+    TL_TEST(io.ready());
+    TL_TEST(io.get_thread_count() == 6);
+    TL_TEST(jm::JobSystem::current() == &jm::default_job_system());
+
+    /*the caller only polls, so every job runs on a worker of io, waiting
+      would have it help with them*/
+    std::atomic<uint32_t> in_io{0}, named{0}, small_stack{0};
+    jm::Context ctx;
+    io.dispatch(ctx, 64, 1, [&](jm::JobArgs) {
+        if (jm::JobSystem::current() == &io)
+            in_io++;
+        char name[16] = {};
+        pthread_getname_np(pthread_self(), name, sizeof(name));
+        if (std::strncmp(name, "arc::io::", 9) == 0)
+            named++;
+        pthread_attr_t attr;
+        size_t size = 0;
+        pthread_getattr_np(pthread_self(), &attr);
+        pthread_attr_getstacksize(&attr, &size);
+        pthread_attr_destroy(&attr);
+        if (size >= 256 * 1024 && size < 1024 * 1024)
+            small_stack++;
+    }, 0);
+    poll_until_idle(ctx);
+    TL_TEST(in_io.load() == 64);
+    TL_TEST(named.load() == 64);
+    TL_TEST(small_stack.load() == 64);
+
+    /*io hands work to the default system, which hands the result back*/
+    jm::Context load, decode, store;
+    std::atomic<int> stage{0};
+    io.execute(load, [&](jm::JobArgs) {
+        stage = 1;
+        jm::execute(decode, [&](jm::JobArgs) {
+            stage = 2;
+            io.execute(store, [&](jm::JobArgs) {
+                if (jm::JobSystem::current() == &io)
+                    stage = 3;
+            });
+        });
+    });
+    poll_until_idle(load);
+    poll_until_idle(decode);
+    poll_until_idle(store);
+    TL_TEST(stage.load() == 3);
+
+    /*an io job waits on a dispatch of the default system*/
+    std::atomic<uint32_t> sum{0};
+    jm::Context nested;
+    io.execute(nested, [&](jm::JobArgs) {
+        jm::Context inner;
+        jm::dispatch(inner, 100, 10, [&](jm::JobArgs) { sum++; }, 0);
+        jm::wait_for(inner);
+    });
+    io.wait_for(nested);
+    TL_TEST(sum.load() == 100);
+
+    /*a graph runs on the system it is given*/
+    std::atomic<uint32_t> graph_in_io{0};
+    jm::TaskGraph graph;
+    auto& first = graph.add_dispatch(16, 4, [&](jm::JobArgs) {
+        graph_in_io += jm::JobSystem::current() == &io;
+    });
+    auto& second = graph.add([&](jm::JobArgs) {
+        graph_in_io += jm::JobSystem::current() == &io;
+    });
+    first.precede(second);
+    jm::Context frame;
+    graph.run(io, frame);
+    poll_until_idle(frame);
+    TL_TEST(graph_in_io.load() == 17);
+
+    io.shutdown();
+    TL_TEST(!io.ready());
+    TL_TEST(jm::JobSystem::current() == &jm::default_job_system());
+}
+
+struct PingPong {
+    arc::core::Fiber thread;
+    arc::core::Fiber* fiber = nullptr;
+    int count = 0;
+};
+
+static void
+fiber_ping(void* arg)
+{
+    PingPong& state = *static_cast<PingPong*>(arg);
+    state.fiber->started();
+    for (;;) {
+        state.count++;
+        state.fiber->switch_to(state.thread);
+    }
+}
+
+void
+test_fiber_switch(void)
+{
+    PingPong state;
+    arc::core::Fiber fiber(64 * 1024, &fiber_ping, &state);
+    state.fiber = &fiber;
+    TL_TEST(fiber.owns_stack() && fiber.stack_size() >= 64 * 1024);
+    for (int i = 0; i < 1000; i++)
+        state.thread.switch_to(fiber);
+    TL_TEST(state.count == 1000);
+}
+
+/*every level dispatches two groups that wait on the next level, the shared
+  memory of a group must survive while its fiber is parked*/
+static void
+nested_wait(jm::JobSystem& system, uint32_t depth, std::atomic<uint32_t>& leaves,
+            std::atomic<uint32_t>& corrupted)
+{
+    if (depth == 0) {
+        leaves++;
+        return;
+    }
+    jm::Context ctx;
+    jm::JobSystem* sys = &system;
+    system.dispatch(ctx, 2, 1, [sys, depth, &leaves, &corrupted](jm::JobArgs args) {
+        uint32_t* mark = static_cast<uint32_t*>(args.sharedmemory);
+        *mark = depth * 16 + args.group_ID;
+        nested_wait(*sys, depth - 1, leaves, corrupted);
+        if (*mark != depth * 16 + args.group_ID)
+            corrupted++;
+    }, sizeof(uint32_t));
+    system.wait_for(ctx);
+}
+
+void
+test_fiber_wait_for(void)
+{
+    jm::JobSystemConfig config;
+    config.name = "arc::fiber::";
+    config.thread_count = 1;
+    config.fibers = true;
+    config.fiber_stack_size = 64 * 1024;
+    jm::JobSystem fibers(config);
+
+    /*a job parked on a gate leaves the only worker free for other jobs, and
+      continues on the same thread once the gate opens*/
+    jm::Context gate;
+    gate.counter.store(1);
+    std::atomic<bool> resumed{false}, same_thread{false};
+    jm::Context parked;
+    fibers.execute(parked, [&](jm::JobArgs) {
+        const std::thread::id before = std::this_thread::get_id();
+        fibers.wait_for(gate);
+        same_thread = before == std::this_thread::get_id();
+        resumed = true;
+    });
+    std::atomic<bool> probed{false};
+    jm::Context probe;
+    fibers.execute(probe, [&](jm::JobArgs) { probed = true; });
+    poll_until_idle(probe);
+    TL_TEST(probed.load());
+    TL_TEST(!resumed.load());
+    jm::complete(gate);
+    poll_until_idle(parked);
+    TL_TEST(resumed.load() && same_thread.load());
+
+    std::atomic<uint32_t> leaves{0}, corrupted{0};
+    jm::Context root;
+    fibers.execute(root, [&](jm::JobArgs) {
+        nested_wait(fibers, 8, leaves, corrupted);
+    });
+    poll_until_idle(root);
+    TL_TEST(leaves.load() == 256);
+    TL_TEST(corrupted.load() == 0);
+}
+
+void
+test_job_batch(void)
+{
+    /*nothing runs before submit, the batch holds the jobs*/
+    jm::Context frame, background(jm::PRIORITY_BACKGROUND);
+    std::atomic<uint32_t> executed{0}, dispatched{0}, streamed{0};
+    jm::JobBatch batch;
+    for (int i = 0; i < 100; i++)
+        batch.execute(frame, [&](jm::JobArgs) { executed++; });
+    batch.dispatch(frame, 1000, 16, [&](jm::JobArgs args) {
+        dispatched.fetch_add(args.job_index);
+    }, 0);
+    batch.execute(background, [&](jm::JobArgs) { streamed++; });
+    TL_TEST(batch.size() == 100 + 63 + 1);
+    TL_TEST(jm::is_busy(frame));
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    TL_TEST(executed.load() == 0);
+
+    batch.submit();
+    TL_TEST(batch.size() == 0);
+    jm::wait_for(frame);
+    jm::wait_for(background);
+    TL_TEST(executed.load() == 100);
+    TL_TEST(dispatched.load() == 999 * 1000 / 2);
+    TL_TEST(streamed.load() == 1);
+
+    /*a thread outside of the pool goes through the injection queue, and
+      the destructor submits what is left*/
+    jm::Context ctx;
+    std::atomic<uint32_t> ran{0};
+    std::thread foreign([&] {
+        jm::JobBatch local;
+        for (int i = 0; i < 500; i++)
+            local.execute(ctx, [&](jm::JobArgs) { ran++; });
+        local.dispatch(ctx, 500, jm::auto_group_size, [&](jm::JobArgs) {
+            ran++;
+        }, 0);
+    });
+    foreign.join();
+    jm::wait_for(ctx);
+    TL_TEST(ran.load() == 1000);
+}
+
+void
+test_main_thread_queue(void)
+{
+    /*workers prepare in parallel and post the last step, which only runs
+      when the main thread drains*/
+    arc::core::MainThreadQueue queue;
+    const std::thread::id main = std::this_thread::get_id();
+    std::vector<int> order;
+    std::atomic<uint32_t> on_main{0};
+    jm::Context prepared, uploaded;
+    jm::dispatch(prepared, 64, 1, [&](jm::JobArgs args) {
+        queue.post(uploaded, [&, index = (int)args.job_index](jm::JobArgs) {
+            if (std::this_thread::get_id() == main)
+                on_main++;
+            order.push_back(index);
+        });
+    }, 0);
+    jm::wait_for(prepared);
+    TL_TEST(jm::is_busy(uploaded));
+    TL_TEST(!queue.empty());
+
+    /*a job depending on the main thread step runs after it*/
+    std::atomic<bool> after{false};
+    jm::Context followup;
+    jm::execute(followup, {&uploaded}, [&](jm::JobArgs) {
+        after = order.size() == 64;
+    });
+
+    /*a zero budget still makes progress, one job at a time*/
+    TL_TEST(queue.drain(std::chrono::nanoseconds(0)) == 1);
+    TL_TEST(queue.drain() == 63);
+    TL_TEST(!jm::is_busy(uploaded));
+    TL_TEST(queue.empty());
+    TL_TEST(on_main.load() == 64);
+    std::vector<int> sorted = order;
+    std::sort(sorted.begin(), sorted.end());
+    TL_TEST(sorted.size() == 64 && sorted.front() == 0 && sorted.back() == 63);
+    jm::wait_for(followup);
+    TL_TEST(after.load());
+
+    /*posts from one thread run in the order they were made*/
+    order.clear();
+    jm::Context ordered;
+    std::thread poster([&] {
+        for (int i = 0; i < 100; i++)
+            queue.post(ordered, [&order, i](jm::JobArgs) { order.push_back(i); });
+    });
+    poster.join();
+    size_t ran = 0;
+    while (jm::is_busy(ordered))
+        ran += queue.drain(std::chrono::microseconds(1));
+    TL_TEST(ran == 100);
+    TL_TEST(std::is_sorted(order.begin(), order.end()) && order.size() == 100);
+}
+
+struct FrameSnapshot {
+    uint64_t frame = ~0ull;
+    uint64_t state = 0;
+};
+
+void
+test_frame_pipeline(void)
+{
+    /*the simulation is only touched by updates, which must run in order*/
+    uint64_t state = 0;
+    std::atomic<uint64_t> updates_started{0};
+    std::atomic<uint32_t> out_of_order{0};
+    arc::core::FramePipeline<FrameSnapshot> pipeline(
+        [&](uint64_t frame, FrameSnapshot& out) {
+            if (updates_started.fetch_add(1) != frame)
+                out_of_order++;
+            state += frame;
+            out.frame = frame;
+            out.state = state;
+        },
+        2);
+
+    uint32_t wrong = 0, too_far_ahead = 0;
+    uint64_t expected_state = 0;
+    for (uint64_t i = 0; i < 50; i++) {
+        if (i == 20)
+            pipeline.set_depth(0);
+        if (i == 30)
+            pipeline.set_depth(3);
+        const uint64_t drawn = pipeline.frame([&](const FrameSnapshot& snapshot,
+                                                  uint64_t frame) {
+            expected_state += frame;
+            if (snapshot.frame != frame || snapshot.state != expected_state)
+                wrong++;
+            /*the frame being drawn plus at most depth updates ahead*/
+            if (updates_started.load() > frame + 1 + pipeline.depth())
+                too_far_ahead++;
+        });
+        TL_TEST(drawn == i);
+    }
+    TL_TEST(wrong == 0);
+    TL_TEST(too_far_ahead == 0);
+    TL_TEST(out_of_order.load() == 0);
+    TL_TEST(pipeline.frames_drawn() == 50);
+
+    /*after sync no update is running, depth 3 started frames up to 52*/
+    pipeline.sync();
+    TL_TEST(updates_started.load() == 53);
+    TL_TEST(state == 52 * 53 / 2);
+}
+
+void
+test_frame_pipeline_main_queue(void)
+{
+    /*updates post to the main thread, frame() runs the posted jobs on the
+      thread calling it*/
+    arc::core::MainThreadQueue queue;
+    const std::thread::id main = std::this_thread::get_id();
+    std::atomic<uint32_t> on_main{0}, elsewhere{0};
+    jm::Context posted;
+    arc::core::FramePipeline<FrameSnapshot> pipeline(
+        [&](uint64_t frame, FrameSnapshot& out) {
+            queue.post(posted, [&](jm::JobArgs) {
+                if (std::this_thread::get_id() == main)
+                    on_main++;
+                else
+                    elsewhere++;
+            });
+            out.frame = frame;
+        },
+        0);
+    pipeline.set_main_thread_queue(&queue);
+
+    /*with depth 0 the jobs of an update are drained by the next frame()*/
+    for (uint64_t i = 0; i < 10; i++)
+        pipeline.frame([](const FrameSnapshot&, uint64_t) {});
+    TL_TEST(on_main.load() >= 9);
+    TL_TEST(elsewhere.load() == 0);
+
+    /*without a queue frame() leaves posted jobs alone*/
+    pipeline.set_main_thread_queue(nullptr);
+    pipeline.frame([](const FrameSnapshot&, uint64_t) {});
+    pipeline.sync();
+    TL_TEST(!queue.empty());
+    queue.drain();
+    TL_TEST(on_main.load() == 11);
+    TL_TEST(!jm::is_busy(posted));
+}
+
+void
+test_resize_pool(void)
+{
+    jm::JobSystemConfig config;
+    config.name = "arc::resize::";
+    config.thread_count = 2;
+    config.max_thread_count = 6;
+    config.oversubscribe = true;
+    jm::JobSystem pool(config);
+    TL_TEST(pool.get_thread_count() == 2);
+    TL_TEST(pool.get_max_thread_count() == 6);
+
+    /*after growing, six jobs that wait for each other can all run at once*/
+    TL_TEST(pool.set_thread_count(100) == 6);
+    TL_TEST(pool.get_thread_count() == 6);
+    std::atomic<uint32_t> arrived{0};
+    std::atomic<uint32_t> met{0};
+    jm::Context ctx;
+    pool.dispatch(ctx, 6, 1, [&](jm::JobArgs) {
+        arrived++;
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (arrived.load() < 6 && std::chrono::steady_clock::now() < deadline)
+            std::this_thread::yield();
+        if (arrived.load() == 6)
+            met++;
+    }, 0);
+    poll_until_idle(ctx);
+    TL_TEST(met.load() == 6);
+
+    /*shrinking while workers hold jobs in their own queues loses none*/
+    std::atomic<uint32_t> ran{0};
+    jm::Context nested;
+    pool.dispatch(nested, 64, 1, [&](jm::JobArgs) {
+        ran++;
+        pool.dispatch(nested, 16, 1, [&](jm::JobArgs) {
+            std::this_thread::sleep_for(std::chrono::microseconds(50));
+            ran++;
+        }, 0);
+    }, 0);
+    TL_TEST(pool.set_thread_count(1) == 1);
+    TL_TEST(pool.get_thread_count() == 1);
+    poll_until_idle(nested);
+    TL_TEST(ran.load() == 64 + 64 * 16);
+
+    /*and growing again reuses the retired slots*/
+    TL_TEST(pool.set_thread_count(3) == 3);
+    jm::Context after;
+    std::atomic<uint32_t> sum{0};
+    pool.dispatch(after, 100, 1, [&](jm::JobArgs args) { sum += args.job_index; }, 0);
+    poll_until_idle(after);
+    TL_TEST(sum.load() == 99 * 100 / 2);
+}
+
+void
+test_autoscale_pool(void)
+{
+    jm::JobSystemConfig config;
+    config.name = "arc::scale::";
+    config.thread_count = 1;
+    config.max_thread_count = 4;
+    config.oversubscribe = true;
+    config.autoscale.enabled = true;
+    config.autoscale.interval = std::chrono::milliseconds(1);
+    config.autoscale.grow_samples = 1;
+    config.autoscale.shrink_samples = 5;
+    jm::JobSystem pool(config);
+    TL_TEST(pool.get_thread_count() == 1);
+
+    /*a backlog of blocking jobs grows the pool*/
+    std::atomic<uint32_t> peak{1};
+    jm::Context ctx;
+    pool.dispatch(ctx, 400, 1, [&](jm::JobArgs) {
+        std::this_thread::sleep_for(std::chrono::microseconds(500));
+        uint32_t count = pool.get_thread_count();
+        uint32_t seen = peak.load();
+        while (count > seen && !peak.compare_exchange_weak(seen, count)) {
+        }
+    }, 0);
+    poll_until_idle(ctx);
+    TL_TEST(peak.load() > 1);
+
+    /*and an idle pool shrinks back to the minimum*/
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+    while (pool.get_thread_count() > 1 && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    TL_TEST(pool.get_thread_count() == 1);
+}
+
+void
+test_timer_wheel(void)
+{
+    arc::core::TimerWheel<uint64_t> wheel(10);
+    std::vector<uint64_t> fired;
+    auto collect = [&](uint64_t expires) {
+        /*due no earlier than its tick, and on the tick it was processed*/
+        TL_TEST(expires == wheel.now());
+        fired.push_back(expires);
+    };
+
+    /*deadlines in the inner wheel, in every outer wheel and past all of them*/
+    const uint64_t deadlines[] = {10, 11, 265, 266, 300, 16394, 20000,
+                                  1u << 20, (1ull << 26) + 7, (1ull << 33) + 3};
+    for (uint64_t deadline : deadlines)
+        wheel.insert(deadline, deadline);
+    auto cancelled = wheel.insert(5000, 5000);
+    wheel.insert(3, 10); /*in the past, due on the next tick*/
+    TL_TEST(wheel.size() == 12);
+
+    uint64_t payload = 0;
+    TL_TEST(wheel.cancel(cancelled, &payload) && payload == 5000);
+    TL_TEST(!wheel.cancel(cancelled));
+    TL_TEST(wheel.size() == 11);
+
+    /*advance processes every tick before its argument*/
+    wheel.advance(11, collect);
+    TL_TEST(fired.size() == 2 && fired[0] == 10 && fired[1] == 10);
+    fired.clear();
+    wheel.advance(266, collect);
+    TL_TEST(fired.size() == 2 && fired.back() == 265);
+    fired.clear();
+    wheel.advance((1ull << 34), collect);
+    TL_TEST(fired.size() == 7);
+    TL_TEST(std::is_sorted(fired.begin(), fired.end()));
+    TL_TEST(wheel.empty());
+
+    /*a handle stays harmless once its node was reused*/
+    auto stale = wheel.insert(wheel.now() + 1, 1);
+    wheel.advance(wheel.now() + 2, [](uint64_t) {});
+    auto reused = wheel.insert(wheel.now() + 1, 2);
+    TL_TEST(!wheel.cancel(stale));
+    TL_TEST(wheel.cancel(reused));
+}
+
+void
+test_timed_jobs(void)
+{
+    jm::JobSystemConfig config;
+    config.name = "arc::timed::";
+    config.thread_count = 2;
+    config.timer_tick = std::chrono::microseconds(500);
+    jm::JobSystem pool(config);
+
+    /*jobs never run before their time*/
+    std::atomic<uint32_t> early{0};
+    std::atomic<uint32_t> ran{0};
+    jm::Context ctx;
+    const auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < 20; i++) {
+        const auto delay = std::chrono::milliseconds(i % 5 * 5);
+        pool.execute_after(ctx, delay, [&, delay](jm::JobArgs) {
+            if (std::chrono::steady_clock::now() < start + delay)
+                early++;
+            ran++;
+        });
+    }
+    TL_TEST(jm::is_busy(ctx));
+    poll_until_idle(ctx);
+    TL_TEST(ran.load() == 20);
+    TL_TEST(early.load() == 0);
+
+    /*a cancelled job never runs and its Context drains*/
+    jm::Context cancelled;
+    auto timer = pool.execute_after(cancelled, std::chrono::seconds(60),
+                                    [&](jm::JobArgs) { ran++; });
+    TL_TEST(jm::is_busy(cancelled));
+    TL_TEST(pool.cancel_timer(timer));
+    TL_TEST(!pool.cancel_timer(timer));
+    TL_TEST(!jm::is_busy(cancelled));
+
+    /*an earlier deadline wakes the timer thread up*/
+    jm::Context soon;
+    pool.execute_after(soon, std::chrono::seconds(60), [](jm::JobArgs) {});
+    const auto before = std::chrono::steady_clock::now();
+    pool.execute_after(soon, std::chrono::milliseconds(1), [&](jm::JobArgs) { ran++; });
+    while (ran.load() < 21 &&
+           std::chrono::steady_clock::now() < before + std::chrono::seconds(5))
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    TL_TEST(ran.load() == 21);
+
+    /*frame timers run on the n-th advance_frame()*/
+    std::atomic<uint32_t> frame_ran{0};
+    jm::Context frames;
+    pool.execute_after_frames(frames, 3, [&](jm::JobArgs) { frame_ran++; });
+    auto dropped = pool.execute_after_frames(frames, 2, [&](jm::JobArgs) { frame_ran += 100; });
+    pool.execute_after_frames(frames, 0, [&](jm::JobArgs) { frame_ran++; });
+    while (frame_ran.load() == 0)
+        std::this_thread::yield();
+    TL_TEST(frame_ran.load() == 1);
+    TL_TEST(pool.cancel_timer(dropped));
+    TL_TEST(pool.advance_frame() == 0);
+    TL_TEST(pool.advance_frame() == 0);
+    TL_TEST(pool.advance_frame() == 1);
+    poll_until_idle(frames);
+    TL_TEST(frame_ran.load() == 2);
+    TL_TEST(pool.frame_index() == 3);
+
+    /*the minute long timer is still pending, shutdown drops it*/
+    TL_TEST(jm::is_busy(soon));
+}
+
+void
+test_cancel_token(void)
+{
+    jm::JobSystemConfig config;
+    config.name = "arc::cancel::";
+    config.thread_count = 1;
+    jm::JobSystem pool(config);
+
+    jm::CancelToken token;
+    jm::Context loading;
+    loading.cancel_token = &token;
+    TL_TEST(!jm::is_cancelled(loading));
+
+    /*the first group holds the only worker until it sees the cancel*/
+    std::atomic<bool> started{false};
+    std::atomic<bool> saw_cancel{false};
+    std::atomic<uint32_t> ran{0};
+    pool.dispatch(loading, 1000, 10, [&](jm::JobArgs args) {
+        ran++;
+        if (args.job_index != 0)
+            return;
+        started = true;
+        while (!args.is_cancelled())
+            std::this_thread::yield();
+        saw_cancel = true;
+    }, 0);
+    jm::Context dependent;
+    pool.execute(dependent, {&loading}, [&](jm::JobArgs) { ran += 1000; });
+    while (!started.load())
+        std::this_thread::yield();
+
+    token.cancel();
+    TL_TEST(jm::is_cancelled(loading));
+    poll_until_idle(loading);
+    poll_until_idle(dependent);
+    /*the rest of the running group and every queued group were dropped*/
+    TL_TEST(saw_cancel.load());
+    TL_TEST(ran.load() == 1 + 1000);
+
+    /*a reset token runs new jobs again*/
+    token.reset();
+    pool.dispatch(loading, 100, 10, [&](jm::JobArgs) { ran++; }, 0);
+    poll_until_idle(loading);
+    TL_TEST(ran.load() == 1 + 1000 + 100);
+}
+
+struct Position {};
+struct Velocity {};
+struct Health {};
+struct Color {};
+
+/*one store per component, systems only touch the stores they declare*/
+struct SchedulerWorld {
+    std::atomic<uint32_t> clock{0};
+    uint32_t started[6] = {};
+    uint32_t finished[6] = {};
+    std::vector<float> positions = std::vector<float>(10000, 1.0f);
+    std::vector<float> velocities = std::vector<float>(10000, 0.0f);
+    std::vector<float> healths = std::vector<float>(10000, 100.0f);
+    std::vector<float> colors = std::vector<float>(10000, 0.0f);
+};
+
+void
+test_system_scheduler(void)
+{
+    using arc::core::ComponentAccess;
+    arc::core::SystemScheduler<SchedulerWorld> systems;
+    /*large loops split further into chunks*/
+    auto system = [](size_t index, auto&& update) {
+        return [index, update](SchedulerWorld& world) {
+            world.started[index] = world.clock++;
+            jm::parallel_for(world.positions.size(),
+                             [&](size_t i) { update(world, i); }, 1000);
+            world.finished[index] = world.clock++;
+        };
+    };
+    systems.add("integrate", ComponentAccess().write<Position>(),
+                system(0, [](SchedulerWorld& w, size_t i) { w.positions[i] += 1.0f; }));
+    systems.add("steer", ComponentAccess().read<Position>().write<Velocity>(),
+                system(1, [](SchedulerWorld& w, size_t i) { w.velocities[i] += w.positions[i]; }));
+    systems.add("damage", ComponentAccess().read<Position>().write<Health>(),
+                system(2, [](SchedulerWorld& w, size_t i) { w.healths[i] -= w.positions[i]; }));
+    systems.add("teleport", ComponentAccess().write<Position>(),
+                system(3, [](SchedulerWorld& w, size_t i) { w.positions[i] += 1.0f; }));
+    systems.add("script", ComponentAccess(), [](SchedulerWorld& world) {
+        world.started[4] = world.clock++;
+        world.finished[4] = world.clock++;
+    });
+    systems.add("tint", ComponentAccess().write<Color>(),
+                system(5, [](SchedulerWorld& w, size_t i) { w.colors[i] += 1.0f; }));
+
+    SchedulerWorld world;
+    systems.run(world);
+
+    /*each system waits for the latest one it conflicts with, and for older
+     * ones only when they are not already ahead of that one*/
+    TL_TEST(systems.dependencies(0).empty());
+    TL_TEST(systems.dependencies(1) == std::vector<size_t>{0});
+    TL_TEST(systems.dependencies(2) == std::vector<size_t>{0});
+    TL_TEST(systems.dependencies(3) == (std::vector<size_t>{2, 1}));
+    TL_TEST(systems.dependencies(4) == std::vector<size_t>{3});
+    TL_TEST(systems.dependencies(5) == std::vector<size_t>{4});
+
+    const std::pair<int, int> edges[] = {{0, 1}, {0, 2}, {1, 3}, {2, 3}, {3, 4}, {4, 5}};
+    bool ordered = true;
+    for (auto [before, after] : edges)
+        ordered = ordered && world.finished[before] < world.started[after];
+    TL_TEST(ordered);
+    /*steer and damage read positions between integrate and teleport*/
+    TL_TEST(world.positions.front() == 3.0f && world.positions.back() == 3.0f);
+    TL_TEST(world.velocities.front() == 2.0f && world.velocities.back() == 2.0f);
+    TL_TEST(world.healths.front() == 98.0f && world.healths.back() == 98.0f);
+    TL_TEST(world.colors.front() == 1.0f && world.colors.back() == 1.0f);
+
+    /*the graph is reused and every run is timed*/
+    systems.run(world);
+    const auto timings = systems.timings();
+    TL_TEST(timings.size() == 6 && timings[3].name == "teleport");
+    TL_TEST(std::all_of(timings.begin(), timings.end(), [](const auto& t) {
+        return t.runs == 2 && t.last_ms > 0.0 && t.average_ms > 0.0;
+    }));
+    TL_TEST(world.positions.back() == 5.0f && world.velocities.back() == 6.0f);
+    TL_TEST(world.healths.back() == 94.0f && world.colors.back() == 2.0f);
+}
+
+void
+test_execute_on(void)
+{
+    jm::JobSystemConfig config;
+    config.name = "arc::pinned::";
+    config.thread_count = 3;
+    config.oversubscribe = true;
+    config.background_thread_count = 1;
+    jm::JobSystem pool(config);
+    const uint32_t background = pool.get_max_thread_count();
+
+    /*every job runs on the worker it names, whatever its priority, even a
+     * background job on a general worker and the other way round*/
+    std::vector<uint32_t> targets = {0, 1, 2, background};
+    std::vector<std::atomic<uint32_t>> ran(targets.size());
+    std::atomic<uint32_t> misplaced{0};
+    jm::Context normal;
+    jm::Context low;
+    low.priority = jm::PRIORITY_BACKGROUND;
+    for (int i = 0; i < 50; i++) {
+        for (size_t t = 0; t < targets.size(); t++) {
+            pool.execute_on(i % 2 ? low : normal, targets[t], [&, t](jm::JobArgs) {
+                if (pool.get_worker_id() != targets[t])
+                    misplaced++;
+                ran[t]++;
+            });
+        }
+    }
+    poll_until_idle(normal);
+    poll_until_idle(low);
+    TL_TEST(misplaced.load() == 0);
+    for (auto& count : ran)
+        TL_TEST(count.load() == 50);
+
+    /*others stay idle rather than take the jobs of a busy worker*/
+    std::atomic<bool> holding{false};
+    std::atomic<bool> release{false};
+    std::atomic<uint32_t> pinned{0};
+    jm::Context hold;
+    jm::Context ctx;
+    pool.execute_on(hold, 0, [&](jm::JobArgs) {
+        holding = true;
+        while (!release.load())
+            std::this_thread::yield();
+    });
+    while (!holding.load())
+        std::this_thread::yield();
+    for (int i = 0; i < 10; i++)
+        pool.execute_on(ctx, 0, [&](jm::JobArgs) { pinned++; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    TL_TEST(pinned.load() == 0 && jm::is_busy(ctx));
+    release = true;
+    poll_until_idle(ctx);
+    poll_until_idle(hold);
+    TL_TEST(pinned.load() == 10);
+
+    /*a worker that waits on jobs pinned to itself runs them meanwhile*/
+    std::atomic<uint32_t> nested{0};
+    jm::Context outer;
+    pool.execute_on(outer, 1, [&](jm::JobArgs) {
+        jm::Context inner;
+        for (int i = 0; i < 8; i++)
+            pool.execute_on(inner, 1, [&](jm::JobArgs) { nested++; });
+        pool.wait_for(inner);
+    });
+    poll_until_idle(outer);
+    TL_TEST(nested.load() == 8);
+
+    /*a worker already asleep in wait_for() is woken for a job pinned to it
+      and still waits afterwards*/
+    jm::Context gate;
+    gate.counter.store(1);
+    std::atomic<bool> waiting{false}, waited{false};
+    jm::Context sleeper;
+    pool.execute_on(sleeper, 1, [&](jm::JobArgs) {
+        waiting = true;
+        pool.wait_for(gate);
+        waited = true;
+    });
+    while (!waiting.load())
+        std::this_thread::yield();
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    std::atomic<bool> woken{false};
+    jm::Context late;
+    pool.execute_on(late, 1, [&](jm::JobArgs) { woken = true; });
+    const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (jm::is_busy(late) && std::chrono::steady_clock::now() < deadline)
+        std::this_thread::yield();
+    TL_TEST(woken.load() && !waited.load());
+    jm::complete(gate);
+    poll_until_idle(late);
+    poll_until_idle(sleeper);
+    TL_TEST(waited.load());
+    TL_TEST(pool.get_worker_id() == ~0u);
+}
+
+void
+test_job_stats(void)
+{
+    jm::JobSystemConfig config;
+    config.name = "arc::stats::";
+    config.thread_count = 1;
+    jm::JobSystem pool(config);
+
+    /*the worker slot and the initializing thread, this thread already works
+     * for the default system so its slot stays untouched*/
+    const jm::JobSystemStats before = pool.stats();
+    TL_TEST(before.workers.size() == 2);
+
+    /*submitted from outside of the pool, through the injection queue*/
+    jm::Context ctx;
+    pool.dispatch(ctx, 1000, 10, [](jm::JobArgs args) {
+        if (args.is_first_job_in_group) {
+            const auto until = std::chrono::steady_clock::now() + std::chrono::microseconds(50);
+            while (std::chrono::steady_clock::now() < until) {}
+        }
+    }, 0);
+    poll_until_idle(ctx);
+
+    /*workers that ran out of jobs spin and park, give them time to*/
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    const jm::JobSystemStats after = pool.stats();
+    const jm::JobSystemStats delta = after.delta(before);
+    const jm::WorkerCounters total = delta.total();
+    TL_TEST(total.jobs_executed == 100);
+    TL_TEST(total.busy_ns >= 100 * 50000ull);
+    TL_TEST(total.parked_ns > 0);
+    TL_TEST(after.injection_high_water >= 1);
+    TL_TEST(delta.workers.back().jobs_executed == 0);
+    TL_TEST(after.seconds_since(before) > 0.0);
+    TL_TEST(total.utilization() > 0.0 && total.utilization() < 1.0);
+
+    /*a parked worker keeps counting while it sleeps*/
+    const jm::JobSystemStats later = pool.stats();
+    TL_TEST(later.total().parked_ns > after.total().parked_ns);
+
+    /*a job that dispatches from the only worker queues on its own lane and
+     * runs the jobs itself in wait_for*/
+    std::atomic<uint32_t> ran{0};
+    jm::Context outer;
+    pool.execute(outer, [&](jm::JobArgs) {
+        jm::Context inner;
+        pool.dispatch(inner, 64, 1, [&](jm::JobArgs) { ran++; }, 0);
+        pool.wait_for(inner);
+    });
+    poll_until_idle(outer);
+    TL_TEST(ran.load() == 64);
+    const jm::WorkerCounters nested = pool.stats().delta(after).total();
+    TL_TEST(nested.jobs_executed == 65);
+    TL_TEST(nested.queue_high_water >= 1);
+    TL_TEST(nested.jobs_stolen == 0);
+    TL_TEST(nested.wait_help_ns > 0);
+
+    pool.shutdown();
+    TL_TEST(pool.stats().workers.empty());
+}
+
+
+void
+test_dispatch_affine(void)
+{
+    jm::JobSystemConfig config;
+    config.name = "arc::affine::";
+    config.thread_count = 2;
+    config.oversubscribe = true;
+    jm::JobSystem pool(config);
+
+    /*hold both workers so the groups are placed before anyone runs them*/
+    std::atomic<uint32_t> holding{0};
+    std::atomic<bool> release{false};
+    jm::Context gate;
+    pool.dispatch(gate, 2, 1, [&](jm::JobArgs) {
+        holding++;
+        while (!release.load())
+            std::this_thread::yield();
+    }, 0);
+    while (holding.load() < 2)
+        std::this_thread::yield();
+
+    std::mutex locker;
+    std::vector<std::pair<std::thread::id, uint32_t>> order;
+    std::vector<std::thread::id> seen;
+    jm::Context ctx;
+    pool.dispatch_affine(ctx, 64, 8, [&](jm::JobArgs args) {
+        if (!args.is_first_job_in_group)
+            return;
+        {
+            std::scoped_lock lock(locker);
+            order.emplace_back(std::this_thread::get_id(), args.group_ID);
+            if (std::find(seen.begin(), seen.end(), std::this_thread::get_id()) == seen.end())
+                seen.push_back(std::this_thread::get_id());
+        }
+        /*until both workers took a group, so neither runs out and steals*/
+        const auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(5);
+        while (std::chrono::steady_clock::now() < deadline) {
+            {
+                std::scoped_lock lock(locker);
+                if (seen.size() == 2)
+                    break;
+            }
+            std::this_thread::yield();
+        }
+    }, 0);
+    release = true;
+    poll_until_idle(ctx);
+    poll_until_idle(gate);
+
+    /*this thread has no queue in the pool, so each worker owns half of the
+     * groups and starts with the first of its own*/
+    TL_TEST(order.size() == 8);
+    std::vector<uint32_t> first_groups;
+    for (std::thread::id worker : seen) {
+        for (const auto& [thread, group] : order) {
+            if (thread == worker) {
+                first_groups.push_back(group);
+                break;
+            }
+        }
+    }
+    std::sort(first_groups.begin(), first_groups.end());
+    TL_TEST(first_groups == (std::vector<uint32_t>{0, 4}));
+
+    /*from the default system the calling thread takes a block too*/
+    std::atomic<uint32_t> sum{0};
+    jm::Context frame;
+    for (int i = 0; i < 10; i++)
+        jm::dispatch_affine(frame, 1000, 10, [&](jm::JobArgs args) { sum += args.job_index; }, 0);
+    jm::wait_for(frame);
+    TL_TEST(sum.load() == 10 * 999 * 1000 / 2);
+}
+
+int
+main(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+    jm::initialize(8);
+
+    TL(test_workstealingqueue_owner());
+    TL(test_workstealingqueue_concurrent_steal());
+    TL(test_inlinefunction());
+    TL(test_execute());
+    TL(test_dispatch());
+    TL(test_nested_dispatch());
+    TL(test_foreign_thread_submit());
+    TL(test_job_batch());
+    TL(test_main_thread_queue());
+    TL(test_frame_pipeline());
+    TL(test_frame_pipeline_main_queue());
+    TL(test_dispatch_zero_allocations());
+    TL(test_execute_dependencies());
+    TL(test_taskgraph_replay());
+    TL(test_taskgraph_external_context());
+    TL(test_scratcharena());
+    TL(test_dispatch_sharedmemory());
+    TL(test_dispatch_auto_group_size());
+    TL(test_profiler_chrome_trace());
+    TL(test_parallel_for_reduce());
+    TL(test_parallel_scan());
+    TL(test_parallel_sort());
+    TL(test_parallel_invoke());
+    TL(test_cpu_topology());
+    TL(test_priority_order());
+    TL(test_frame_latency_under_background());
+    TL(test_job_systems());
+    TL(test_resize_pool());
+    TL(test_autoscale_pool());
+    TL(test_timer_wheel());
+    TL(test_timed_jobs());
+    TL(test_cancel_token());
+    TL(test_system_scheduler());
+    TL(test_dispatch_affine());
+    TL(test_job_stats());
+    TL(test_execute_on());
+    TL(test_fiber_switch());
+    TL(test_fiber_wait_for());
+
+    jm::shutdown();
+    tl_summary();
+}
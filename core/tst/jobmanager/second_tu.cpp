@@ -0,0 +1,23 @@
+/*a second translation unit including the job system headers, the test only
+  links if they define nothing outside of inline functions and variables*/
+#define ARC_JOB_PROFILER 1
+
+#include "../../../core/inc/JobManager.hpp"
+#include "../../../core/inc/ParallelAlgorithms.hpp"
+#include "../../../core/inc/TaskGraph.hpp"
+
+namespace jm = arc::core::JobManager;
+
+jm::JobSystem*
+second_tu_default_system(void)
+{
+    return &jm::default_job_system();
+}
+
+uint64_t
+second_tu_sum(uint32_t count)
+{
+    std::atomic<uint64_t> sum{0};
+    jm::parallel_for((size_t)count, [&](size_t i) { sum += i; });
+    return sum.load();
+}
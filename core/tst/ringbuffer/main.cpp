@@ -0,0 +1,93 @@
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#include "../testlib.h"
+
+//#include <ArcCore/RingBuffer.hpp>
+#include "../../../core/inc/RingBuffer.hpp"
+
+using arc::core::RingBuffer;
+using arc::core::RingBufferSPSC;
+
+void
+test_locked_ring(void)
+{
+    /*one slot stays free to tell full from empty*/
+    RingBuffer<int, 4> ring;
+    TL_TEST(ring.push_back(1));
+    TL_TEST(ring.push_back(2));
+    TL_TEST(ring.push_back(3));
+    TL_TEST(!ring.push_back(4));
+    int item = 0;
+    TL_TEST(ring.pop_front(item) && item == 1);
+    TL_TEST(ring.push_back(4));
+    TL_TEST(ring.pop_front(item) && item == 2);
+    TL_TEST(ring.pop_front(item) && item == 3);
+    TL_TEST(ring.pop_front(item) && item == 4);
+    TL_TEST(!ring.pop_front(item));
+}
+
+void
+test_spsc_ring(void)
+{
+    /*holds its whole capacity*/
+    RingBuffer<int, 8, RingBufferSPSC> ring;
+    int item = -1;
+    TL_TEST(!ring.pop_front(item));
+    for (int i = 0; i < 8; i++)
+        TL_TEST(ring.push_back(i));
+    TL_TEST(!ring.push_back(8));
+    for (int i = 0; i < 8; i++)
+        TL_TEST(ring.pop_front(item) && item == i);
+    TL_TEST(!ring.pop_front(item));
+
+    /*indices keep counting past the array, items stay in order*/
+    bool ordered = true;
+    int next = 0;
+    for (int lap = 0; lap < 1000; lap++) {
+        for (int i = 0; i < 5; i++)
+            ordered &= ring.push_back(lap * 5 + i);
+        for (int i = 0; i < 5; i++)
+            ordered &= ring.pop_front(item) && item == next++;
+    }
+    TL_TEST(ordered);
+    TL_TEST(!ring.pop_front(item));
+}
+
+void
+test_spsc_threads(void)
+{
+    /*a small ring, so both sides keep running into full and empty*/
+    const uint32_t count = 1000000;
+    RingBuffer<uint32_t, 64, RingBufferSPSC> ring;
+    std::thread producer([&] {
+        for (uint32_t i = 0; i < count; i++) {
+            while (!ring.push_back(i))
+                std::this_thread::yield();
+        }
+    });
+    bool ordered = true;
+    uint32_t item = 0;
+    for (uint32_t i = 0; i < count; i++) {
+        while (!ring.pop_front(item))
+            std::this_thread::yield();
+        ordered &= item == i;
+    }
+    producer.join();
+    TL_TEST(ordered);
+    TL_TEST(!ring.pop_front(item));
+}
+
+int
+main(int argc, char** argv)
+{
+    (void)argc;
+    (void)argv;
+
+    TL(test_locked_ring());
+    TL(test_spsc_ring());
+    TL(test_spsc_threads());
+
+    tl_summary();
+}